@@ -1,31 +1,289 @@
+#define _GNU_SOURCE
+
 #include <assert.h>
 #include <ctype.h>
+#include <fenv.h>
+#include <float.h>
+#include <inttypes.h>
 #include <math.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <errno.h>
+#include <signal.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 #include <getopt.h>
+#include <stdarg.h>
+#include <dlfcn.h>
+#include <elf.h>
+#include <limits.h>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(VM_PROFILE_CYCLES) && !defined(VM_PROFILE)
+#define VM_PROFILE
+#endif
+
+#if defined(VM_PROFILE_CYCLES) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#endif
+
+#ifdef TRACK_ALLOCATIONS
+#include <malloc.h>
+
+#define TRACKED_MALLOC(subsystem, size) tracked_malloc(subsystem, size)
+#define TRACKED_REALLOC(subsystem, pointer, size) tracked_realloc(subsystem, pointer, size)
+#define TRACKED_FREE(subsystem, pointer) tracked_free(subsystem, pointer)
+#define TRACK_PHASE(phase) track_phase(phase)
+#else
+#define TRACKED_MALLOC(subsystem, size) malloc(size)
+#define TRACKED_REALLOC(subsystem, pointer, size) realloc(pointer, size)
+#define TRACKED_FREE(subsystem, pointer) free(pointer)
+#define TRACK_PHASE(phase) ((void)0)
+#endif
+
+// Disabled tracing costs one well-predicted branch per event site.
+#define TRACE_BEGIN(name)                              \
+    do {                                               \
+        if (__builtin_expect(trace_enabled, 0)) {      \
+            trace_record(name, 'B', false);            \
+        }                                              \
+    } while (0)
+#define TRACE_END(name)                                \
+    do {                                               \
+        if (__builtin_expect(trace_enabled, 0)) {      \
+            trace_record(name, 'E', false);            \
+        }                                              \
+    } while (0)
+#define TRACE_BEGIN_EXPRESSION()                       \
+    do {                                               \
+        if (__builtin_expect(trace_enabled, 0)) {      \
+            trace_record("expression", 'B', true);     \
+        }                                              \
+    } while (0)
+
+// Handlers of the tail-call VM end by jumping to the next one, which clang and GCC 15 guarantee
+// with musttail. Other compilers only turn the call into a jump when sibling call optimization
+// happens to run, so there each handler hands its state back to a trampoline loop in
+// run_tail_vm instead and the C stack stays flat at any optimization level. Builds that are
+// known to run it (GCC or clang at -O2) can opt back into plain tail calls with
+// -DTAIL_SIBLING_CALLS. The trampoline is slower than run_vm, so it is only kept for
+// correctness: --help and --bench-suite leave tail_vm out there.
+#if defined(__has_attribute)
+#if __has_attribute(musttail)
+#define MUSTTAIL __attribute__((musttail))
+#endif
+#endif
+#if !defined(MUSTTAIL) && defined(TAIL_SIBLING_CALLS)
+#define MUSTTAIL
+#endif
+
+#define TAIL_PARAMETERS \
+    const struct bytecode *ip, union value *sp, union value tos, const double *constants
+#define TAIL_HANDLER(name) union value name(TAIL_PARAMETERS)
+#ifdef MUSTTAIL
+#define TAIL_DISPATCH() \
+    MUSTTAIL return tail_handlers[ip[1].code](ip + 1, sp, tos, constants)
+#else
+#define TAIL_TRAMPOLINE
+#define TAIL_DISPATCH()                                     \
+    do {                                                    \
+        (void)constants;                                    \
+        tail_next = (struct tail_state){ ip + 1, sp, tos }; \
+        return tos;                                         \
+    } while (0)
+#endif
 
 #define UNARY_DEFAULT 10
 #define DEFAULT_CAPACITY 32
 #define MAX_STACK_SIZE 255
-
-enum node_type { NODE_NUMBER, NODE_UNARY, NODE_BINARY };
+#define SUM_BLOCK_SIZE 32
+#define MAX_AST_DEPTH 5000
+#define SUM_LANES 4
+#define POW_INT_MAX_EXPONENT 64
+#define BIGINT_BASE 1000000000u
+#define BIGINT_BASE_DIGITS 9
+#define KARATSUBA_THRESHOLD 32
+#define TOOM3_THRESHOLD 160
+#define RATIONAL_REDUCE_LIMBS 4
+#define EXACT_MAX_EXPONENT 100000
+#define DD_DIGITS 32
+#define ESTRIN_MIN_DEGREE 8
+#define BENCH_PHASE_COUNT 6
+#define DEFAULT_BENCH_ITERATIONS 1000
+#define GEN_LEAF (-1)
+#define GEN_MAX_SIZE (1 << 30)
+#define GEN_MAX_LITERAL_KINDS 8
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+#define AOT_FLAGS "-O2", "-ffp-contract=off", "-fPIC", "-shared"
+#define VM_PROFILE_TOP_PAIRS 16
+#define PERF_COUNTER_COUNT 5
+#define TRACE_INITIAL_EVENTS 1024
+#define SUITE_PASSES 3
+#define SUITE_BATCHES 5
+#define SUITE_SAMPLES (SUITE_PASSES * SUITE_BATCHES)
+#define SUITE_BATCH_NS 2500000u
+#define SUITE_NOISE_MADS 3.0
+#define SUITE_CONFIRM_RUNS 2
+#define SUITE_MAX_BASELINES 8
+#define SUITE_NAME_LENGTH 32
+#define DEFAULT_SUITE_THRESHOLD 10.0
+#define LATENCY_SUB_BUCKET_BITS 4
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BUCKET_BITS)
+#define LATENCY_BUCKETS ((64 - LATENCY_SUB_BUCKET_BITS + 1) * LATENCY_SUB_BUCKETS)
+
+enum node_type { NODE_NUMBER, NODE_UNARY, NODE_BINARY, NODE_SUM, NODE_FMA, NODE_POLY };
+enum value_type { VALUE_DOUBLE, VALUE_INT };
+enum numeric_mode {
+    NUMERIC_DOUBLE,
+    NUMERIC_BIGINT,
+    NUMERIC_RATIONAL,
+    NUMERIC_F32,
+    NUMERIC_INTERVAL,
+    NUMERIC_DD,
+    NUMERIC_MOD
+};
+enum bigint_mul_algorithm { MUL_SCHOOLBOOK, MUL_KARATSUBA, MUL_TOOM3 };
+enum sum_mode { SUM_NONE, SUM_PAIRWISE, SUM_COMPENSATED };
+enum poly_scheme { POLY_NONE, POLY_AUTO, POLY_HORNER, POLY_HORNER_FMA, POLY_ESTRIN };
+enum gen_shape { GEN_SHAPE_RANDOM, GEN_SHAPE_LEFT, GEN_SHAPE_RIGHT, GEN_SHAPE_BALANCED };
+enum gen_literal_kind { GEN_LITERAL_INT, GEN_LITERAL_DECIMAL, GEN_LITERAL_EXPONENT };
+enum perf_counter {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_BRANCH_MISSES,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES
+};
+enum suite_evaluator {
+    SUITE_FRONTEND,
+    SUITE_RUN_VM,
+    SUITE_EVAL_AST,
+    SUITE_TAIL_VM,
+    SUITE_ACC_VM,
+    SUITE_F32_VM,
+    SUITE_DD_VM,
+    SUITE_INTERVAL_VM,
+    SUITE_RATIONAL_VM,
+    SUITE_BIGINT_VM
+};
+enum alloc_subsystem { ALLOC_LEXER, ALLOC_AST, ALLOC_BYTECODE, ALLOC_SUBSYSTEM_COUNT };
+enum pipeline_phase {
+    PHASE_TOKENIZE,
+    PHASE_PARSE,
+    PHASE_PASSES,
+    PHASE_COMPILE,
+    PHASE_RUN,
+    PHASE_EVAL,
+    PHASE_COUNT
+};
+enum simplify_rule {
+    RULE_SQUARE,
+    RULE_SQRT,
+    RULE_RECIPROCAL,
+    RULE_MULTIPLY_ONE,
+    RULE_ADD_ZERO,
+    RULE_SUBTRACT_ZERO,
+    RULE_ZERO_SUBTRACT,
+    RULE_UNARY_PLUS,
+    RULE_DOUBLE_NEGATION,
+    RULE_MERGE_CONSTANTS,
+    RULE_COUNT
+};
 enum ast_print_type { AST_S_EXPR = 1, AST_JSON = 2 };
-enum token_kind { NUMBER, PLUS, MINUS, STAR, SLASH, PERCENT, CARET, LPAREN, RPAREN, END_OF_FILE };
+// SQRT is only produced by the simplifier, the lexer has no function syntax.
+enum token_kind {
+    NUMBER,
+    PLUS,
+    MINUS,
+    STAR,
+    SLASH,
+    PERCENT,
+    CARET,
+    LPAREN,
+    RPAREN,
+    END_OF_FILE,
+    SQRT
+};
 // clang-format off
 enum opcode {
     OP_CONSTANT, OP_ADD, OP_SUBTRACT, OP_MULTIPLY, OP_DIVIDE, 
-    OP_MODULO, OP_POWER,  OP_NEGATE, OP_PLUS, OP_HALT
+    OP_MODULO, OP_POWER,  OP_NEGATE, OP_PLUS, OP_SUM_N,
+    OP_COMPENSATED_SUM_N, OP_INT_CONSTANT, OP_INT_ADD, OP_INT_SUBTRACT,
+    OP_INT_MULTIPLY, OP_INT_MODULO, OP_INT_POWER, OP_INT_NEGATE,
+    OP_INT_TO_DOUBLE, OP_POW_INT, OP_FMA, OP_FMS, OP_SQRT, OP_HORNER,
+    OP_HORNER_FMA, OP_ESTRIN, OP_HALT, OP_COUNT
+};
+
+// Accumulator machine: every instruction combines ACC with at most one operand, read from the
+// constant pool (K) or a temporary (TMP) as selected by its acc_mode. The REVERSE forms compute
+// operand op ACC.
+enum acc_opcode {
+    ACC_LOAD, ACC_INT_LOAD, ACC_STORE, ACC_COPY, ACC_ADD, ACC_SUBTRACT, ACC_REVERSE_SUBTRACT,
+    ACC_MULTIPLY, ACC_DIVIDE, ACC_REVERSE_DIVIDE, ACC_MODULO, ACC_REVERSE_MODULO, ACC_POWER,
+    ACC_REVERSE_POWER, ACC_NEGATE, ACC_SQRT, ACC_POW_INT, ACC_INT_TO_DOUBLE, ACC_FMA, ACC_FMS,
+    ACC_HORNER, ACC_HORNER_FMA, ACC_ESTRIN, ACC_SUM_N, ACC_COMPENSATED_SUM_N, ACC_INT_NEGATE,
+    ACC_INT_ADD, ACC_INT_SUBTRACT, ACC_INT_REVERSE_SUBTRACT, ACC_INT_MULTIPLY, ACC_INT_MODULO,
+    ACC_INT_REVERSE_MODULO, ACC_INT_POWER, ACC_INT_REVERSE_POWER, ACC_HALT
+};
+enum acc_mode { ACC_NONE, ACC_CONSTANT, ACC_TEMP };
+
+enum long_option {
+    OPT_NO_INT = 256,
+    OPT_BIGINT,
+    OPT_BENCH_BIGINT,
+    OPT_RATIONAL,
+    OPT_PRECISION,
+    OPT_INTERVAL,
+    OPT_BENCH_MODES,
+    OPT_FMA,
+    OPT_SIMPLIFY,
+    OPT_FAST_MATH,
+    OPT_HORNER,
+    OPT_MOD,
+    OPT_BENCH,
+    OPT_GEN,
+    OPT_STATS,
+    OPT_PERF_COUNTERS,
+    OPT_TRACE,
+    OPT_BENCH_SUITE,
+    OPT_BASELINE,
+    OPT_THRESHOLD,
+    OPT_DISASM,
+    OPT_LATENCY,
+    OPT_EMIT_C,
+    OPT_AOT,
+    OPT_EMIT_ASM,
+    OPT_EMIT_OBJ,
+    OPT_TAIL_VM,
+    OPT_ACC_VM
 };
 // clang-format on
 
 struct bytecode {
     enum opcode code;
     size_t const_index;
+    size_t operand;
+};
+
+// Source text of a constant, kept next to its double so exact numeric modes can re-read it.
+struct literal {
+    const char *text;
+    size_t length;
 };
 
 struct chunk {
@@ -34,14 +292,157 @@ struct chunk {
     size_t code_size;
 
     double *constants;
+    struct literal *literals;
     size_t const_capacity;
     size_t const_size;
+
+    // Tracked while emitting, so an interpreter can check the stack bounds once up front.
+    size_t depth;
+    size_t max_depth;
+    bool underflow;
+};
+
+// A stack slot holds whichever representation the compiler typed the producing subtree with,
+// the opcodes that read it are typed the same way.
+union value {
+    double number;
+    int64_t integer;
 };
 
 struct vm {
     struct chunk *chunks;
     size_t ip;
-    double stack[MAX_STACK_SIZE];
+    union value stack[MAX_STACK_SIZE];
+    size_t top;
+};
+
+#ifdef TAIL_TRAMPOLINE
+// Where the trampoline resumes after a handler returns.
+struct tail_state {
+    const struct bytecode *ip;
+    union value *sp;
+    union value tos;
+};
+
+static _Thread_local struct tail_state tail_next;
+#endif
+
+// For FMA and SUM_N index is the first of consecutive temporaries, for the polynomial opcodes it
+// is the first coefficient and operand the degree. COPY moves K[index] to TMP[operand].
+struct acc_instruction {
+    enum acc_opcode code;
+    enum acc_mode mode;
+    size_t index;
+    size_t operand;
+};
+
+struct acc_chunk {
+    struct acc_instruction *code;
+    size_t code_size;
+    size_t code_capacity;
+
+    union value *constants;
+    size_t constant_size;
+    size_t constant_capacity;
+
+    double *coefficients;
+    size_t coefficient_size;
+    size_t coefficient_capacity;
+
+    // Temporaries the code needs, the interpreter checks it against its frame once.
+    size_t temps;
+};
+
+// Sign-magnitude integer, little endian limbs in base 10^9 so decimal I/O is linear.
+struct bigint {
+    uint32_t *limbs;
+    size_t size;
+    size_t capacity;
+    bool negative;
+};
+
+struct bigint_vm {
+    struct chunk *chunks;
+    size_t ip;
+    struct bigint stack[MAX_STACK_SIZE];
+    size_t top;
+};
+
+// numerator / denominator with a positive denominator. Not necessarily reduced, see
+// rational_maybe_reduce.
+struct rational {
+    struct bigint numerator;
+    struct bigint denominator;
+};
+
+struct rational_vm {
+    struct chunk *chunks;
+    size_t ip;
+    struct rational stack[MAX_STACK_SIZE];
+    size_t top;
+};
+
+// Single precision twin of struct vm, constants are rounded from their source text.
+struct f32_vm {
+    struct chunk *chunks;
+    size_t ip;
+    float stack[MAX_STACK_SIZE];
+    size_t top;
+};
+
+// A closed interval [lo, hi] that is guaranteed to contain the exact real result.
+struct interval {
+    double lo;
+    double hi;
+};
+
+// Bounds are kept as two parallel arrays rather than an array of struct interval, so a batch of
+// lower bounds and a batch of upper bounds each load as contiguous vectors.
+struct interval_vm {
+    struct chunk *chunks;
+    size_t ip;
+    double lo[MAX_STACK_SIZE];
+    double hi[MAX_STACK_SIZE];
+    size_t top;
+};
+
+// An unevaluated sum hi + lo with |lo| <= ulp(hi) / 2, carrying about 106 significant bits.
+struct dd {
+    double hi;
+    double lo;
+};
+
+struct dd_vm {
+    struct chunk *chunks;
+    size_t ip;
+    struct dd stack[MAX_STACK_SIZE];
+    size_t top;
+};
+
+// Residues mod P. Odd moduli are kept in Montgomery form x * 2^64 mod P, even ones as plain
+// residues reduced by 128-bit division.
+struct mod_context {
+    uint64_t modulus;
+    uint64_t inverse;
+    uint64_t r2;
+    bool montgomery;
+};
+
+// What the VM knows about a stack value beyond its residue: a subtree of integer literals under
+// +, -, * and non-negative powers is still an exact integer, which is what an exponent needs.
+struct mod_literal {
+    bool known;
+    bool too_large;
+    bool negative;
+    uint64_t magnitude;
+};
+
+struct mod_vm {
+    struct chunk *chunks;
+    const struct mod_context *context;
+    size_t ip;
+    uint64_t stack[MAX_STACK_SIZE];
+    struct mod_literal literals[MAX_STACK_SIZE];
     size_t top;
 };
 
@@ -54,11 +455,20 @@ struct token {
     enum token_kind kind;
     union token_value value;
     size_t start, end;
+
+    // Set for literals without a fraction or exponent that fit in an int64_t.
+    bool is_integer;
+    int64_t integer_value;
+    const char *lexeme;
 };
 
 union node_data {
     struct {
         double value;
+        bool is_integer;
+        int64_t integer;
+        const char *lexeme;
+        size_t lexeme_length;
     } number;
 
     struct {
@@ -71,10 +481,35 @@ union node_data {
         struct ast_node *left;
         struct ast_node *right;
     } binary;
+
+    // A flattened + chain. At most SUM_BLOCK_SIZE terms, longer chains are split into a tree of
+    // sums so the VM never needs more than a block of stack slots per level.
+    struct {
+        enum sum_mode mode;
+        struct ast_node **terms;
+        size_t count;
+    } sum;
+
+    // multiplicand * multiplier + addend with a single rounding, or - addend when subtract is set.
+    struct {
+        struct ast_node *multiplicand;
+        struct ast_node *multiplier;
+        struct ast_node *addend;
+        bool subtract;
+    } fma;
+
+    // sum of coefficients[i] * base^i for i <= degree, the base is evaluated once.
+    struct {
+        struct ast_node *base;
+        double *coefficients;
+        size_t degree;
+        enum poly_scheme scheme;
+    } poly;
 };
 
 struct ast_node {
     enum node_type type;
+    enum value_type value_type;
     size_t start, end;
 
     union node_data data;
@@ -82,6 +517,11 @@ struct ast_node {
 
 struct lexer {
     size_t cursor;
+    size_t source_len;
+
+    // Exact modes re-read literals from their lexeme, so a literal beyond double range is only an
+    // error when the double value is what gets evaluated.
+    bool allow_out_of_range;
 
     struct token *tokens;
     size_t capacity;
@@ -93,31 +533,533 @@ struct parser {
     size_t size;
 
     size_t current_index;
+    size_t depth;
+};
+
+struct gen_options {
+    size_t size;
+    size_t depth;
+    size_t count;
+    enum gen_shape shape;
+    const char *ops;
+    enum gen_literal_kind literal_kinds[GEN_MAX_LITERAL_KINDS];
+    size_t literal_kind_count;
+    bool negative_literals;
+    double paren_density;
+    uint64_t seed;
+};
+
+// Generated trees only keep operators, the literals are drawn while printing. A child index of
+// GEN_LEAF stands for a literal.
+struct gen_node {
+    char op;
+    int32_t left;
+    int32_t right;
+};
+
+struct gen_frame {
+    int32_t node;
+    uint8_t state;
+    bool parens;
+};
+
+struct gen_state {
+    const struct gen_options *options;
+    uint64_t random;
+    struct gen_node *nodes;
+    size_t node_count;
+    struct gen_frame *frames;
+    FILE *stream;
+    char buffer[1 << 16];
+    size_t size;
+};
+
+#ifdef VM_PROFILE
+// Filled by run_vm when built with -DVM_PROFILE, cycles only with -DVM_PROFILE_CYCLES. Kept at
+// file scope so every caller of run_vm feeds the same report without threading it through.
+struct vm_profile {
+    uint64_t counts[OP_COUNT];
+    uint64_t pairs[OP_COUNT][OP_COUNT];
+    uint64_t cycles[OP_COUNT];
+};
+
+static struct vm_profile vm_profile;
+#endif
+
+#ifdef TRACK_ALLOCATIONS
+// Sizes come from malloc_usable_size, so a block freed outside the tracked calls only leaves
+// its bytes counted as live instead of corrupting anything.
+struct alloc_stats {
+    uint64_t allocations;
+    uint64_t reallocs;
+    uint64_t growths;
+    uint64_t moves;
+    uint64_t frees;
+    uint64_t requested_bytes;
+    size_t live_bytes;
+    size_t peak_bytes;
+};
+
+struct phase_stats {
+    uint64_t allocations;
+    uint64_t requested_bytes;
+    size_t peak_bytes;
+};
+
+struct allocation_tracker {
+    struct alloc_stats subsystems[ALLOC_SUBSYSTEM_COUNT];
+    struct phase_stats phases[PHASE_COUNT];
+    enum pipeline_phase phase;
+    size_t live_bytes;
+    uint64_t runs;
+};
+
+static struct allocation_tracker allocation_tracker;
+#endif
+
+// One perf_event_open group, so all counters cover exactly the same instructions. A counter the
+// kernel or the PMU refuses is left out of the group instead of failing the whole benchmark.
+struct perf_counters {
+    int fds[PERF_COUNTER_COUNT];
+    size_t slots[PERF_COUNTER_COUNT];
+    size_t opened;
+    int leader;
+};
+
+struct trace_event {
+    const char *name;
+    uint64_t timestamp;
+    size_t expression;
+    char phase;
+};
+
+// Each thread appends to its own buffer without locking. Buffers are pushed once onto a shared
+// lock-free list when a thread records its first event, and trace_flush walks that list at exit.
+struct trace_buffer {
+    struct trace_event *events;
+    size_t size;
+    size_t capacity;
+    size_t expression;
+    uint64_t thread_id;
+    struct trace_buffer *next;
+};
+
+static bool trace_enabled;
+static const char *trace_path;
+static _Thread_local struct trace_buffer *trace_local;
+static _Atomic(struct trace_buffer *) trace_buffers;
+static atomic_uint_fast64_t trace_thread_count;
+
+// Log-bucketed like HdrHistogram: 16 linear sub-buckets per power of two, so every recorded
+// latency is kept to within 1/16 of its value. Each thread records into its own histograms with
+// plain relaxed loads and stores, and a report merges all of them.
+struct latency_histogram {
+    _Atomic uint64_t counts[LATENCY_BUCKETS];
+    _Atomic uint64_t max;
+};
+
+struct latency_recorder {
+    struct latency_histogram phases[BENCH_PHASE_COUNT + 1];
+    struct latency_recorder *next;
+};
+
+static _Thread_local struct latency_recorder *latency_local;
+static _Atomic(struct latency_recorder *) latency_recorders;
+static volatile sig_atomic_t latency_report_requested;
+
+struct suite_result {
+    char case_name[SUITE_NAME_LENGTH];
+    char config[SUITE_NAME_LENGTH];
+    char evaluator[SUITE_NAME_LENGTH];
+    double min_ns;
+    double median_ns;
+    double mad_ns;
+};
+
+struct suite_entry {
+    size_t case_index;
+    size_t config_index;
+    enum suite_evaluator evaluator;
+    struct suite_result result;
+    uint64_t samples[SUITE_SAMPLES];
+    const struct suite_result *previous;
+    double change;
+    size_t repeats;
+    bool regressed;
+};
+
+struct c_slot {
+    size_t temp;
+    bool integer;
+};
+
+// Emits straight-line C, every stack slot becomes a fresh const local named t<temp>.
+struct c_emitter {
+    FILE *stream;
+    size_t temps;
+};
+
+enum x86_register { X86_RAX = 0, X86_RCX = 1, X86_RDX = 2, X86_RSP = 4, X86_RSI = 6, X86_RDI = 7 };
+
+enum x86_operand_kind { X86_REGISTER, X86_XMM, X86_STACK, X86_RIP };
+
+// A ModRM operand: a general or xmm register, a frame slot off rsp, or a RIP-relative label.
+struct x86_operand {
+    enum x86_operand_kind kind;
+    int reg;
+    int32_t displacement;
+    size_t label;
+};
+
+// A rel32 field at offset, relative to the end of its instruction.
+struct x86_fixup {
+    size_t offset;
+    size_t end;
+    size_t label;
+};
+
+enum native_symbol { NATIVE_POW, NATIVE_FMOD, NATIVE_FMA, NATIVE_WRITE, NATIVE_EXIT, NATIVE_SYMBOL_COUNT };
+
+struct native_call {
+    size_t offset;
+    enum native_symbol symbol;
+};
+
+struct native_constant {
+    size_t label;
+    uint64_t bits;
+};
+
+// x86-64 machine code for a chunk. Every instruction is encoded into code and written to the
+// listing in GNU assembler syntax by the same call, so --emit-asm and --emit-obj cannot drift.
+struct native_code {
+    FILE *listing;
+    uint8_t *code;
+    size_t code_size;
+    size_t code_capacity;
+    size_t *labels;
+    size_t label_count;
+    size_t label_capacity;
+    struct x86_fixup *fixups;
+    size_t fixup_count;
+    size_t fixup_capacity;
+    struct native_call *calls;
+    size_t call_count;
+    size_t call_capacity;
+    struct native_constant *constants;
+    size_t constant_count;
+    size_t constant_capacity;
+    bool used[NATIVE_SYMBOL_COUNT];
+    size_t division_by_zero;
+    size_t integer_overflow;
 };
 
 struct cli_options {
     bool show_help;
     enum ast_print_type show_ast;
+    bool disasm;
+    bool latency;
+    bool tail_vm;
+    bool acc_vm;
+    const char *emit_c_path;
+    bool aot;
+    const char *emit_asm_path;
+    const char *emit_obj_path;
+    enum sum_mode sum_mode;
+    bool no_int;
+    bool bench_bigint;
+    bool bench_modes;
+    bool fma;
+    bool simplify;
+    bool simplify_report;
+    bool fast_math;
+    enum poly_scheme poly_scheme;
+    uint64_t modulus;
+    size_t bench_iterations;
+    bool generate;
+    struct gen_options gen;
+    bool stats;
+    bool perf_counters;
+    const char *trace_path;
+    bool bench_suite;
+    const char *baseline_paths[SUITE_MAX_BASELINES];
+    size_t baseline_count;
+    double threshold;
+    enum numeric_mode numeric_mode;
     char *expression;
+    char *expression_file;
+};
+
+struct sum_work_item {
+    struct ast_node *node;
+    bool negate;
+};
+
+struct depth_work_item {
+    const struct ast_node *node;
+    size_t depth;
 };
 
 void push(struct vm *stack_vm, double value);
 double pop(struct vm *stack_vm);
-double run_vm(struct vm *stack_vm);
+void push_int(struct vm *stack_vm, int64_t value);
+int64_t pop_int(struct vm *stack_vm);
+union value run_vm(struct vm *stack_vm);
+void tail_fail(const char *message) __attribute__((noreturn, cold));
+double tail_sum(const union value *values, size_t count, enum sum_mode mode);
+TAIL_HANDLER(tail_constant);
+TAIL_HANDLER(tail_negate);
+TAIL_HANDLER(tail_add);
+TAIL_HANDLER(tail_subtract);
+TAIL_HANDLER(tail_multiply);
+TAIL_HANDLER(tail_divide);
+TAIL_HANDLER(tail_modulo);
+TAIL_HANDLER(tail_power);
+TAIL_HANDLER(tail_pow_int);
+TAIL_HANDLER(tail_fma);
+TAIL_HANDLER(tail_sqrt);
+TAIL_HANDLER(tail_poly);
+TAIL_HANDLER(tail_sum_n);
+TAIL_HANDLER(tail_int_constant);
+TAIL_HANDLER(tail_int_negate);
+TAIL_HANDLER(tail_int_add);
+TAIL_HANDLER(tail_int_subtract);
+TAIL_HANDLER(tail_int_multiply);
+TAIL_HANDLER(tail_int_modulo);
+TAIL_HANDLER(tail_int_power);
+TAIL_HANDLER(tail_int_to_double);
+TAIL_HANDLER(tail_halt);
+TAIL_HANDLER(tail_unknown);
+union value run_tail_vm(const struct chunk *chunks);
+enum acc_opcode get_acc_opcode(enum token_kind kind, bool integer, bool reverse);
+void emit_acc(struct acc_chunk *chunk, enum acc_opcode code, enum acc_mode mode, size_t index,
+              size_t operand);
+size_t add_acc_constant(struct acc_chunk *chunk, union value value);
+void emit_acc_store(struct acc_chunk *chunk, size_t temp);
+void compile_acc_to_temp(struct acc_chunk *chunk, const struct ast_node *node, size_t temp);
+size_t add_acc_leaf(struct acc_chunk *chunk, const struct ast_node *leaf, bool integer);
+void compile_acc_binary(struct acc_chunk *chunk, const struct ast_node *node, size_t temp);
+void compile_ast_to_accumulator(struct acc_chunk *chunk, const struct ast_node *node, size_t temp);
+void compile_acc_as(struct acc_chunk *chunk, const struct ast_node *node, size_t temp,
+                    bool integer);
+void compile_accumulator(struct acc_chunk *chunk, const struct ast_node *root);
+void free_acc_chunk(struct acc_chunk *chunk);
+union value acc_operand(const struct acc_chunk *chunk, const union value *temps,
+                        const struct acc_instruction *instruction);
+union value run_acc_vm(const struct acc_chunk *chunk);
+
+static union value (*const tail_handlers[OP_COUNT])(TAIL_PARAMETERS) = {
+    [OP_CONSTANT] = tail_constant,
+    [OP_ADD] = tail_add,
+    [OP_SUBTRACT] = tail_subtract,
+    [OP_MULTIPLY] = tail_multiply,
+    [OP_DIVIDE] = tail_divide,
+    [OP_MODULO] = tail_modulo,
+    [OP_POWER] = tail_power,
+    [OP_NEGATE] = tail_negate,
+    [OP_PLUS] = tail_unknown,
+    [OP_SUM_N] = tail_sum_n,
+    [OP_COMPENSATED_SUM_N] = tail_sum_n,
+    [OP_INT_CONSTANT] = tail_int_constant,
+    [OP_INT_ADD] = tail_int_add,
+    [OP_INT_SUBTRACT] = tail_int_subtract,
+    [OP_INT_MULTIPLY] = tail_int_multiply,
+    [OP_INT_MODULO] = tail_int_modulo,
+    [OP_INT_POWER] = tail_int_power,
+    [OP_INT_NEGATE] = tail_int_negate,
+    [OP_INT_TO_DOUBLE] = tail_int_to_double,
+    [OP_POW_INT] = tail_pow_int,
+    [OP_FMA] = tail_fma,
+    [OP_FMS] = tail_fma,
+    [OP_SQRT] = tail_sqrt,
+    [OP_HORNER] = tail_poly,
+    [OP_HORNER_FMA] = tail_poly,
+    [OP_ESTRIN] = tail_poly,
+    [OP_HALT] = tail_halt,
+};
+
+char *get_opcode_string(enum opcode code);
+int get_stack_effect(const struct bytecode *instruction);
+size_t get_instruction_cost(const struct bytecode *instruction);
+void disassemble_chunk(const struct chunk *chunks);
+char *get_acc_opcode_string(enum acc_opcode code);
+void disassemble_acc_chunk(const struct acc_chunk *chunk);
+size_t emit_c_temp(struct c_emitter *emitter, bool integer, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+size_t emit_c_constant(struct c_emitter *emitter, double value);
+size_t emit_c_checked(struct c_emitter *emitter, const char *check, size_t lhs, size_t rhs);
+void emit_c_zero_check(struct c_emitter *emitter, size_t temp, bool integer);
+size_t emit_c_pow_int(struct c_emitter *emitter, size_t base, int64_t exponent);
+size_t emit_c_poly(struct c_emitter *emitter, enum opcode code, const double *coefficients,
+                   size_t degree, size_t x);
+size_t emit_c_sum_pairwise(struct c_emitter *emitter, const size_t *values, size_t count);
+void emit_c_neumaier(struct c_emitter *emitter, size_t *sum, size_t *compensation, size_t value);
+size_t emit_c_sum_compensated(struct c_emitter *emitter, const size_t *values, size_t count);
+void emit_c_source(const struct chunk *chunks, FILE *stream);
+void write_c_source(const struct chunk *chunks, const char *path);
+uint64_t hash_text(uint64_t hash, const char *text);
+void format_path(char *path, const char *format, ...) __attribute__((format(printf, 2, 3)));
+void aot_compile(const char *source, const char *source_path, const char *object_path);
+void check_aot_owner(const char *path, bool directory);
+double execute_aot(const struct chunk *chunks);
+struct x86_operand x86_register(int reg);
+struct x86_operand x86_xmm(int reg);
+struct x86_operand x86_stack(size_t slot);
+struct x86_operand x86_rip(size_t label);
+void *grow_array(void *items, size_t *capacity, size_t count, size_t item_size);
+void native_bytes(struct native_code *native, uint64_t value, size_t size);
+void native_text(struct native_code *native, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+size_t native_new_label(struct native_code *native);
+void native_bind_label(struct native_code *native, size_t label);
+void native_fixup(struct native_code *native, size_t label);
+size_t native_constant(struct native_code *native, uint64_t bits);
+size_t native_double(struct native_code *native, double value);
+void x86_operand_text(struct x86_operand operand, char *buffer, size_t size);
+void x86_encode(struct native_code *native, uint8_t prefix, bool wide, uint32_t opcode,
+                size_t opcode_size, int reg, struct x86_operand rm, size_t immediate_size,
+                int64_t immediate);
+void x86_op(struct native_code *native, const char *mnemonic, uint8_t prefix, bool wide,
+            uint32_t opcode, size_t opcode_size, struct x86_operand reg, struct x86_operand rm,
+            bool reg_is_source);
+void x86_group(struct native_code *native, const char *mnemonic, uint32_t opcode,
+               size_t opcode_size, int digit, struct x86_operand rm, size_t immediate_size,
+               int64_t immediate);
+void x86_sse(struct native_code *native, const char *mnemonic, uint8_t prefix, uint8_t opcode,
+             int destination, struct x86_operand source);
+void x86_load(struct native_code *native, int xmm, size_t slot);
+void x86_store(struct native_code *native, int xmm, size_t slot);
+void x86_load_integer(struct native_code *native, int reg, size_t slot);
+void x86_store_integer(struct native_code *native, int reg, size_t slot);
+void x86_compare_sd(struct native_code *native, int predicate, int destination, int source);
+void x86_move_immediate(struct native_code *native, int reg, int64_t value);
+void x86_jump(struct native_code *native, const char *mnemonic, uint32_t opcode,
+              size_t opcode_size, size_t label);
+void x86_call(struct native_code *native, enum native_symbol symbol);
+void x86_check_zero(struct native_code *native, size_t slot, bool integer);
+void x86_check_normal(struct native_code *native, int xmm, size_t label);
+void native_pow_int(struct native_code *native, size_t slot, int64_t exponent);
+void native_poly(struct native_code *native, enum opcode code, const double *coefficients,
+                 size_t degree, size_t slot, size_t scratch);
+void native_neumaier(struct native_code *native, int sum, int compensation, int value);
+void native_sum(struct native_code *native, enum opcode code, size_t slot, size_t count);
+void native_int_power(struct native_code *native, size_t slot);
+void native_fail(struct native_code *native, size_t label, size_t message, size_t length);
+void compile_native(const struct chunk *chunks, struct native_code *native);
+void write_native_object(const struct native_code *native, FILE *file);
+void write_native(const struct chunk *chunks, const char *path, bool object);
+#ifdef VM_PROFILE_CYCLES
+uint64_t vm_profile_clock(void);
+#endif
+#ifdef TRACK_ALLOCATIONS
+void track_live_bytes(enum alloc_subsystem subsystem, size_t freed, size_t allocated);
+void *tracked_malloc(enum alloc_subsystem subsystem, size_t size);
+void *tracked_realloc(enum alloc_subsystem subsystem, void *pointer, size_t size);
+void tracked_free(enum alloc_subsystem subsystem, void *pointer);
+void track_phase(enum pipeline_phase phase);
+void print_allocation_stats(void);
+#endif
+#ifdef VM_PROFILE
+int compare_profile_rows(const void *a, const void *b);
+void print_vm_profile(void);
+#endif
 
 enum opcode get_opcode_from_token_kind(enum token_kind kind);
+enum opcode get_int_opcode_from_token_kind(enum token_kind kind);
 size_t add_constant(struct chunk *chunks, double value);
+size_t add_literal_constant(struct chunk *chunks, double value, const char *text, size_t length);
 void compile_ast_to_bytecode(struct chunk *chunks, struct ast_node *node);
+void compile_as_double(struct chunk *chunks, struct ast_node *node);
 void emit_bytecode(struct chunk *chunks, enum opcode code, size_t const_index);
+void emit_bytecode_with_operand(struct chunk *chunks, enum opcode code, size_t const_index,
+                                size_t operand);
 void init_chunks(struct chunk *chunks);
 void free_chunks(struct chunk *chunks);
 
+struct ast_node *apply_passes(struct ast_node *root, const struct cli_options *opts, size_t *fired);
+void trace_record(const char *name, char phase, bool new_expression);
+size_t latency_bucket(uint64_t value);
+uint64_t latency_bucket_value(size_t bucket);
+void latency_record(size_t phase, uint64_t value);
+void request_latency_report(int signal_number);
+void print_latency_report(void);
+void trace_flush(void);
+size_t count_ast_nodes(const struct ast_node *node);
+bool perf_counters_open(struct perf_counters *counters);
+bool perf_counters_read(const struct perf_counters *counters, uint64_t *values);
+void perf_counters_close(struct perf_counters *counters);
+int compare_u64(const void *a, const void *b);
+int compare_double(const void *a, const void *b);
+void mark_phase_boundary(uint64_t *time, const struct perf_counters *counters, uint64_t *values,
+                         bool *counted);
+void print_phase_json(const char *name, uint64_t *samples, size_t count, size_t units,
+                      const char *unit);
+void print_counters_json(const struct perf_counters *counters, const uint64_t *totals,
+                         size_t runs, size_t units, const char *unit);
+void benchmark_pipeline(const struct cli_options *opts);
+char *generate_corpus(const struct gen_options *options);
+double run_suite_once(enum suite_evaluator evaluator, const char *expression,
+                      const struct cli_options *config, struct chunk *chunks,
+                      const struct acc_chunk *acc, const struct ast_node *root);
+void measure_suite_batches(enum suite_evaluator evaluator, const char *expression,
+                           const struct cli_options *config, struct chunk *chunks,
+                           const struct acc_chunk *acc, const struct ast_node *root,
+                           uint64_t *per_run);
+void summarize_suite_samples(const uint64_t *samples, struct suite_result *result);
+bool suite_regressed(const struct suite_result *result, const struct suite_result *previous,
+                     double threshold, double *change);
+struct suite_result *load_suite_baseline(const char *path, size_t *count);
+struct suite_result *merge_suite_baselines(const struct cli_options *opts, size_t *count);
+struct ast_node *prepare_suite_chunks(const char *expression, const struct cli_options *config,
+                                      struct lexer *lex, struct chunk *chunks,
+                                      struct acc_chunk *acc);
+void free_suite_chunks(struct ast_node *root, struct lexer *lex, struct chunk *chunks,
+                       struct acc_chunk *acc);
+int benchmark_suite(const struct cli_options *opts);
 void process_expression(struct cli_options *opts);
 void print_help(void);
 void parse_args(int argc, char **argv, struct cli_options *opts);
+enum sum_mode parse_sum_mode(const char *name);
+enum poly_scheme parse_poly_scheme(const char *name);
+uint64_t parse_modulus(const char *text);
+enum numeric_mode parse_precision(const char *name);
+char *read_expression_file(const char *path);
+
+double sum_pairwise(const double *values, size_t count);
+double sum_compensated(const double *values, size_t count);
+double sum_values(const double *values, size_t count, enum sum_mode mode);
+struct ast_node *fold_sums(struct ast_node *node, enum sum_mode mode);
+struct ast_node *fuse_multiply_add(struct ast_node *node);
+struct ast_node *create_number_node(double value, bool is_integer, int64_t integer, size_t start,
+                                    size_t end);
+bool is_number(const struct ast_node *node, double value);
+bool is_integer_number(const struct ast_node *node, double value);
+bool has_exact_reciprocal(double value);
+struct ast_node *merge_chain_constants(struct ast_node *node, size_t *fired);
+struct ast_node *simplify_node(struct ast_node *node, bool fast_math, size_t *fired);
+struct ast_node *simplify(struct ast_node *node, bool fast_math, size_t *fired);
+double poly_horner(const double *coefficients, size_t degree, double x);
+double poly_horner_fma(const double *coefficients, size_t degree, double x);
+double poly_estrin(const double *coefficients, size_t degree, double x);
+double eval_poly(enum poly_scheme scheme, const double *coefficients, size_t degree, double x);
+bool ast_equal(const struct ast_node *a, const struct ast_node *b);
+bool get_coefficient(const struct ast_node *node, double *coefficient);
+bool get_monomial(const struct ast_node *node, const struct ast_node **base, int64_t *degree);
+bool get_poly_term(const struct ast_node *node, const struct ast_node **base, int64_t *degree,
+                   double *coefficient);
+struct ast_node *clone_ast_node(const struct ast_node *node);
+struct ast_node *rewrite_polynomials(struct ast_node *node, enum poly_scheme scheme);
+struct ast_node *build_sum_tree(struct ast_node **terms, size_t count, enum sum_mode mode);
 
 double eval_ast(const struct ast_node *root);
+int64_t eval_ast_int(const struct ast_node *root);
+bool int_binary_op(enum token_kind op, int64_t lhs, int64_t rhs, int64_t *result);
+bool int_power(int64_t base, int64_t exponent, int64_t *result);
+double pow_int(double base, int64_t exponent);
+bool get_constant_exponent(const struct ast_node *node, int64_t *exponent);
+enum value_type infer_types(struct ast_node *node, int64_t *value);
 struct ast_node *parse(struct lexer *lex);
+void check_ast_depth(const struct ast_node *root);
 struct ast_node *parse_expression(struct parser *parser, uint8_t binding_power);
 struct ast_node *parse_prefix(struct parser *parser, const struct token *token);
 uint8_t get_left_binding_power(enum token_kind kind);
@@ -126,6 +1068,181 @@ struct token get_next_token(struct parser *parser);
 struct ast_node *create_ast_node(enum node_type type, union node_data data, size_t start,
                                  size_t end);
 void free_ast_node(struct ast_node *node);
+void bigint_init(struct bigint *value);
+void bigint_free(struct bigint *value);
+void bigint_reserve(struct bigint *value, size_t capacity);
+void bigint_normalize(struct bigint *value);
+void bigint_swap(struct bigint *a, struct bigint *b);
+void bigint_copy(struct bigint *dest, const struct bigint *src);
+void bigint_set_limbs(struct bigint *dest, const uint32_t *limbs, size_t size);
+void bigint_slice(struct bigint *dest, const uint32_t *limbs, size_t size, size_t from, size_t to);
+void bigint_from_uint(struct bigint *value, uint64_t number);
+bool bigint_to_uint(const struct bigint *value, uint64_t *number);
+void bigint_from_digits(struct bigint *value, const char *digits, size_t count);
+void check_exact_exponent(const char *text, size_t length, int64_t exponent);
+void bigint_from_literal(struct bigint *value, const char *text, size_t length);
+char *bigint_to_string(const struct bigint *value);
+void bigint_add(struct bigint *result, const struct bigint *a, const struct bigint *b);
+void bigint_sub(struct bigint *result, const struct bigint *a, const struct bigint *b);
+void bigint_negate(struct bigint *value);
+void bigint_mul(struct bigint *result, const struct bigint *a, const struct bigint *b);
+void bigint_mul_with(struct bigint *result, const struct bigint *a, const struct bigint *b,
+                     enum bigint_mul_algorithm algorithm);
+void bigint_mul_small(struct bigint *result, const struct bigint *a, uint32_t factor);
+uint32_t bigint_div_small(struct bigint *result, const struct bigint *a, uint32_t divisor);
+void bigint_divmod(struct bigint *quotient, struct bigint *remainder, const struct bigint *a,
+                   const struct bigint *b);
+void bigint_pow(struct bigint *result, const struct bigint *base, uint64_t exponent);
+void bigint_scale_pow10(struct bigint *value, uint64_t exponent);
+bool parse_decimal_literal(const char *text, size_t length, struct bigint *mantissa,
+                           int64_t *exponent);
+void bigint_binary_op(enum opcode code, struct bigint *result, const struct bigint *lhs,
+                      const struct bigint *rhs);
+
+int mag_compare(const uint32_t *a, size_t an, const uint32_t *b, size_t bn);
+size_t mag_add(uint32_t *result, const uint32_t *a, size_t an, const uint32_t *b, size_t bn);
+void mag_sub(uint32_t *result, const uint32_t *a, size_t an, const uint32_t *b, size_t bn);
+void mag_add_at(uint32_t *result, size_t size, const uint32_t *a, size_t an, size_t offset);
+uint32_t mag_mul_small(uint32_t *result, const uint32_t *a, size_t an, uint32_t factor);
+uint32_t mag_div_small(uint32_t *result, const uint32_t *a, size_t an, uint32_t divisor);
+void mag_mul(uint32_t *result, const uint32_t *a, size_t an, const uint32_t *b, size_t bn,
+             enum bigint_mul_algorithm algorithm);
+void mag_mul_schoolbook(uint32_t *result, const uint32_t *a, size_t an, const uint32_t *b,
+                        size_t bn);
+void mag_mul_karatsuba(uint32_t *result, const uint32_t *a, size_t an, const uint32_t *b,
+                       size_t bn, enum bigint_mul_algorithm algorithm);
+void mag_mul_toom3(uint32_t *result, const uint32_t *a, size_t an, const uint32_t *b, size_t bn,
+                   enum bigint_mul_algorithm algorithm);
+
+void bigint_push(struct bigint_vm *bigint_vm, struct bigint *value);
+struct bigint bigint_pop(struct bigint_vm *bigint_vm);
+void run_bigint_vm(struct bigint_vm *bigint_vm, struct bigint *result);
+void eval_ast_bigint(const struct ast_node *root, struct bigint *result);
+void execute_bigint(struct chunk *chunks, const struct ast_node *root);
+
+int bigint_compare(const struct bigint *a, const struct bigint *b);
+void bigint_lehmer_step(struct bigint *u, struct bigint *v, const int64_t cofactors[4]);
+void bigint_gcd(struct bigint *result, const struct bigint *a, const struct bigint *b);
+
+void rational_init(struct rational *value);
+void rational_free(struct rational *value);
+void rational_copy(struct rational *dest, const struct rational *src);
+void rational_reduce(struct rational *value);
+void rational_maybe_reduce(struct rational *value);
+bool rational_is_integer(struct rational *value);
+void rational_from_literal(struct rational *value, const char *text, size_t length);
+void rational_binary_op(enum opcode code, struct rational *result, const struct rational *lhs,
+                        const struct rational *rhs);
+void rational_pow(struct rational *result, const struct rational *base, uint64_t exponent,
+                  bool invert);
+char *rational_to_string(struct rational *value);
+void rational_push(struct rational_vm *rational_vm, struct rational *value);
+struct rational rational_pop(struct rational_vm *rational_vm);
+void run_rational_vm(struct rational_vm *rational_vm, struct rational *result);
+void eval_ast_rational(const struct ast_node *root, struct rational *result);
+void execute_rational(struct chunk *chunks, const struct ast_node *root);
+
+float pow_int_f32(float base, int64_t exponent);
+float f32_from_literal(const struct literal *literal, double value);
+float f32_binary_op(enum opcode code, float lhs, float rhs);
+float run_f32_vm(struct f32_vm *f32_vm);
+float eval_ast_f32(const struct ast_node *root);
+void execute_f32(struct chunk *chunks, const struct ast_node *root);
+
+double round_toward(double value, double error, int direction);
+double round_overflow(double value, int direction);
+double add_rounded(double a, double b, int direction);
+double mul_rounded(double a, double b, int direction);
+double div_rounded(double a, double b, int direction);
+struct interval interval_point(double value);
+struct interval interval_entire(void);
+struct interval interval_from_literal(const struct literal *literal, double value);
+struct interval interval_negate(struct interval value);
+struct interval interval_add(struct interval lhs, struct interval rhs);
+struct interval interval_sub(struct interval lhs, struct interval rhs);
+struct interval interval_mul(struct interval lhs, struct interval rhs);
+struct interval interval_div(struct interval lhs, struct interval rhs);
+struct interval interval_mod(struct interval lhs, struct interval rhs);
+struct interval interval_pow_int(struct interval base, int64_t exponent);
+struct interval interval_pow(struct interval base, struct interval exponent);
+struct interval interval_binary_op(enum opcode code, struct interval lhs, struct interval rhs);
+struct interval run_interval_vm(struct interval_vm *interval_vm);
+struct interval eval_ast_interval(const struct ast_node *root);
+void execute_interval(struct chunk *chunks, const struct ast_node *root);
+
+struct dd dd_from_double(double value);
+struct dd dd_quick_two_sum(double a, double b);
+struct dd dd_two_sum(double a, double b);
+struct dd dd_two_prod(double a, double b);
+struct dd dd_negate(struct dd value);
+struct dd dd_add(struct dd a, struct dd b);
+struct dd dd_sub(struct dd a, struct dd b);
+struct dd dd_mul(struct dd a, struct dd b);
+struct dd dd_mul_double(struct dd a, double b);
+struct dd dd_div(struct dd a, struct dd b);
+struct dd dd_ldexp(struct dd value, int exponent);
+struct dd dd_trunc(struct dd value);
+struct dd dd_pow_int(struct dd base, int64_t exponent);
+struct dd dd_exp(struct dd value);
+struct dd dd_log(struct dd value);
+struct dd dd_pow(struct dd base, struct dd exponent);
+struct dd dd_fmod(struct dd a, struct dd b);
+struct dd dd_from_literal(const struct literal *literal, double value);
+void dd_to_string(struct dd value, char *buffer, size_t size);
+struct dd dd_binary_op(enum opcode code, struct dd lhs, struct dd rhs);
+struct dd run_dd_vm(struct dd_vm *dd_vm);
+struct dd eval_ast_dd(const struct ast_node *root);
+void execute_dd(struct chunk *chunks, const struct ast_node *root);
+
+void mod_init(struct mod_context *context, uint64_t modulus);
+uint64_t mod_mul(const struct mod_context *context, uint64_t a, uint64_t b);
+uint64_t mod_to(const struct mod_context *context, uint64_t value);
+uint64_t mod_from(const struct mod_context *context, uint64_t value);
+uint64_t mod_add(const struct mod_context *context, uint64_t a, uint64_t b);
+uint64_t mod_sub(const struct mod_context *context, uint64_t a, uint64_t b);
+uint64_t mod_negate(const struct mod_context *context, uint64_t value);
+uint64_t mod_inverse(const struct mod_context *context, uint64_t value);
+uint64_t mod_pow(const struct mod_context *context, uint64_t base, uint64_t exponent);
+uint64_t mod_power(const struct mod_context *context, uint64_t base,
+                   const struct mod_literal *literal);
+uint64_t mod_from_literal(const struct mod_context *context, const struct literal *literal,
+                          struct mod_literal *exact);
+struct mod_literal mod_exact_op(enum opcode code, const struct mod_literal *lhs,
+                                const struct mod_literal *rhs);
+uint64_t mod_binary_op(const struct mod_context *context, enum opcode code, uint64_t lhs,
+                       uint64_t rhs, const struct mod_literal *rhs_literal);
+uint64_t run_mod_vm(struct mod_vm *mod_vm);
+uint64_t eval_ast_mod(const struct ast_node *root, const struct mod_context *context,
+                      struct mod_literal *exact);
+void execute_mod(struct chunk *chunks, const struct ast_node *root, uint64_t modulus);
+
+uint64_t now_ns(void);
+uint64_t next_random(uint64_t *state);
+void benchmark_bigint_multiplication(void);
+const char *rational_mode_obstacle(const struct ast_node *node, struct rational *value);
+const char *bigint_mode_obstacle(const struct ast_node *node, struct bigint *value,
+                                 bool *truncated);
+const char *exact_mode_obstacle(const struct ast_node *node, bool integers_only, bool *truncated);
+bool exact_mode_supported(const struct ast_node *node, bool integers_only);
+void print_benchmark_row(const char *mode, uint64_t elapsed, size_t iterations, double baseline,
+                         const char *result);
+void benchmark_numeric_modes(struct chunk *chunks, const struct ast_node *root);
+
+void gen_flush(struct gen_state *gen);
+void gen_write(struct gen_state *gen, const char *text, size_t length);
+void gen_write_digits(struct gen_state *gen, uint64_t value, size_t min_width);
+uint64_t gen_below(struct gen_state *gen, uint64_t bound);
+void gen_literal(struct gen_state *gen, bool nonzero);
+char gen_operator(struct gen_state *gen, bool right_is_leaf);
+int32_t gen_add_node(struct gen_state *gen, int32_t left, int32_t right);
+size_t gen_capacity(size_t depth);
+int32_t gen_build(struct gen_state *gen, size_t leaves, size_t depth);
+int gen_precedence(char op);
+void gen_print(struct gen_state *gen, int32_t root);
+void generate_expressions(const struct gen_options *options, FILE *stream);
+void parse_gen_spec(char *spec, struct gen_options *options);
+
+char *get_poly_scheme_string(enum poly_scheme scheme);
 char *get_token_kind_string(enum token_kind kind);
 void print_indent(size_t level);
 void print_ast_json(const struct ast_node *node, size_t level);
@@ -147,7 +1264,7 @@ void push(struct vm *stack_vm, double value)
         exit(EXIT_FAILURE);
     }
 
-    stack_vm->stack[stack_vm->top++] = value;
+    stack_vm->stack[stack_vm->top++].number = value;
 }
 
 double pop(struct vm *stack_vm)
@@ -157,14 +1274,61 @@ double pop(struct vm *stack_vm)
         exit(EXIT_FAILURE);
     }
 
-    return stack_vm->stack[--stack_vm->top];
+    return stack_vm->stack[--stack_vm->top].number;
+}
+
+void push_int(struct vm *stack_vm, int64_t value)
+{
+    if (stack_vm->top >= MAX_STACK_SIZE) {
+        (void)fprintf(stderr, "Stack overflow\n");
+        exit(EXIT_FAILURE);
+    }
+
+    stack_vm->stack[stack_vm->top++].integer = value;
+}
+
+int64_t pop_int(struct vm *stack_vm)
+{
+    if (stack_vm->top <= 0) {
+        (void)fprintf(stderr, "Stack undeflow\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return stack_vm->stack[--stack_vm->top].integer;
 }
 
-double run_vm(struct vm *stack_vm)
+union value run_vm(struct vm *stack_vm)
 {
+#ifdef VM_PROFILE
+    enum opcode previous = OP_COUNT;
+#ifdef VM_PROFILE_CYCLES
+    uint64_t started = 0;
+#endif
+#endif
+
     while (true) {
         struct bytecode instruction = stack_vm->chunks->code[stack_vm->ip];
 
+#ifdef VM_PROFILE
+        // Each dispatch closes the previous instruction, so its cycles include the dispatch.
+        vm_profile.counts[instruction.code] += 1;
+
+        if (previous != OP_COUNT) {
+            vm_profile.pairs[previous][instruction.code] += 1;
+#ifdef VM_PROFILE_CYCLES
+            uint64_t now = vm_profile_clock();
+            vm_profile.cycles[previous] += now - started;
+            started = now;
+#endif
+        }
+#ifdef VM_PROFILE_CYCLES
+        else {
+            started = vm_profile_clock();
+        }
+#endif
+        previous = instruction.code;
+#endif
+
         switch (instruction.code) {
         case OP_CONSTANT: {
             double value = stack_vm->chunks->constants[instruction.const_index];
@@ -224,8 +1388,149 @@ double run_vm(struct vm *stack_vm)
             push(stack_vm, pow(lhs, rhs));
         } break;
 
+        case OP_POW_INT: {
+            double value = pop(stack_vm);
+            push(stack_vm, pow_int(value, (int64_t)instruction.operand));
+        } break;
+
+        case OP_FMA:
+        case OP_FMS: {
+            double addend = pop(stack_vm);
+            double multiplier = pop(stack_vm);
+            double multiplicand = pop(stack_vm);
+
+            push(stack_vm,
+                 fma(multiplicand, multiplier, instruction.code == OP_FMA ? addend : -addend));
+        } break;
+
+        case OP_SQRT: {
+            double value = pop(stack_vm);
+            push(stack_vm, sqrt(value));
+        } break;
+
+        case OP_HORNER:
+        case OP_HORNER_FMA:
+        case OP_ESTRIN: {
+            // The coefficients are consecutive constants starting at const_index.
+            enum poly_scheme scheme = instruction.code == OP_HORNER       ? POLY_HORNER
+                                      : instruction.code == OP_HORNER_FMA ? POLY_HORNER_FMA
+                                                                          : POLY_ESTRIN;
+            double x = pop(stack_vm);
+
+            push(stack_vm,
+                 eval_poly(scheme, &stack_vm->chunks->constants[instruction.const_index],
+                           instruction.operand, x));
+        } break;
+
+        case OP_SUM_N:
+        case OP_COMPENSATED_SUM_N: {
+            size_t count = instruction.operand;
+
+            if (stack_vm->top < count) {
+                (void)fprintf(stderr, "Stack undeflow\n");
+                exit(EXIT_FAILURE);
+            }
+
+            enum sum_mode mode =
+                instruction.code == OP_SUM_N ? SUM_PAIRWISE : SUM_COMPENSATED;
+            double values[SUM_BLOCK_SIZE];
+
+            stack_vm->top -= count;
+            for (size_t i = 0; i < count; i++) {
+                values[i] = stack_vm->stack[stack_vm->top + i].number;
+            }
+
+            push(stack_vm, sum_values(values, count, mode));
+        } break;
+
+        case OP_INT_CONSTANT: {
+            push_int(stack_vm, (int64_t)instruction.operand);
+        } break;
+
+        case OP_INT_NEGATE: {
+            int64_t value = pop_int(stack_vm);
+            int64_t result = 0;
+
+            if (__builtin_sub_overflow((int64_t)0, value, &result)) {
+                (void)fprintf(stderr, "Integer overflow\n");
+                exit(EXIT_FAILURE);
+            }
+
+            push_int(stack_vm, result);
+        } break;
+
+        case OP_INT_ADD: {
+            int64_t rhs = pop_int(stack_vm);
+            int64_t lhs = pop_int(stack_vm);
+            int64_t result = 0;
+
+            if (__builtin_add_overflow(lhs, rhs, &result)) {
+                (void)fprintf(stderr, "Integer overflow\n");
+                exit(EXIT_FAILURE);
+            }
+
+            push_int(stack_vm, result);
+        } break;
+        case OP_INT_SUBTRACT: {
+            int64_t rhs = pop_int(stack_vm);
+            int64_t lhs = pop_int(stack_vm);
+            int64_t result = 0;
+
+            if (__builtin_sub_overflow(lhs, rhs, &result)) {
+                (void)fprintf(stderr, "Integer overflow\n");
+                exit(EXIT_FAILURE);
+            }
+
+            push_int(stack_vm, result);
+        } break;
+        case OP_INT_MULTIPLY: {
+            int64_t rhs = pop_int(stack_vm);
+            int64_t lhs = pop_int(stack_vm);
+            int64_t result = 0;
+
+            if (__builtin_mul_overflow(lhs, rhs, &result)) {
+                (void)fprintf(stderr, "Integer overflow\n");
+                exit(EXIT_FAILURE);
+            }
+
+            push_int(stack_vm, result);
+        } break;
+        case OP_INT_MODULO: {
+            int64_t rhs = pop_int(stack_vm);
+            int64_t lhs = pop_int(stack_vm);
+
+            if (rhs == 0) {
+                (void)fprintf(stderr, "Division by zero\n");
+                exit(EXIT_FAILURE);
+            }
+
+            // INT64_MIN % -1 traps on x86 even though the result is representable.
+            push_int(stack_vm, rhs == -1 ? 0 : lhs % rhs);
+        } break;
+        case OP_INT_POWER: {
+            int64_t rhs = pop_int(stack_vm);
+            int64_t lhs = pop_int(stack_vm);
+            int64_t result = 0;
+
+            if (!int_power(lhs, rhs, &result)) {
+                (void)fprintf(stderr, "Integer overflow\n");
+                exit(EXIT_FAILURE);
+            }
+
+            push_int(stack_vm, result);
+        } break;
+
+        case OP_INT_TO_DOUBLE: {
+            push(stack_vm, (double)pop_int(stack_vm));
+        } break;
+
         case OP_HALT: {
-            return pop(stack_vm);
+            if (stack_vm->top <= 0) {
+                (void)fprintf(stderr, "Stack undeflow\n");
+                exit(EXIT_FAILURE);
+            }
+
+            return stack_vm->stack[--stack_vm->top];
         }
 
         default: {
@@ -238,103 +1543,375 @@ double run_vm(struct vm *stack_vm)
     }
 }
 
-void free_chunks(struct chunk *chunks)
+void tail_fail(const char *message)
 {
-    if (!chunks) {
-        return;
+    (void)fprintf(stderr, "%s\n", message);
+    exit(EXIT_FAILURE);
+}
+
+double tail_sum(const union value *values, size_t count, enum sum_mode mode)
+{
+    // Kept out of the handler so its frame has no address-taken locals, which musttail does not
+    // allow.
+    double numbers[SUM_BLOCK_SIZE];
+
+    for (size_t i = 0; i < count; i++) {
+        numbers[i] = values[i].number;
     }
 
-    free(chunks->code);
-    chunks->code = NULL;
+    return sum_values(numbers, count, mode);
+}
 
-    free(chunks->constants);
-    chunks->constants = NULL;
+TAIL_HANDLER(tail_constant)
+{
+    *++sp = tos;
+    tos.number = constants[ip->const_index];
+    TAIL_DISPATCH();
 }
 
-void init_chunks(struct chunk *chunks)
+TAIL_HANDLER(tail_negate)
 {
-    chunks->code_capacity = DEFAULT_CAPACITY;
-    chunks->code_size = 0;
-    chunks->code = malloc(chunks->code_capacity * sizeof(*chunks->code));
+    tos.number = -tos.number;
+    TAIL_DISPATCH();
+}
 
-    if (!chunks->code) {
-        (void)fprintf(stderr, "Go download more ram\n");
-        exit(EXIT_FAILURE);
-    }
+TAIL_HANDLER(tail_add)
+{
+    tos.number = (sp--)->number + tos.number;
+    TAIL_DISPATCH();
+}
 
-    chunks->const_capacity = DEFAULT_CAPACITY;
-    chunks->const_size = 0;
-    chunks->constants = malloc(chunks->const_capacity * sizeof(*chunks->constants));
+TAIL_HANDLER(tail_subtract)
+{
+    tos.number = (sp--)->number - tos.number;
+    TAIL_DISPATCH();
+}
 
-    if (!chunks->constants) {
-        (void)fprintf(stderr, "Go download more ram\n");
-        exit(EXIT_FAILURE);
+TAIL_HANDLER(tail_multiply)
+{
+    tos.number = (sp--)->number * tos.number;
+    TAIL_DISPATCH();
+}
+
+TAIL_HANDLER(tail_divide)
+{
+    if (tos.number == 0.0) {
+        tail_fail("Division by zero");
     }
+
+    tos.number = (sp--)->number / tos.number;
+    TAIL_DISPATCH();
 }
 
-enum opcode get_opcode_from_token_kind(enum token_kind kind)
+TAIL_HANDLER(tail_modulo)
 {
-    switch (kind) {
-    case NUMBER:
-        return OP_CONSTANT;
+    if (tos.number == 0.0) {
+        tail_fail("Division by zero");
+    }
+
+    tos.number = fmod((sp--)->number, tos.number);
+    TAIL_DISPATCH();
+}
+
+TAIL_HANDLER(tail_power)
+{
+    tos.number = pow((sp--)->number, tos.number);
+    TAIL_DISPATCH();
+}
+
+TAIL_HANDLER(tail_pow_int)
+{
+    tos.number = pow_int(tos.number, (int64_t)ip->operand);
+    TAIL_DISPATCH();
+}
+
+TAIL_HANDLER(tail_fma)
+{
+    double addend = ip->code == OP_FMA ? tos.number : -tos.number;
+    double multiplier = (sp--)->number;
+
+    tos.number = fma((sp--)->number, multiplier, addend);
+    TAIL_DISPATCH();
+}
+
+TAIL_HANDLER(tail_sqrt)
+{
+    tos.number = sqrt(tos.number);
+    TAIL_DISPATCH();
+}
+
+TAIL_HANDLER(tail_poly)
+{
+    enum poly_scheme scheme = ip->code == OP_HORNER       ? POLY_HORNER
+                              : ip->code == OP_HORNER_FMA ? POLY_HORNER_FMA
+                                                          : POLY_ESTRIN;
+
+    tos.number = eval_poly(scheme, &constants[ip->const_index], ip->operand, tos.number);
+    TAIL_DISPATCH();
+}
+
+TAIL_HANDLER(tail_sum_n)
+{
+    // Spilling tos first leaves all the terms contiguous on the stack.
+    *++sp = tos;
+    sp -= ip->operand;
+    tos.number =
+        tail_sum(sp + 1, ip->operand, ip->code == OP_SUM_N ? SUM_PAIRWISE : SUM_COMPENSATED);
+    TAIL_DISPATCH();
+}
+
+TAIL_HANDLER(tail_int_constant)
+{
+    *++sp = tos;
+    tos.integer = (int64_t)ip->operand;
+    TAIL_DISPATCH();
+}
+
+TAIL_HANDLER(tail_int_negate)
+{
+    if (__builtin_sub_overflow((int64_t)0, tos.integer, &tos.integer)) {
+        tail_fail("Integer overflow");
+    }
+
+    TAIL_DISPATCH();
+}
+
+TAIL_HANDLER(tail_int_add)
+{
+    if (__builtin_add_overflow((sp--)->integer, tos.integer, &tos.integer)) {
+        tail_fail("Integer overflow");
+    }
+
+    TAIL_DISPATCH();
+}
+
+TAIL_HANDLER(tail_int_subtract)
+{
+    if (__builtin_sub_overflow((sp--)->integer, tos.integer, &tos.integer)) {
+        tail_fail("Integer overflow");
+    }
+
+    TAIL_DISPATCH();
+}
+
+TAIL_HANDLER(tail_int_multiply)
+{
+    if (__builtin_mul_overflow((sp--)->integer, tos.integer, &tos.integer)) {
+        tail_fail("Integer overflow");
+    }
+
+    TAIL_DISPATCH();
+}
+
+TAIL_HANDLER(tail_int_modulo)
+{
+    if (tos.integer == 0) {
+        tail_fail("Division by zero");
+    }
+
+    // INT64_MIN % -1 traps on x86 even though the result is representable.
+    int64_t lhs = (sp--)->integer;
+    tos.integer = tos.integer == -1 ? 0 : lhs % tos.integer;
+    TAIL_DISPATCH();
+}
+
+TAIL_HANDLER(tail_int_power)
+{
+    int64_t exponent = tos.integer;
+
+    if (!int_power((sp--)->integer, exponent, &tos.integer)) {
+        tail_fail("Integer overflow");
+    }
+
+    TAIL_DISPATCH();
+}
+
+TAIL_HANDLER(tail_int_to_double)
+{
+    tos.number = (double)tos.integer;
+    TAIL_DISPATCH();
+}
+
+TAIL_HANDLER(tail_halt)
+{
+    (void)ip;
+    (void)sp;
+    (void)constants;
+
+    return tos;
+}
+
+TAIL_HANDLER(tail_unknown)
+{
+    (void)ip;
+    (void)sp;
+    (void)tos;
+    (void)constants;
+
+    (void)fprintf(stderr, "Unknown instruction code");
+    exit(EXIT_FAILURE);
+}
+
+union value run_tail_vm(const struct chunk *chunks)
+{
+    // Slot 0 receives the meaningless tos spilled by the first push, so pushes need no special
+    // case for an empty stack.
+    union value stack[MAX_STACK_SIZE + 1];
+    const struct bytecode *ip = chunks->code;
+
+    // run_vm checks every push and pop, the handlers rely on the depth the compiler tracked.
+    if (chunks->underflow) {
+        tail_fail("Stack undeflow");
+    }
+
+    if (chunks->max_depth > MAX_STACK_SIZE) {
+        tail_fail("Stack overflow");
+    }
+
+#ifdef TAIL_TRAMPOLINE
+    tail_next = (struct tail_state){ .ip = ip, .sp = stack, .tos = { .integer = 0 } };
+
+    while (tail_next.ip->code != OP_HALT) {
+        struct tail_state state = tail_next;
+        tail_handlers[state.ip->code](state.ip, state.sp, state.tos, chunks->constants);
+    }
+
+    return tail_next.tos;
+#else
+    return tail_handlers[ip->code](ip, stack, (union value){ .integer = 0 }, chunks->constants);
+#endif
+}
+
+enum acc_opcode get_acc_opcode(enum token_kind kind, bool integer, bool reverse)
+{
+    switch (kind) {
     case PLUS:
-        return OP_ADD;
+        return integer ? ACC_INT_ADD : ACC_ADD;
     case MINUS:
-        return OP_SUBTRACT;
+        return integer ? (reverse ? ACC_INT_REVERSE_SUBTRACT : ACC_INT_SUBTRACT)
+                       : (reverse ? ACC_REVERSE_SUBTRACT : ACC_SUBTRACT);
     case STAR:
-        return OP_MULTIPLY;
+        return integer ? ACC_INT_MULTIPLY : ACC_MULTIPLY;
     case SLASH:
-        return OP_DIVIDE;
+        if (!integer) {
+            return reverse ? ACC_REVERSE_DIVIDE : ACC_DIVIDE;
+        }
+        break;
     case PERCENT:
-        return OP_MODULO;
+        return integer ? (reverse ? ACC_INT_REVERSE_MODULO : ACC_INT_MODULO)
+                       : (reverse ? ACC_REVERSE_MODULO : ACC_MODULO);
     case CARET:
-        return OP_POWER;
-    default: {
-        return OP_HALT;
-    }
+        return integer ? (reverse ? ACC_INT_REVERSE_POWER : ACC_INT_POWER)
+                       : (reverse ? ACC_REVERSE_POWER : ACC_POWER);
+    default:
+        break;
     }
+
+    (void)fprintf(stderr, "No such binary operator");
+    exit(EXIT_FAILURE);
 }
 
-size_t add_constant(struct chunk *chunks, double value)
+void emit_acc(struct acc_chunk *chunk, enum acc_opcode code, enum acc_mode mode, size_t index,
+              size_t operand)
 {
-    size_t index = chunks->const_size;
-    if (chunks->const_size >= chunks->const_capacity) {
-        chunks->const_capacity *= 2;
+    chunk->code = grow_array(chunk->code, &chunk->code_capacity, chunk->code_size,
+                             sizeof(*chunk->code));
+    chunk->code[chunk->code_size++] = (struct acc_instruction){
+        .code = code, .mode = mode, .index = index, .operand = operand
+    };
+}
 
-        double *new_constants =
-            realloc(chunks->constants, chunks->const_capacity * sizeof(*chunks->constants));
+size_t add_acc_constant(struct acc_chunk *chunk, union value value)
+{
+    chunk->constants = grow_array(chunk->constants, &chunk->constant_capacity,
+                                  chunk->constant_size, sizeof(*chunk->constants));
+    chunk->constants[chunk->constant_size] = value;
 
-        if (!new_constants) {
-            (void)fprintf(stderr, "Go download more ram\n");
-            exit(EXIT_FAILURE);
-        }
+    return chunk->constant_size++;
+}
 
-        chunks->constants = new_constants;
+void emit_acc_store(struct acc_chunk *chunk, size_t temp)
+{
+    emit_acc(chunk, ACC_STORE, ACC_TEMP, temp, 0);
+    chunk->temps = temp + 1 > chunk->temps ? temp + 1 : chunk->temps;
+}
+
+size_t add_acc_leaf(struct acc_chunk *chunk, const struct ast_node *leaf, bool integer)
+{
+    // Integer literals read as doubles are converted here, exactly like OP_INT_TO_DOUBLE would.
+    if (integer) {
+        return add_acc_constant(chunk, (union value){ .integer = leaf->data.number.integer });
     }
 
-    chunks->constants[chunks->const_size++] = value;
+    double number = leaf->value_type == VALUE_INT ? (double)leaf->data.number.integer
+                                                  : leaf->data.number.value;
 
-    return index;
+    return add_acc_constant(chunk, (union value){ .number = number });
 }
 
-void compile_ast_to_bytecode(struct chunk *chunks, struct ast_node *node)
+void compile_acc_to_temp(struct acc_chunk *chunk, const struct ast_node *node, size_t temp)
 {
-    if (!node) {
+    // Stores node as a double. Literals skip ACC, so a term costs one dispatch like OP_CONSTANT.
+    if (node->type == NODE_NUMBER) {
+        emit_acc(chunk, ACC_COPY, ACC_CONSTANT, add_acc_leaf(chunk, node, false), temp);
+        chunk->temps = temp + 1 > chunk->temps ? temp + 1 : chunk->temps;
+        return;
+    }
+
+    compile_acc_as(chunk, node, temp, false);
+    emit_acc_store(chunk, temp);
+}
+
+void compile_acc_binary(struct acc_chunk *chunk, const struct ast_node *node, size_t temp)
+{
+    const struct ast_node *left = node->data.binary.left;
+    const struct ast_node *right = node->data.binary.right;
+    bool integer = node->value_type == VALUE_INT;
+    enum token_kind op = node->data.binary.op;
+
+    if (right->type == NODE_NUMBER) {
+        compile_acc_as(chunk, left, temp, integer);
+        emit_acc(chunk, get_acc_opcode(op, integer, false), ACC_CONSTANT,
+                 add_acc_leaf(chunk, right, integer), 0);
+        return;
+    }
+
+    // The reverse forms take the left operand from K or TMP and the right one from ACC.
+    if (left->type == NODE_NUMBER) {
+        compile_acc_as(chunk, right, temp, integer);
+        emit_acc(chunk, get_acc_opcode(op, integer, true), ACC_CONSTANT,
+                 add_acc_leaf(chunk, left, integer), 0);
         return;
     }
 
+    compile_acc_as(chunk, left, temp, integer);
+    emit_acc_store(chunk, temp);
+    compile_acc_as(chunk, right, temp + 1, integer);
+    emit_acc(chunk, get_acc_opcode(op, integer, true), ACC_TEMP, temp, 0);
+}
+
+void compile_ast_to_accumulator(struct acc_chunk *chunk, const struct ast_node *node, size_t temp)
+{
+    // Leaves the value of node in ACC, typed like node. Temporaries below temp hold values of
+    // enclosing expressions and are not touched.
     switch (node->type) {
     case NODE_NUMBER: {
-        size_t const_index = add_constant(chunks, node->data.number.value);
-        emit_bytecode(chunks, OP_CONSTANT, const_index);
+        bool integer = node->value_type == VALUE_INT;
+        emit_acc(chunk, integer ? ACC_INT_LOAD : ACC_LOAD, ACC_CONSTANT,
+                 add_acc_leaf(chunk, node, integer), 0);
     } break;
 
     case NODE_UNARY: {
-        compile_ast_to_bytecode(chunks, node->data.unary.child);
+        bool integer = node->value_type == VALUE_INT;
+        compile_acc_as(chunk, node->data.unary.child, temp, integer);
 
         switch (node->data.unary.op) {
         case MINUS: {
-            emit_bytecode(chunks, OP_NEGATE, 0);
+            emit_acc(chunk, integer ? ACC_INT_NEGATE : ACC_NEGATE, ACC_NONE, 0, 0);
+        } break;
+
+        case SQRT: {
+            emit_acc(chunk, ACC_SQRT, ACC_NONE, 0, 0);
         } break;
 
         case PLUS:
@@ -344,618 +1921,10384 @@ void compile_ast_to_bytecode(struct chunk *chunks, struct ast_node *node)
             (void)fprintf(stderr, "No such unary operator");
             exit(EXIT_FAILURE);
         }
-        };
+        }
     } break;
 
     case NODE_BINARY: {
-        compile_ast_to_bytecode(chunks, node->data.binary.left);
-        compile_ast_to_bytecode(chunks, node->data.binary.right);
+        int64_t exponent = 0;
 
-        emit_bytecode(chunks, get_opcode_from_token_kind(node->data.binary.op), 0);
-    } break;
-    }
-}
+        if (node->value_type != VALUE_INT && node->data.binary.op == CARET &&
+            get_constant_exponent(node->data.binary.right, &exponent)) {
+            compile_acc_as(chunk, node->data.binary.left, temp, false);
+            emit_acc(chunk, ACC_POW_INT, ACC_NONE, 0, (size_t)exponent);
+            break;
+        }
 
-void emit_bytecode(struct chunk *chunks, enum opcode code, size_t const_index)
-{
-    if (chunks->code_size >= chunks->code_capacity) {
-        chunks->code_capacity *= 2;
+        compile_acc_binary(chunk, node, temp);
+    } break;
 
-        struct bytecode *new_code =
-            realloc(chunks->code, chunks->code_capacity * sizeof(*chunks->code));
+    case NODE_SUM: {
+        enum acc_opcode code =
+            node->data.sum.mode == SUM_COMPENSATED ? ACC_COMPENSATED_SUM_N : ACC_SUM_N;
+        size_t count = node->data.sum.count;
+        bool leaves = true;
 
-        if (!new_code) {
-            (void)fprintf(stderr, "Go download more ram\n");
-            exit(EXIT_FAILURE);
+        for (size_t i = 0; i < count; i++) {
+            leaves = leaves && node->data.sum.terms[i]->type == NODE_NUMBER;
         }
 
-        chunks->code = new_code;
-    }
-
-    chunks->code[chunks->code_size++] =
-        (struct bytecode){ .code = code, .const_index = const_index };
-}
+        // A chain of literals is summed straight from consecutive pool entries. Otherwise the
+        // terms go to TMP[temp..] in order, except the last one which is read from ACC.
+        if (leaves) {
+            size_t first = chunk->constant_size;
 
-double eval_ast(const struct ast_node *root)
-{
-    switch (root->type) {
-    case NODE_NUMBER: {
-        return root->data.number.value;
-    }
+            for (size_t i = 0; i < count; i++) {
+                add_acc_leaf(chunk, node->data.sum.terms[i], false);
+            }
 
-    case NODE_UNARY: {
-        switch (root->data.unary.op) {
-        case MINUS:
-            return -eval_ast(root->data.unary.child);
-        case PLUS:
-            return eval_ast(root->data.unary.child);
-        default: {
-            (void)fprintf(stderr, "Unknown unary operator\n");
-            exit(EXIT_FAILURE);
+            emit_acc(chunk, code, ACC_CONSTANT, first, count);
+            break;
         }
+
+        for (size_t i = 0; i + 1 < count; i++) {
+            compile_acc_to_temp(chunk, node->data.sum.terms[i], temp + i);
         }
-    }
 
-    case NODE_BINARY: {
-        double lhs = eval_ast(root->data.binary.left);
-        double rhs = eval_ast(root->data.binary.right);
+        compile_acc_as(chunk, node->data.sum.terms[count - 1], temp + count - 1, false);
+        emit_acc(chunk, code, ACC_TEMP, temp, count);
+    } break;
 
-        switch (root->data.binary.op) {
-        case PLUS:
-            return lhs + rhs;
-        case MINUS:
-            return lhs - rhs;
-        case SLASH: {
-            if (rhs == 0.0) {
-                (void)fprintf(stderr, "Division by zero\n");
-                exit(EXIT_FAILURE);
-            }
+    case NODE_FMA: {
+        compile_acc_to_temp(chunk, node->data.fma.multiplicand, temp);
+        compile_acc_to_temp(chunk, node->data.fma.multiplier, temp + 1);
+        compile_acc_as(chunk, node->data.fma.addend, temp + 2, false);
+        emit_acc(chunk, node->data.fma.subtract ? ACC_FMS : ACC_FMA, ACC_TEMP, temp, 0);
+    } break;
 
-            return lhs / rhs;
-        }
-        case STAR:
-            return lhs * rhs;
-        case CARET:
-            return pow(lhs, rhs);
-        case PERCENT: {
-            if (rhs == 0.0) {
-                (void)fprintf(stderr, "Division by zero\n");
-                exit(EXIT_FAILURE);
-            }
+    case NODE_POLY: {
+        compile_acc_as(chunk, node->data.poly.base, temp, false);
 
-            return fmod(lhs, rhs);
-        }
-        default: {
-            (void)fprintf(stderr, "Unknown binary operator\n");
-            exit(EXIT_FAILURE);
-        }
+        // Coefficients go to their own pool, eval_poly needs them as consecutive doubles.
+        size_t first = chunk->coefficient_size;
+        for (size_t i = 0; i <= node->data.poly.degree; i++) {
+            chunk->coefficients = grow_array(chunk->coefficients, &chunk->coefficient_capacity,
+                                             chunk->coefficient_size, sizeof(*chunk->coefficients));
+            chunk->coefficients[chunk->coefficient_size++] = node->data.poly.coefficients[i];
         }
-    }
+
+        enum acc_opcode code = node->data.poly.scheme == POLY_HORNER_FMA ? ACC_HORNER_FMA
+                               : node->data.poly.scheme == POLY_ESTRIN   ? ACC_ESTRIN
+                                                                         : ACC_HORNER;
+        emit_acc(chunk, code, ACC_NONE, first, node->data.poly.degree);
+    } break;
     }
 }
 
-char *get_token_kind_string(enum token_kind kind)
+void compile_acc_as(struct acc_chunk *chunk, const struct ast_node *node, size_t temp,
+                    bool integer)
 {
-    switch (kind) {
-    case MINUS:
-        return "-";
-    case PLUS:
-        return "+";
-    case SLASH:
-        return "/";
-    case STAR:
-        return "*";
-    case CARET:
-        return "expt";
-    case PERCENT:
-        return "mod";
-    default:
-        return "?";
+    if (!integer && node->type == NODE_NUMBER) {
+        emit_acc(chunk, ACC_LOAD, ACC_CONSTANT, add_acc_leaf(chunk, node, false), 0);
+        return;
+    }
+
+    compile_ast_to_accumulator(chunk, node, temp);
+
+    if (!integer && node->value_type == VALUE_INT) {
+        emit_acc(chunk, ACC_INT_TO_DOUBLE, ACC_NONE, 0, 0);
     }
 }
 
-void print_indent(size_t level)
+void compile_accumulator(struct acc_chunk *chunk, const struct ast_node *root)
 {
-    for (size_t i = 0; i < level; i++) {
-        printf(" ");
-    }
+    compile_ast_to_accumulator(chunk, root, 0);
+    emit_acc(chunk, ACC_HALT, ACC_NONE, 0, 0);
 }
 
-void print_ast_json(const struct ast_node *node, size_t level)
+void free_acc_chunk(struct acc_chunk *chunk)
 {
-    if (!node) {
-        printf("null");
-        return;
-    }
+    free(chunk->code);
+    free(chunk->constants);
+    free(chunk->coefficients);
+    *chunk = (struct acc_chunk){ 0 };
+}
 
-    size_t indent = level * 2;
+union value acc_operand(const struct acc_chunk *chunk, const union value *temps,
+                        const struct acc_instruction *instruction)
+{
+    return instruction->mode == ACC_CONSTANT ? chunk->constants[instruction->index]
+                                             : temps[instruction->index];
+}
 
-    switch (node->type) {
-    case NODE_NUMBER: {
-        printf("{\n");
-        print_indent(indent + 2);
-        printf("\"type\": \"number\",\n");
-        print_indent(indent + 2);
-        printf("\"value\": %g,\n", node->data.number.value);
-        print_indent(indent + 2);
-        printf("\"start\": %zu,\n", node->start);
-        print_indent(indent + 2);
-        printf("\"end\": %zu\n", node->end);
-        print_indent(indent);
-        printf("}");
-    } break;
+union value run_acc_vm(const struct acc_chunk *chunk)
+{
+    union value temps[MAX_STACK_SIZE];
+    union value acc = { .integer = 0 };
 
+    if (chunk->temps > MAX_STACK_SIZE) {
+        (void)fprintf(stderr, "Stack overflow\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (const struct acc_instruction *instruction = chunk->code;; instruction++) {
+        switch (instruction->code) {
+        case ACC_LOAD:
+        case ACC_INT_LOAD: {
+            acc = chunk->constants[instruction->index];
+        } break;
+        case ACC_STORE: {
+            temps[instruction->index] = acc;
+        } break;
+        case ACC_COPY: {
+            temps[instruction->operand] = chunk->constants[instruction->index];
+        } break;
+
+        case ACC_ADD: {
+            acc.number = acc.number + acc_operand(chunk, temps, instruction).number;
+        } break;
+        case ACC_SUBTRACT: {
+            acc.number = acc.number - acc_operand(chunk, temps, instruction).number;
+        } break;
+        case ACC_REVERSE_SUBTRACT: {
+            acc.number = acc_operand(chunk, temps, instruction).number - acc.number;
+        } break;
+        case ACC_MULTIPLY: {
+            acc.number = acc.number * acc_operand(chunk, temps, instruction).number;
+        } break;
+        case ACC_DIVIDE:
+        case ACC_REVERSE_DIVIDE:
+        case ACC_MODULO:
+        case ACC_REVERSE_MODULO: {
+            double operand = acc_operand(chunk, temps, instruction).number;
+            bool reverse = instruction->code == ACC_REVERSE_DIVIDE ||
+                           instruction->code == ACC_REVERSE_MODULO;
+            double lhs = reverse ? operand : acc.number;
+            double rhs = reverse ? acc.number : operand;
+
+            if (rhs == 0.0) {
+                (void)fprintf(stderr, "Division by zero\n");
+                exit(EXIT_FAILURE);
+            }
+
+            bool divide =
+                instruction->code == ACC_DIVIDE || instruction->code == ACC_REVERSE_DIVIDE;
+            acc.number = divide ? lhs / rhs : fmod(lhs, rhs);
+        } break;
+        case ACC_POWER: {
+            acc.number = pow(acc.number, acc_operand(chunk, temps, instruction).number);
+        } break;
+        case ACC_REVERSE_POWER: {
+            acc.number = pow(acc_operand(chunk, temps, instruction).number, acc.number);
+        } break;
+
+        case ACC_NEGATE: {
+            acc.number = -acc.number;
+        } break;
+        case ACC_SQRT: {
+            acc.number = sqrt(acc.number);
+        } break;
+        case ACC_POW_INT: {
+            acc.number = pow_int(acc.number, (int64_t)instruction->operand);
+        } break;
+        case ACC_INT_TO_DOUBLE: {
+            acc.number = (double)acc.integer;
+        } break;
+
+        case ACC_FMA:
+        case ACC_FMS: {
+            const union value *factors = &temps[instruction->index];
+            acc.number = fma(factors[0].number, factors[1].number,
+                             instruction->code == ACC_FMA ? acc.number : -acc.number);
+        } break;
+
+        case ACC_HORNER:
+        case ACC_HORNER_FMA:
+        case ACC_ESTRIN: {
+            enum poly_scheme scheme = instruction->code == ACC_HORNER       ? POLY_HORNER
+                                      : instruction->code == ACC_HORNER_FMA ? POLY_HORNER_FMA
+                                                                            : POLY_ESTRIN;
+            acc.number = eval_poly(scheme, &chunk->coefficients[instruction->index],
+                                   instruction->operand, acc.number);
+        } break;
+
+        case ACC_SUM_N:
+        case ACC_COMPENSATED_SUM_N: {
+            const union value *source = instruction->mode == ACC_CONSTANT
+                                            ? &chunk->constants[instruction->index]
+                                            : &temps[instruction->index];
+            bool in_acc = instruction->mode == ACC_TEMP;
+            size_t stored = instruction->operand - in_acc;
+            double values[SUM_BLOCK_SIZE];
+
+            for (size_t i = 0; i < stored; i++) {
+                values[i] = source[i].number;
+            }
+
+            if (in_acc) {
+                values[stored] = acc.number;
+            }
+
+            acc.number = sum_values(values, instruction->operand,
+                                    instruction->code == ACC_SUM_N ? SUM_PAIRWISE
+                                                                   : SUM_COMPENSATED);
+        } break;
+
+        case ACC_INT_NEGATE: {
+            if (__builtin_sub_overflow((int64_t)0, acc.integer, &acc.integer)) {
+                (void)fprintf(stderr, "Integer overflow\n");
+                exit(EXIT_FAILURE);
+            }
+        } break;
+        case ACC_INT_ADD:
+        case ACC_INT_SUBTRACT:
+        case ACC_INT_REVERSE_SUBTRACT:
+        case ACC_INT_MULTIPLY: {
+            int64_t operand = acc_operand(chunk, temps, instruction).integer;
+            bool overflow = false;
+
+            switch (instruction->code) {
+            case ACC_INT_ADD: {
+                overflow = __builtin_add_overflow(acc.integer, operand, &acc.integer);
+            } break;
+            case ACC_INT_SUBTRACT: {
+                overflow = __builtin_sub_overflow(acc.integer, operand, &acc.integer);
+            } break;
+            case ACC_INT_REVERSE_SUBTRACT: {
+                overflow = __builtin_sub_overflow(operand, acc.integer, &acc.integer);
+            } break;
+            default: {
+                overflow = __builtin_mul_overflow(acc.integer, operand, &acc.integer);
+            } break;
+            }
+
+            if (overflow) {
+                (void)fprintf(stderr, "Integer overflow\n");
+                exit(EXIT_FAILURE);
+            }
+        } break;
+        case ACC_INT_MODULO:
+        case ACC_INT_REVERSE_MODULO: {
+            int64_t operand = acc_operand(chunk, temps, instruction).integer;
+            bool reverse = instruction->code == ACC_INT_REVERSE_MODULO;
+            int64_t lhs = reverse ? operand : acc.integer;
+            int64_t rhs = reverse ? acc.integer : operand;
+
+            if (rhs == 0) {
+                (void)fprintf(stderr, "Division by zero\n");
+                exit(EXIT_FAILURE);
+            }
+
+            // INT64_MIN % -1 traps on x86 even though the result is representable.
+            acc.integer = rhs == -1 ? 0 : lhs % rhs;
+        } break;
+        case ACC_INT_POWER:
+        case ACC_INT_REVERSE_POWER: {
+            int64_t operand = acc_operand(chunk, temps, instruction).integer;
+            bool reverse = instruction->code == ACC_INT_REVERSE_POWER;
+
+            if (!int_power(reverse ? operand : acc.integer, reverse ? acc.integer : operand,
+                           &acc.integer)) {
+                (void)fprintf(stderr, "Integer overflow\n");
+                exit(EXIT_FAILURE);
+            }
+        } break;
+
+        case ACC_HALT:
+            return acc;
+        }
+    }
+}
+
+char *get_opcode_string(enum opcode code)
+{
+    switch (code) {
+    case OP_CONSTANT:
+        return "CONSTANT";
+    case OP_ADD:
+        return "ADD";
+    case OP_SUBTRACT:
+        return "SUBTRACT";
+    case OP_MULTIPLY:
+        return "MULTIPLY";
+    case OP_DIVIDE:
+        return "DIVIDE";
+    case OP_MODULO:
+        return "MODULO";
+    case OP_POWER:
+        return "POWER";
+    case OP_NEGATE:
+        return "NEGATE";
+    case OP_PLUS:
+        return "PLUS";
+    case OP_SUM_N:
+        return "SUM_N";
+    case OP_COMPENSATED_SUM_N:
+        return "COMPENSATED_SUM_N";
+    case OP_INT_CONSTANT:
+        return "INT_CONSTANT";
+    case OP_INT_ADD:
+        return "INT_ADD";
+    case OP_INT_SUBTRACT:
+        return "INT_SUBTRACT";
+    case OP_INT_MULTIPLY:
+        return "INT_MULTIPLY";
+    case OP_INT_MODULO:
+        return "INT_MODULO";
+    case OP_INT_POWER:
+        return "INT_POWER";
+    case OP_INT_NEGATE:
+        return "INT_NEGATE";
+    case OP_INT_TO_DOUBLE:
+        return "INT_TO_DOUBLE";
+    case OP_POW_INT:
+        return "POW_INT";
+    case OP_FMA:
+        return "FMA";
+    case OP_FMS:
+        return "FMS";
+    case OP_SQRT:
+        return "SQRT";
+    case OP_HORNER:
+        return "HORNER";
+    case OP_HORNER_FMA:
+        return "HORNER_FMA";
+    case OP_ESTRIN:
+        return "ESTRIN";
+    case OP_HALT:
+        return "HALT";
+    case OP_COUNT:
+        break;
+    }
+
+    return "UNKNOWN";
+}
+
+int get_stack_effect(const struct bytecode *instruction)
+{
+    switch (instruction->code) {
+    case OP_CONSTANT:
+    case OP_INT_CONSTANT:
+        return 1;
+    case OP_ADD:
+    case OP_SUBTRACT:
+    case OP_MULTIPLY:
+    case OP_DIVIDE:
+    case OP_MODULO:
+    case OP_POWER:
+    case OP_INT_ADD:
+    case OP_INT_SUBTRACT:
+    case OP_INT_MULTIPLY:
+    case OP_INT_MODULO:
+    case OP_INT_POWER:
+    case OP_HALT:
+        return -1;
+    case OP_FMA:
+    case OP_FMS:
+        return -2;
+    case OP_SUM_N:
+    case OP_COMPENSATED_SUM_N:
+        return 1 - (int)instruction->operand;
+    case OP_NEGATE:
+    case OP_PLUS:
+    case OP_INT_NEGATE:
+    case OP_INT_TO_DOUBLE:
+    case OP_POW_INT:
+    case OP_SQRT:
+    case OP_HORNER:
+    case OP_HORNER_FMA:
+    case OP_ESTRIN:
+    case OP_COUNT:
+        break;
+    }
+
+    return 0;
+}
+
+size_t get_instruction_cost(const struct bytecode *instruction)
+{
+    // Rough cycles on a current x86 core, dispatch excluded. Only meant to rank instructions,
+    // e.g. a single pow() outweighs dozens of adds.
+    size_t operand = instruction->operand;
+
+    switch (instruction->code) {
+    case OP_CONSTANT:
+    case OP_INT_CONSTANT:
+    case OP_NEGATE:
+    case OP_PLUS:
+    case OP_INT_NEGATE:
+    case OP_INT_TO_DOUBLE:
+        return 1;
+    case OP_ADD:
+    case OP_SUBTRACT:
+    case OP_INT_ADD:
+    case OP_INT_SUBTRACT:
+    case OP_INT_MULTIPLY:
+        return 2;
+    case OP_MULTIPLY:
+    case OP_FMA:
+    case OP_FMS:
+        return 4;
+    case OP_DIVIDE:
+    case OP_SQRT:
+        return 14;
+    case OP_INT_MODULO:
+        return 25;
+    case OP_MODULO:
+        return 40;
+    case OP_POWER:
+        return 80;
+    case OP_INT_POWER:
+        return 30;
+    case OP_POW_INT: {
+        // Same square-and-multiply walk as pow_int, plus a divide for negative exponents.
+        int64_t exponent = (int64_t)operand;
+        uint64_t magnitude = exponent < 0 ? -(uint64_t)exponent : (uint64_t)exponent;
+        size_t multiplies = 0;
+
+        for (; magnitude > 1; magnitude >>= 1) {
+            multiplies += 1 + (magnitude & 1);
+        }
+
+        multiplies += magnitude;
+
+        return 4 * multiplies + (exponent < 0 ? 14 : 0);
+    }
+    case OP_SUM_N:
+        return 2 * operand;
+    case OP_COMPENSATED_SUM_N:
+        return 8 * operand;
+    case OP_HORNER:
+    case OP_HORNER_FMA:
+        return 4 * operand;
+    case OP_ESTRIN:
+        return 3 * operand;
+    case OP_HALT:
+    case OP_COUNT:
+        break;
+    }
+
+    return 0;
+}
+
+void disassemble_chunk(const struct chunk *chunks)
+{
+    size_t total_cost = 0;
+    size_t peak_depth = 0;
+    int64_t depth = 0;
+
+    printf("%-6s %-20s %-28s %5s %6s\n", "Offset", "Opcode", "Operand", "Depth", "Cost");
+
+    for (size_t ip = 0; ip < chunks->code_size; ip++) {
+        const struct bytecode *instruction = &chunks->code[ip];
+        char operand[64] = "";
+
+        switch (instruction->code) {
+        case OP_CONSTANT: {
+            (void)snprintf(operand, sizeof(operand), "#%zu %.17g", instruction->const_index,
+                           chunks->constants[instruction->const_index]);
+        } break;
+        case OP_INT_CONSTANT: {
+            (void)snprintf(operand, sizeof(operand), "%" PRId64, (int64_t)instruction->operand);
+        } break;
+        case OP_POW_INT: {
+            (void)snprintf(operand, sizeof(operand), "^%" PRId64, (int64_t)instruction->operand);
+        } break;
+        case OP_SUM_N:
+        case OP_COMPENSATED_SUM_N: {
+            (void)snprintf(operand, sizeof(operand), "%zu terms", instruction->operand);
+        } break;
+        case OP_HORNER:
+        case OP_HORNER_FMA:
+        case OP_ESTRIN: {
+            (void)snprintf(operand, sizeof(operand), "degree %zu, #%zu..#%zu",
+                           instruction->operand, instruction->const_index,
+                           instruction->const_index + instruction->operand);
+        } break;
+        default:
+            break;
+        }
+
+        size_t cost = get_instruction_cost(instruction);
+        depth += get_stack_effect(instruction);
+        total_cost += cost;
+
+        if (depth > 0 && (size_t)depth > peak_depth) {
+            peak_depth = (size_t)depth;
+        }
+
+        printf("%06zu %-20s %-28s %5" PRId64 " %6zu\n", ip,
+               get_opcode_string(instruction->code), operand, depth, cost);
+    }
+
+    printf("Instructions: %zu, constants: %zu, total cost: %zu, peak stack depth: %zu\n",
+           chunks->code_size, chunks->const_size, total_cost, peak_depth);
+
+    if (peak_depth > MAX_STACK_SIZE) {
+        printf("Peak stack depth exceeds the VM stack of %d slots\n", MAX_STACK_SIZE);
+    }
+}
+
+char *get_acc_opcode_string(enum acc_opcode code)
+{
+    switch (code) {
+    case ACC_LOAD:
+        return "LOAD";
+    case ACC_INT_LOAD:
+        return "INT_LOAD";
+    case ACC_STORE:
+        return "STORE";
+    case ACC_COPY:
+        return "COPY";
+    case ACC_ADD:
+        return "ADD";
+    case ACC_SUBTRACT:
+        return "SUBTRACT";
+    case ACC_REVERSE_SUBTRACT:
+        return "REVERSE_SUBTRACT";
+    case ACC_MULTIPLY:
+        return "MULTIPLY";
+    case ACC_DIVIDE:
+        return "DIVIDE";
+    case ACC_REVERSE_DIVIDE:
+        return "REVERSE_DIVIDE";
+    case ACC_MODULO:
+        return "MODULO";
+    case ACC_REVERSE_MODULO:
+        return "REVERSE_MODULO";
+    case ACC_POWER:
+        return "POWER";
+    case ACC_REVERSE_POWER:
+        return "REVERSE_POWER";
+    case ACC_NEGATE:
+        return "NEGATE";
+    case ACC_SQRT:
+        return "SQRT";
+    case ACC_POW_INT:
+        return "POW_INT";
+    case ACC_INT_TO_DOUBLE:
+        return "INT_TO_DOUBLE";
+    case ACC_FMA:
+        return "FMA";
+    case ACC_FMS:
+        return "FMS";
+    case ACC_HORNER:
+        return "HORNER";
+    case ACC_HORNER_FMA:
+        return "HORNER_FMA";
+    case ACC_ESTRIN:
+        return "ESTRIN";
+    case ACC_SUM_N:
+        return "SUM_N";
+    case ACC_COMPENSATED_SUM_N:
+        return "COMPENSATED_SUM_N";
+    case ACC_INT_NEGATE:
+        return "INT_NEGATE";
+    case ACC_INT_ADD:
+        return "INT_ADD";
+    case ACC_INT_SUBTRACT:
+        return "INT_SUBTRACT";
+    case ACC_INT_REVERSE_SUBTRACT:
+        return "INT_REVERSE_SUBTRACT";
+    case ACC_INT_MULTIPLY:
+        return "INT_MULTIPLY";
+    case ACC_INT_MODULO:
+        return "INT_MODULO";
+    case ACC_INT_REVERSE_MODULO:
+        return "INT_REVERSE_MODULO";
+    case ACC_INT_POWER:
+        return "INT_POWER";
+    case ACC_INT_REVERSE_POWER:
+        return "INT_REVERSE_POWER";
+    case ACC_HALT:
+        return "HALT";
+    }
+
+    return "UNKNOWN";
+}
+
+void disassemble_acc_chunk(const struct acc_chunk *chunk)
+{
+    size_t stores = 0;
+
+    printf("%-6s %-20s %s\n", "Offset", "Opcode", "Operand");
+
+    for (size_t ip = 0; ip < chunk->code_size; ip++) {
+        const struct acc_instruction *instruction = &chunk->code[ip];
+        char operand[64] = "";
+
+        switch (instruction->code) {
+        case ACC_POW_INT: {
+            (void)snprintf(operand, sizeof(operand), "^%" PRId64, (int64_t)instruction->operand);
+        } break;
+        case ACC_COPY: {
+            (void)snprintf(operand, sizeof(operand), "K[%zu] %.17g -> TMP[%zu]",
+                           instruction->index, chunk->constants[instruction->index].number,
+                           instruction->operand);
+        } break;
+        case ACC_FMA:
+        case ACC_FMS: {
+            (void)snprintf(operand, sizeof(operand), "TMP[%zu] * TMP[%zu]", instruction->index,
+                           instruction->index + 1);
+        } break;
+        case ACC_SUM_N:
+        case ACC_COMPENSATED_SUM_N: {
+            if (instruction->mode == ACC_CONSTANT) {
+                (void)snprintf(operand, sizeof(operand), "K[%zu..%zu]", instruction->index,
+                               instruction->index + instruction->operand - 1);
+            } else {
+                (void)snprintf(operand, sizeof(operand), "TMP[%zu..%zu], ACC", instruction->index,
+                               instruction->index + instruction->operand - 2);
+            }
+        } break;
+        case ACC_HORNER:
+        case ACC_HORNER_FMA:
+        case ACC_ESTRIN: {
+            (void)snprintf(operand, sizeof(operand), "degree %zu, C[%zu..%zu]",
+                           instruction->operand, instruction->index,
+                           instruction->index + instruction->operand);
+        } break;
+        default: {
+            bool integer = instruction->code == ACC_INT_LOAD ||
+                           (instruction->code >= ACC_INT_ADD && instruction->code < ACC_HALT);
+
+            if (instruction->mode == ACC_CONSTANT && integer) {
+                (void)snprintf(operand, sizeof(operand), "K[%zu] %" PRId64, instruction->index,
+                               chunk->constants[instruction->index].integer);
+            } else if (instruction->mode == ACC_CONSTANT) {
+                (void)snprintf(operand, sizeof(operand), "K[%zu] %.17g", instruction->index,
+                               chunk->constants[instruction->index].number);
+            } else if (instruction->mode == ACC_TEMP) {
+                (void)snprintf(operand, sizeof(operand), "TMP[%zu]", instruction->index);
+            }
+        } break;
+        }
+
+        stores += instruction->code == ACC_STORE || instruction->code == ACC_COPY;
+        printf("%06zu %-20s %s\n", ip, get_acc_opcode_string(instruction->code), operand);
+    }
+
+    printf("Instructions: %zu, constants: %zu, temporaries: %zu, stores: %zu\n",
+           chunk->code_size, chunk->constant_size, chunk->temps, stores);
+}
+
+size_t emit_c_temp(struct c_emitter *emitter, bool integer, const char *format, ...)
+{
+    size_t temp = emitter->temps++;
+    va_list arguments;
+
+    (void)fprintf(emitter->stream, "    const %s t%zu = ", integer ? "int64_t" : "double", temp);
+    va_start(arguments, format);
+    (void)vfprintf(emitter->stream, format, arguments);
+    va_end(arguments);
+    (void)fprintf(emitter->stream, ";\n");
+
+    return temp;
+}
+
+size_t emit_c_constant(struct c_emitter *emitter, double value)
+{
+    if (isnan(value)) {
+        return emit_c_temp(emitter, false, "NAN");
+    }
+
+    if (isinf(value)) {
+        return emit_c_temp(emitter, false, value < 0 ? "-INFINITY" : "INFINITY");
+    }
+
+    // Hex floats round-trip exactly.
+    return emit_c_temp(emitter, false, "%a", value);
+}
+
+size_t emit_c_checked(struct c_emitter *emitter, const char *check, size_t lhs, size_t rhs)
+{
+    size_t temp = emitter->temps++;
+
+    (void)fprintf(emitter->stream,
+                  "    int64_t t%zu;\n"
+                  "    if (%s(t%zu, t%zu, &t%zu)) {\n"
+                  "        arith_fail(\"Integer overflow\");\n"
+                  "    }\n",
+                  temp, check, lhs, rhs, temp);
+
+    return temp;
+}
+
+void emit_c_zero_check(struct c_emitter *emitter, size_t temp, bool integer)
+{
+    (void)fprintf(emitter->stream,
+                  "    if (t%zu == %s) {\n"
+                  "        arith_fail(\"Division by zero\");\n"
+                  "    }\n",
+                  temp, integer ? "0" : "0.0");
+}
+
+size_t emit_c_pow_int(struct c_emitter *emitter, size_t base, int64_t exponent)
+{
+    // The same square-and-multiply steps as pow_int, unrolled for the known exponent, with the
+    // same pow() fallback outside the normal range.
+    uint64_t remaining = exponent < 0 ? -(uint64_t)exponent : (uint64_t)exponent;
+    size_t original = base;
+    size_t accumulator = emit_c_constant(emitter, 1.0);
+
+    while (remaining > 0) {
+        if (remaining & 1) {
+            accumulator = emit_c_temp(emitter, false, "t%zu * t%zu", accumulator, base);
+        }
+
+        remaining >>= 1;
+
+        if (remaining > 0) {
+            base = emit_c_temp(emitter, false, "t%zu * t%zu", base, base);
+        }
+    }
+
+    size_t result =
+        exponent < 0 ? emit_c_temp(emitter, false, "1.0 / t%zu", accumulator) : accumulator;
+
+    return emit_c_temp(emitter, false,
+                       "isnormal(t%zu) && isnormal(t%zu) ? t%zu : pow(t%zu, %" PRId64 ".0)",
+                       accumulator, result, result, original, exponent);
+}
+
+size_t emit_c_poly(struct c_emitter *emitter, enum opcode code, const double *coefficients,
+                   size_t degree, size_t x)
+{
+    if (code == OP_ESTRIN) {
+        // Mirrors poly_estrin level by level.
+        size_t values[POW_INT_MAX_EXPONENT + 1];
+        size_t count = degree + 1;
+
+        for (size_t i = 0; i < count; i++) {
+            values[i] = emit_c_constant(emitter, coefficients[i]);
+        }
+
+        while (count > 1) {
+            size_t pairs = count / 2;
+
+            for (size_t i = 0; i < pairs; i++) {
+                values[i] = emit_c_temp(emitter, false, "t%zu + t%zu * t%zu", values[2 * i],
+                                        values[2 * i + 1], x);
+            }
+
+            if (count % 2 != 0) {
+                values[pairs] = values[count - 1];
+            }
+
+            count = pairs + count % 2;
+
+            if (count > 1) {
+                x = emit_c_temp(emitter, false, "t%zu * t%zu", x, x);
+            }
+        }
+
+        return values[0];
+    }
+
+    size_t accumulator = emit_c_constant(emitter, coefficients[degree]);
+
+    for (size_t i = degree; i-- > 0;) {
+        size_t coefficient = emit_c_constant(emitter, coefficients[i]);
+
+        accumulator = code == OP_HORNER_FMA
+                          ? emit_c_temp(emitter, false, "fma(t%zu, t%zu, t%zu)", accumulator, x,
+                                        coefficient)
+                          : emit_c_temp(emitter, false, "t%zu * t%zu + t%zu", accumulator, x,
+                                        coefficient);
+    }
+
+    return accumulator;
+}
+
+size_t emit_c_sum_pairwise(struct c_emitter *emitter, const size_t *values, size_t count)
+{
+    // Same blocks, lanes and combining order as sum_pairwise.
+    if (count > SUM_BLOCK_SIZE) {
+        size_t half = count / 2;
+        size_t lhs = emit_c_sum_pairwise(emitter, values, half);
+        size_t rhs = emit_c_sum_pairwise(emitter, values + half, count - half);
+
+        return emit_c_temp(emitter, false, "t%zu + t%zu", lhs, rhs);
+    }
+
+    size_t lanes[SUM_LANES];
+    size_t i = 0;
+
+    for (size_t lane = 0; lane < SUM_LANES; lane++) {
+        lanes[lane] = emit_c_constant(emitter, 0.0);
+    }
+
+    for (; i + SUM_LANES <= count; i += SUM_LANES) {
+        for (size_t lane = 0; lane < SUM_LANES; lane++) {
+            lanes[lane] = emit_c_temp(emitter, false, "t%zu + t%zu", lanes[lane], values[i + lane]);
+        }
+    }
+
+    for (size_t lane = 0; i < count; i++, lane++) {
+        lanes[lane] = emit_c_temp(emitter, false, "t%zu + t%zu", lanes[lane], values[i]);
+    }
+
+    return emit_c_temp(emitter, false, "(t%zu + t%zu) + (t%zu + t%zu)", lanes[0], lanes[1],
+                       lanes[2], lanes[3]);
+}
+
+void emit_c_neumaier(struct c_emitter *emitter, size_t *sum, size_t *compensation, size_t value)
+{
+    size_t total = emit_c_temp(emitter, false, "t%zu + t%zu", *sum, value);
+
+    *compensation = emit_c_temp(
+        emitter, false, "t%zu + (fabs(t%zu) >= fabs(t%zu) ? (t%zu - t%zu) + t%zu : (t%zu - t%zu) + t%zu)",
+        *compensation, *sum, value, *sum, total, value, value, total, *sum);
+    *sum = total;
+}
+
+size_t emit_c_sum_compensated(struct c_emitter *emitter, const size_t *values, size_t count)
+{
+    // Same lanes and combining order as sum_compensated.
+    size_t sums[SUM_LANES];
+    size_t compensations[SUM_LANES];
+    size_t i = 0;
+
+    for (size_t lane = 0; lane < SUM_LANES; lane++) {
+        sums[lane] = emit_c_constant(emitter, 0.0);
+        compensations[lane] = emit_c_constant(emitter, 0.0);
+    }
+
+    for (; i + SUM_LANES <= count; i += SUM_LANES) {
+        for (size_t lane = 0; lane < SUM_LANES; lane++) {
+            emit_c_neumaier(emitter, &sums[lane], &compensations[lane], values[i + lane]);
+        }
+    }
+
+    for (size_t lane = 0; i < count; i++, lane++) {
+        emit_c_neumaier(emitter, &sums[lane], &compensations[lane], values[i]);
+    }
+
+    size_t sum = emit_c_constant(emitter, 0.0);
+    size_t compensation = emit_c_constant(emitter, 0.0);
+
+    for (size_t lane = 0; lane < SUM_LANES; lane++) {
+        emit_c_neumaier(emitter, &sum, &compensation, sums[lane]);
+        compensation =
+            emit_c_temp(emitter, false, "t%zu + t%zu", compensation, compensations[lane]);
+    }
+
+    return emit_c_temp(emitter, false, "t%zu + t%zu", sum, compensation);
+}
+
+void emit_c_source(const struct chunk *chunks, FILE *stream)
+{
+    // The failure paths print the same messages as run_vm and exit the same way.
+    static const char *prelude =
+        "#include <math.h>\n"
+        "#include <stdbool.h>\n"
+        "#include <stdint.h>\n"
+        "#include <stdio.h>\n"
+        "#include <stdlib.h>\n"
+        "\n"
+        "static inline void arith_fail(const char *message)\n"
+        "{\n"
+        "    (void)fprintf(stderr, \"%s\\n\", message);\n"
+        "    exit(EXIT_FAILURE);\n"
+        "}\n"
+        "\n"
+        "static inline bool arith_int_power_overflow(int64_t base, int64_t exponent, int64_t *result)\n"
+        "{\n"
+        "    int64_t accumulator = 1;\n"
+        "\n"
+        "    if (exponent < 0) {\n"
+        "        return true;\n"
+        "    }\n"
+        "\n"
+        "    while (exponent > 0) {\n"
+        "        if ((exponent & 1) && __builtin_mul_overflow(accumulator, base, &accumulator)) {\n"
+        "            return true;\n"
+        "        }\n"
+        "\n"
+        "        exponent >>= 1;\n"
+        "\n"
+        "        if (exponent > 0 && __builtin_mul_overflow(base, base, &base)) {\n"
+        "            return true;\n"
+        "        }\n"
+        "    }\n"
+        "\n"
+        "    *result = accumulator;\n"
+        "\n"
+        "    return false;\n"
+        "}\n"
+        "\n"
+        "// vars is reserved for when expressions can reference variables, nothing reads it yet.\n"
+        "double f(const double *vars)\n"
+        "{\n"
+        "    (void)vars;\n";
+
+    struct c_emitter emitter = { .stream = stream, .temps = 0 };
+    struct c_slot stack[MAX_STACK_SIZE];
+    size_t top = 0;
+
+    (void)fputs(prelude, stream);
+
+    for (size_t ip = 0; ip < chunks->code_size; ip++) {
+        const struct bytecode *instruction = &chunks->code[ip];
+        int stack_effect = get_stack_effect(instruction);
+        size_t inputs = instruction->code == OP_HALT ? 1 : (size_t)(1 - stack_effect);
+
+        if (top < inputs) {
+            (void)fprintf(stderr, "Stack undeflow\n");
+            exit(EXIT_FAILURE);
+        }
+
+        if (top - inputs + 1 > MAX_STACK_SIZE) {
+            (void)fprintf(stderr, "Stack overflow\n");
+            exit(EXIT_FAILURE);
+        }
+
+        top -= inputs;
+
+        const struct c_slot *operands = &stack[top];
+        size_t lhs = inputs > 0 ? operands[0].temp : 0;
+        size_t rhs = inputs > 1 ? operands[1].temp : 0;
+        struct c_slot result = { .temp = 0, .integer = false };
+
+        switch (instruction->code) {
+        case OP_CONSTANT: {
+            result.temp = emit_c_constant(&emitter, chunks->constants[instruction->const_index]);
+        } break;
+
+        case OP_NEGATE: {
+            result.temp = emit_c_temp(&emitter, false, "-t%zu", lhs);
+        } break;
+
+        case OP_ADD: {
+            result.temp = emit_c_temp(&emitter, false, "t%zu + t%zu", lhs, rhs);
+        } break;
+        case OP_SUBTRACT: {
+            result.temp = emit_c_temp(&emitter, false, "t%zu - t%zu", lhs, rhs);
+        } break;
+        case OP_MULTIPLY: {
+            result.temp = emit_c_temp(&emitter, false, "t%zu * t%zu", lhs, rhs);
+        } break;
+        case OP_DIVIDE: {
+            emit_c_zero_check(&emitter, rhs, false);
+            result.temp = emit_c_temp(&emitter, false, "t%zu / t%zu", lhs, rhs);
+        } break;
+        case OP_MODULO: {
+            emit_c_zero_check(&emitter, rhs, false);
+            result.temp = emit_c_temp(&emitter, false, "fmod(t%zu, t%zu)", lhs, rhs);
+        } break;
+        case OP_POWER: {
+            result.temp = emit_c_temp(&emitter, false, "pow(t%zu, t%zu)", lhs, rhs);
+        } break;
+
+        case OP_POW_INT: {
+            result.temp = emit_c_pow_int(&emitter, lhs, (int64_t)instruction->operand);
+        } break;
+
+        case OP_FMA:
+        case OP_FMS: {
+            result.temp = emit_c_temp(&emitter, false, "fma(t%zu, t%zu, %st%zu)", lhs, rhs,
+                                      instruction->code == OP_FMA ? "" : "-", operands[2].temp);
+        } break;
+
+        case OP_SQRT: {
+            result.temp = emit_c_temp(&emitter, false, "sqrt(t%zu)", lhs);
+        } break;
+
+        case OP_HORNER:
+        case OP_HORNER_FMA:
+        case OP_ESTRIN: {
+            result.temp = emit_c_poly(&emitter, instruction->code,
+                                      &chunks->constants[instruction->const_index],
+                                      instruction->operand, lhs);
+        } break;
+
+        case OP_SUM_N:
+        case OP_COMPENSATED_SUM_N: {
+            size_t values[SUM_BLOCK_SIZE];
+
+            for (size_t i = 0; i < inputs; i++) {
+                values[i] = operands[i].temp;
+            }
+
+            result.temp = instruction->code == OP_SUM_N
+                              ? emit_c_sum_pairwise(&emitter, values, inputs)
+                              : emit_c_sum_compensated(&emitter, values, inputs);
+        } break;
+
+        case OP_INT_CONSTANT: {
+            int64_t value = (int64_t)instruction->operand;
+
+            result.integer = true;
+            result.temp = value == INT64_MIN
+                              ? emit_c_temp(&emitter, true, "INT64_MIN")
+                              : emit_c_temp(&emitter, true, "INT64_C(%" PRId64 ")", value);
+        } break;
+
+        case OP_INT_NEGATE: {
+            size_t zero = emit_c_temp(&emitter, true, "0");
+
+            result.integer = true;
+            result.temp = emit_c_checked(&emitter, "__builtin_sub_overflow", zero, lhs);
+        } break;
+
+        case OP_INT_ADD: {
+            result.integer = true;
+            result.temp = emit_c_checked(&emitter, "__builtin_add_overflow", lhs, rhs);
+        } break;
+        case OP_INT_SUBTRACT: {
+            result.integer = true;
+            result.temp = emit_c_checked(&emitter, "__builtin_sub_overflow", lhs, rhs);
+        } break;
+        case OP_INT_MULTIPLY: {
+            result.integer = true;
+            result.temp = emit_c_checked(&emitter, "__builtin_mul_overflow", lhs, rhs);
+        } break;
+        case OP_INT_MODULO: {
+            emit_c_zero_check(&emitter, rhs, true);
+            result.integer = true;
+            result.temp =
+                emit_c_temp(&emitter, true, "t%zu == -1 ? 0 : t%zu %% t%zu", rhs, lhs, rhs);
+        } break;
+        case OP_INT_POWER: {
+            result.integer = true;
+            result.temp = emit_c_checked(&emitter, "arith_int_power_overflow", lhs, rhs);
+        } break;
+
+        case OP_INT_TO_DOUBLE: {
+            result.temp = emit_c_temp(&emitter, false, "(double)t%zu", lhs);
+        } break;
+
+        case OP_HALT: {
+            // Integer results are widened, the signature returns a double either way.
+            (void)fprintf(stream, "\n    return %st%zu;\n}\n", operands[0].integer ? "(double)" : "",
+                          lhs);
+            return;
+        }
+
+        default: {
+            (void)fprintf(stderr, "Unknown instruction code");
+            exit(EXIT_FAILURE);
+        }
+        }
+
+        stack[top++] = result;
+    }
+
+    (void)fprintf(stderr, "Missing halt instruction\n");
+    exit(EXIT_FAILURE);
+}
+
+void write_c_source(const struct chunk *chunks, const char *path)
+{
+    FILE *file = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+
+    if (!file) {
+        (void)fprintf(stderr, "Could not write '%s': %s\n", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    emit_c_source(chunks, file);
+
+    if (file != stdout && fclose(file) != 0) {
+        (void)fprintf(stderr, "Could not write '%s': %s\n", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+}
+
+uint64_t hash_text(uint64_t hash, const char *text)
+{
+    // FNV-1a, only used to name cache entries. Chaining calls hashes the texts one after another,
+    // the terminating zero is mixed in so "ab" + "c" and "a" + "bc" differ.
+    for (const unsigned char *byte = (const unsigned char *)text; *byte; byte++) {
+        hash = (hash ^ *byte) * FNV_PRIME;
+    }
+
+    return hash * FNV_PRIME;
+}
+
+void format_path(char *path, const char *format, ...)
+{
+    // A truncated path could name a different file, and these end up in dlopen.
+    va_list arguments;
+
+    va_start(arguments, format);
+    int length = vsnprintf(path, PATH_MAX, format, arguments);
+    va_end(arguments);
+
+    if (length < 0 || length >= PATH_MAX) {
+        (void)fprintf(stderr, "Path too long: %.64s...\n", path);
+        exit(EXIT_FAILURE);
+    }
+}
+
+void aot_compile(const char *source, const char *source_path, const char *object_path)
+{
+    FILE *file = fopen(source_path, "w");
+
+    if (!file || fputs(source, file) == EOF || fclose(file) != 0) {
+        (void)fprintf(stderr, "Could not write '%s': %s\n", source_path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    // Compile to a private name and rename it into place, so a concurrent run never dlopens a
+    // half written object.
+    char temporary_path[PATH_MAX];
+    format_path(temporary_path, "%s.%ld", object_path, (long)getpid());
+
+    const char *compiler = getenv("CC") ? getenv("CC") : "cc";
+    char *arguments[] = { (char *)compiler, AOT_FLAGS,           "-o",
+                          temporary_path,   (char *)source_path, "-lm",
+                          NULL };
+    pid_t pid = 0;
+    int status = 0;
+    int error = posix_spawnp(&pid, compiler, NULL, NULL, arguments, environ);
+
+    if (error != 0) {
+        (void)fprintf(stderr, "Could not run '%s': %s\n", compiler, strerror(error));
+        exit(EXIT_FAILURE);
+    }
+
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        (void)fprintf(stderr, "Compiling '%s' with '%s' failed\n", source_path, compiler);
+        exit(EXIT_FAILURE);
+    }
+
+    // A umask such as 002 would leave the object group-writable, which check_aot_owner refuses.
+    if (chmod(temporary_path, 0700) != 0 || rename(temporary_path, object_path) != 0) {
+        (void)fprintf(stderr, "Could not write '%s': %s\n", object_path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+}
+
+void check_aot_owner(const char *path, bool directory)
+{
+    // lstat, so a symlink to someone else's file is refused as well.
+    struct stat info;
+
+    if (lstat(path, &info) != 0) {
+        (void)fprintf(stderr, "Could not stat '%s': %s\n", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    if ((directory ? !S_ISDIR(info.st_mode) : !S_ISREG(info.st_mode)) ||
+        info.st_uid != geteuid() || (info.st_mode & (S_IWGRP | S_IWOTH))) {
+        (void)fprintf(stderr,
+                      "Refusing to use '%s': it must be a %s owned by the current user and not "
+                      "writable by group or others\n",
+                      path, directory ? "directory" : "file");
+        exit(EXIT_FAILURE);
+    }
+}
+
+double execute_aot(const struct chunk *chunks)
+{
+    char *source = NULL;
+    size_t size = 0;
+    FILE *stream = open_memstream(&source, &size);
+
+    if (!stream) {
+        (void)fprintf(stderr, "Go download more ram\n");
+        exit(EXIT_FAILURE);
+    }
+
+    emit_c_source(chunks, stream);
+    (void)fclose(stream);
+
+    // Objects are cached under $XDG_CACHE_HOME (or ~/.cache) by a hash of the generated source,
+    // so an unchanged formula is only compiled once. The hash is predictable, so the cache has to
+    // be private: there is no shared fallback, and anything another user could have written is
+    // refused before it gets near dlopen.
+    char cache[PATH_MAX];
+    char directory[PATH_MAX];
+    const char *cache_home = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+
+    if (cache_home && *cache_home) {
+        format_path(cache, "%s", cache_home);
+    } else if (home && *home) {
+        format_path(cache, "%s/.cache", home);
+    } else {
+        (void)fprintf(stderr, "--aot needs XDG_CACHE_HOME or HOME for its cache\n");
+        exit(EXIT_FAILURE);
+    }
+
+    (void)mkdir(cache, 0700);
+    format_path(directory, "%s/arithmetic-compiler", cache);
+
+    if (mkdir(directory, 0700) != 0 && errno != EEXIST) {
+        (void)fprintf(stderr, "Could not create '%s': %s\n", directory, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    check_aot_owner(directory, true);
+
+    char source_path[PATH_MAX];
+    char object_path[PATH_MAX];
+    const char *compiler = getenv("CC") ? getenv("CC") : "cc";
+    const char *flags[] = { AOT_FLAGS, "-lm" };
+    uint64_t hash = hash_text(hash_text(FNV_OFFSET_BASIS, source), compiler);
+
+    // Switching $CC or the flags must not pick up an object built by the old compiler.
+    for (size_t i = 0; i < sizeof(flags) / sizeof(flags[0]); i++) {
+        hash = hash_text(hash, flags[i]);
+    }
+
+    format_path(source_path, "%s/%016" PRIx64 ".c", directory, hash);
+    format_path(object_path, "%s/%016" PRIx64 ".so", directory, hash);
+
+    if (access(object_path, R_OK) != 0) {
+        aot_compile(source, source_path, object_path);
+    }
+
+    free(source);
+    check_aot_owner(object_path, false);
+
+    void *library = dlopen(object_path, RTLD_NOW | RTLD_LOCAL);
+
+    if (!library) {
+        (void)fprintf(stderr, "Could not load '%s': %s\n", object_path, dlerror());
+        exit(EXIT_FAILURE);
+    }
+
+    double (*function)(const double *vars) = NULL;
+    *(void **)&function = dlsym(library, "f");
+
+    if (!function) {
+        (void)fprintf(stderr, "Could not load '%s': %s\n", object_path, dlerror());
+        exit(EXIT_FAILURE);
+    }
+
+    double result = function(NULL);
+    (void)dlclose(library);
+
+    return result;
+}
+
+struct x86_operand x86_register(int reg)
+{
+    return (struct x86_operand){ .kind = X86_REGISTER, .reg = reg };
+}
+
+struct x86_operand x86_xmm(int reg)
+{
+    return (struct x86_operand){ .kind = X86_XMM, .reg = reg };
+}
+
+struct x86_operand x86_stack(size_t slot)
+{
+    return (struct x86_operand){ .kind = X86_STACK, .displacement = (int32_t)(slot * 8) };
+}
+
+struct x86_operand x86_rip(size_t label)
+{
+    return (struct x86_operand){ .kind = X86_RIP, .label = label };
+}
+
+void *grow_array(void *items, size_t *capacity, size_t count, size_t item_size)
+{
+    if (count < *capacity) {
+        return items;
+    }
+
+    *capacity = *capacity > 0 ? *capacity * 2 : 64;
+    void *new_items = realloc(items, *capacity * item_size);
+
+    if (!new_items) {
+        (void)fprintf(stderr, "Go download more ram\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return new_items;
+}
+
+void native_bytes(struct native_code *native, uint64_t value, size_t size)
+{
+    native->code = grow_array(native->code, &native->code_capacity, native->code_size + size, 1);
+
+    for (size_t i = 0; i < size; i++) {
+        native->code[native->code_size++] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+void native_text(struct native_code *native, const char *format, ...)
+{
+    va_list arguments;
+
+    (void)fputs("    ", native->listing);
+    va_start(arguments, format);
+    (void)vfprintf(native->listing, format, arguments);
+    va_end(arguments);
+    (void)fputc('\n', native->listing);
+}
+
+size_t native_new_label(struct native_code *native)
+{
+    native->labels = grow_array(native->labels, &native->label_capacity, native->label_count,
+                                 sizeof(*native->labels));
+    native->labels[native->label_count] = SIZE_MAX;
+
+    return native->label_count++;
+}
+
+void native_bind_label(struct native_code *native, size_t label)
+{
+    native->labels[label] = native->code_size;
+    (void)fprintf(native->listing, ".L%zu:\n", label);
+}
+
+void native_fixup(struct native_code *native, size_t label)
+{
+    // A rel32 field, patched once every label is bound. The end is filled in by the caller when
+    // an immediate follows the displacement.
+    native->fixups = grow_array(native->fixups, &native->fixup_capacity, native->fixup_count,
+                                 sizeof(*native->fixups));
+    native->fixups[native->fixup_count++] = (struct x86_fixup){
+        .offset = native->code_size, .end = native->code_size + 4, .label = label
+    };
+    native_bytes(native, 0, 4);
+}
+
+size_t native_constant(struct native_code *native, uint64_t bits)
+{
+    native->constants = grow_array(native->constants, &native->constant_capacity,
+                                    native->constant_count, sizeof(*native->constants));
+    native->constants[native->constant_count] =
+        (struct native_constant){ .label = native_new_label(native), .bits = bits };
+
+    return native->constants[native->constant_count++].label;
+}
+
+size_t native_double(struct native_code *native, double value)
+{
+    uint64_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+
+    return native_constant(native, bits);
+}
+
+void x86_operand_text(struct x86_operand operand, char *buffer, size_t size)
+{
+    static const char *names[16] = { "%rax", "%rcx", "%rdx", "%rbx", "%rsp", "%rbp",
+                                     "%rsi", "%rdi", "%r8",  "%r9",  "%r10", "%r11",
+                                     "%r12", "%r13", "%r14", "%r15" };
+
+    switch (operand.kind) {
+    case X86_REGISTER: {
+        (void)snprintf(buffer, size, "%s", names[operand.reg]);
+    } break;
+    case X86_XMM: {
+        (void)snprintf(buffer, size, "%%xmm%d", operand.reg);
+    } break;
+    case X86_STACK: {
+        if (operand.displacement == 0) {
+            (void)snprintf(buffer, size, "(%%rsp)");
+        } else {
+            (void)snprintf(buffer, size, "%" PRId32 "(%%rsp)", operand.displacement);
+        }
+    } break;
+    case X86_RIP: {
+        (void)snprintf(buffer, size, ".L%zu(%%rip)", operand.label);
+    } break;
+    }
+}
+
+void x86_encode(struct native_code *native, uint8_t prefix, bool wide, uint32_t opcode,
+                size_t opcode_size, int reg, struct x86_operand rm, size_t immediate_size,
+                int64_t immediate)
+{
+    bool rm_is_register = rm.kind == X86_REGISTER || rm.kind == X86_XMM;
+    uint8_t rex = 0x40 | (wide ? 0x08 : 0) | ((reg & 8) ? 0x04 : 0) |
+                  (rm_is_register && (rm.reg & 8) ? 0x01 : 0);
+    size_t fixup = SIZE_MAX;
+
+    if (prefix) {
+        native_bytes(native, prefix, 1);
+    }
+
+    if (rex != 0x40) {
+        native_bytes(native, rex, 1);
+    }
+
+    for (size_t i = opcode_size; i-- > 0;) {
+        native_bytes(native, (opcode >> (8 * i)) & 0xFF, 1);
+    }
+
+    uint8_t reg_field = (uint8_t)((reg & 7) << 3);
+
+    switch (rm.kind) {
+    case X86_REGISTER:
+    case X86_XMM: {
+        native_bytes(native, 0xC0 | reg_field | (rm.reg & 7), 1);
+    } break;
+    case X86_STACK: {
+        // rsp as a base always needs a SIB byte, 0x24 selects it with no index.
+        if (rm.displacement == 0) {
+            native_bytes(native, 0x04 | reg_field, 1);
+            native_bytes(native, 0x24, 1);
+        } else if (rm.displacement >= INT8_MIN && rm.displacement <= INT8_MAX) {
+            native_bytes(native, 0x44 | reg_field, 1);
+            native_bytes(native, 0x24, 1);
+            native_bytes(native, (uint64_t)rm.displacement, 1);
+        } else {
+            native_bytes(native, 0x84 | reg_field, 1);
+            native_bytes(native, 0x24, 1);
+            native_bytes(native, (uint64_t)rm.displacement, 4);
+        }
+    } break;
+    case X86_RIP: {
+        native_bytes(native, 0x05 | reg_field, 1);
+        fixup = native->fixup_count;
+        native_fixup(native, rm.label);
+    } break;
+    }
+
+    native_bytes(native, (uint64_t)immediate, immediate_size);
+
+    if (fixup != SIZE_MAX) {
+        native->fixups[fixup].end = native->code_size;
+    }
+}
+
+void x86_op(struct native_code *native, const char *mnemonic, uint8_t prefix, bool wide,
+            uint32_t opcode, size_t opcode_size, struct x86_operand reg, struct x86_operand rm,
+            bool reg_is_source)
+{
+    char reg_text[32];
+    char rm_text[32];
+
+    x86_operand_text(reg, reg_text, sizeof(reg_text));
+    x86_operand_text(rm, rm_text, sizeof(rm_text));
+    x86_encode(native, prefix, wide, opcode, opcode_size, reg.reg, rm, 0, 0);
+    native_text(native, "%s %s, %s", mnemonic, reg_is_source ? reg_text : rm_text,
+                reg_is_source ? rm_text : reg_text);
+}
+
+void x86_group(struct native_code *native, const char *mnemonic, uint32_t opcode,
+               size_t opcode_size, int digit, struct x86_operand rm, size_t immediate_size,
+               int64_t immediate)
+{
+    char rm_text[32];
+
+    x86_operand_text(rm, rm_text, sizeof(rm_text));
+    x86_encode(native, 0, true, opcode, opcode_size, digit, rm, immediate_size, immediate);
+
+    if (immediate_size > 0) {
+        native_text(native, "%s $%" PRId64 ", %s", mnemonic, immediate, rm_text);
+    } else {
+        native_text(native, "%s %s", mnemonic, rm_text);
+    }
+}
+
+void x86_sse(struct native_code *native, const char *mnemonic, uint8_t prefix, uint8_t opcode,
+             int destination, struct x86_operand source)
+{
+    x86_op(native, mnemonic, prefix, false, 0x0F00 | opcode, 2, x86_xmm(destination), source,
+           false);
+}
+
+void x86_load(struct native_code *native, int xmm, size_t slot)
+{
+    x86_sse(native, "movsd", 0xF2, 0x10, xmm, x86_stack(slot));
+}
+
+void x86_store(struct native_code *native, int xmm, size_t slot)
+{
+    x86_op(native, "movsd", 0xF2, false, 0x0F11, 2, x86_xmm(xmm), x86_stack(slot), true);
+}
+
+void x86_load_integer(struct native_code *native, int reg, size_t slot)
+{
+    x86_op(native, "movq", 0, true, 0x8B, 1, x86_register(reg), x86_stack(slot), false);
+}
+
+void x86_store_integer(struct native_code *native, int reg, size_t slot)
+{
+    x86_op(native, "movq", 0, true, 0x89, 1, x86_register(reg), x86_stack(slot), true);
+}
+
+void x86_compare_sd(struct native_code *native, int predicate, int destination, int source)
+{
+    x86_encode(native, 0xF2, false, 0x0FC2, 2, destination, x86_xmm(source), 1, predicate);
+    native_text(native, "cmpsd $%d, %%xmm%d, %%xmm%d", predicate, source, destination);
+}
+
+void x86_move_immediate(struct native_code *native, int reg, int64_t value)
+{
+    native_bytes(native, 0x48 | ((reg & 8) ? 0x01 : 0), 1);
+    native_bytes(native, 0xB8 + (reg & 7), 1);
+    native_bytes(native, (uint64_t)value, 8);
+
+    char reg_text[32];
+    x86_operand_text(x86_register(reg), reg_text, sizeof(reg_text));
+    native_text(native, "movabsq $%" PRId64 ", %s", value, reg_text);
+}
+
+void x86_jump(struct native_code *native, const char *mnemonic, uint32_t opcode,
+              size_t opcode_size, size_t label)
+{
+    for (size_t i = opcode_size; i-- > 0;) {
+        native_bytes(native, (opcode >> (8 * i)) & 0xFF, 1);
+    }
+
+    native_fixup(native, label);
+    native_text(native, "%s .L%zu", mnemonic, label);
+}
+
+void x86_call(struct native_code *native, enum native_symbol symbol)
+{
+    static const char *names[NATIVE_SYMBOL_COUNT] = { "pow", "fmod", "fma", "write", "exit" };
+
+    native_bytes(native, 0xE8, 1);
+    native->calls = grow_array(native->calls, &native->call_capacity, native->call_count,
+                                sizeof(*native->calls));
+    native->calls[native->call_count++] =
+        (struct native_call){ .offset = native->code_size, .symbol = symbol };
+    native_bytes(native, 0, 4);
+    native->used[symbol] = true;
+    native_text(native, "call %s@PLT", names[symbol]);
+}
+
+void x86_check_zero(struct native_code *native, size_t slot, bool integer)
+{
+    if (integer) {
+        x86_load_integer(native, X86_RCX, slot);
+        x86_op(native, "testq", 0, true, 0x85, 1, x86_register(X86_RCX), x86_register(X86_RCX),
+               true);
+        x86_jump(native, "je", 0x0F84, 2, native->division_by_zero);
+        return;
+    }
+
+    // ucomisd sets ZF and PF for NaN, which is not zero.
+    size_t not_zero = native_new_label(native);
+
+    x86_load(native, 1, slot);
+    x86_sse(native, "xorpd", 0x66, 0x57, 2, x86_xmm(2));
+    x86_sse(native, "ucomisd", 0x66, 0x2E, 1, x86_xmm(2));
+    x86_jump(native, "jp", 0x0F8A, 2, not_zero);
+    x86_jump(native, "je", 0x0F84, 2, native->division_by_zero);
+    native_bind_label(native, not_zero);
+}
+
+void x86_check_normal(struct native_code *native, int xmm, size_t label)
+{
+    // Jumps to label unless DBL_MIN <= |xmm| <= DBL_MAX. NaN compares unordered, which sets CF.
+    x86_sse(native, "movapd", 0x66, 0x28, 2, x86_xmm(xmm));
+    x86_sse(native, "movsd", 0xF2, 0x10, 3,
+            x86_rip(native_constant(native, UINT64_C(0x7FFFFFFFFFFFFFFF))));
+    x86_sse(native, "andpd", 0x66, 0x54, 2, x86_xmm(3));
+    x86_sse(native, "ucomisd", 0x66, 0x2E, 2, x86_rip(native_double(native, DBL_MIN)));
+    x86_jump(native, "jb", 0x0F82, 2, label);
+    x86_sse(native, "ucomisd", 0x66, 0x2E, 2, x86_rip(native_double(native, DBL_MAX)));
+    x86_jump(native, "ja", 0x0F87, 2, label);
+}
+
+void native_pow_int(struct native_code *native, size_t slot, int64_t exponent)
+{
+    // The same square-and-multiply steps as pow_int, unrolled for the known exponent, with the
+    // same pow() fallback outside the normal range.
+    uint64_t remaining = exponent < 0 ? -(uint64_t)exponent : (uint64_t)exponent;
+    size_t fallback = native_new_label(native);
+    size_t done = native_new_label(native);
+
+    x86_sse(native, "movsd", 0xF2, 0x10, 0, x86_rip(native_double(native, 1.0)));
+    x86_load(native, 1, slot);
+
+    while (remaining > 0) {
+        if (remaining & 1) {
+            x86_sse(native, "mulsd", 0xF2, 0x59, 0, x86_xmm(1));
+        }
+
+        remaining >>= 1;
+
+        if (remaining > 0) {
+            x86_sse(native, "mulsd", 0xF2, 0x59, 1, x86_xmm(1));
+        }
+    }
+
+    x86_check_normal(native, 0, fallback);
+
+    if (exponent < 0) {
+        x86_sse(native, "movsd", 0xF2, 0x10, 1, x86_rip(native_double(native, 1.0)));
+        x86_sse(native, "divsd", 0xF2, 0x5E, 1, x86_xmm(0));
+        x86_check_normal(native, 1, fallback);
+        x86_store(native, 1, slot);
+    } else {
+        x86_store(native, 0, slot);
+    }
+
+    x86_jump(native, "jmp", 0xE9, 1, done);
+    native_bind_label(native, fallback);
+    x86_load(native, 0, slot);
+    x86_sse(native, "movsd", 0xF2, 0x10, 1, x86_rip(native_double(native, (double)exponent)));
+    x86_call(native, NATIVE_POW);
+    x86_store(native, 0, slot);
+    native_bind_label(native, done);
+}
+
+void native_poly(struct native_code *native, enum opcode code, const double *coefficients,
+                 size_t degree, size_t slot, size_t scratch)
+{
+    if (code == OP_ESTRIN) {
+        // Mirrors poly_estrin, the values of each level live in scratch slots.
+        size_t count = degree + 1;
+
+        for (size_t i = 0; i < count; i++) {
+            x86_sse(native, "movsd", 0xF2, 0x10, 0, x86_rip(native_double(native, coefficients[i])));
+            x86_store(native, 0, scratch + i);
+        }
+
+        x86_load(native, 1, slot);
+
+        while (count > 1) {
+            size_t pairs = count / 2;
+
+            for (size_t i = 0; i < pairs; i++) {
+                x86_load(native, 0, scratch + 2 * i + 1);
+                x86_sse(native, "mulsd", 0xF2, 0x59, 0, x86_xmm(1));
+                x86_sse(native, "addsd", 0xF2, 0x58, 0, x86_stack(scratch + 2 * i));
+                x86_store(native, 0, scratch + i);
+            }
+
+            if (count % 2 != 0) {
+                x86_load(native, 0, scratch + count - 1);
+                x86_store(native, 0, scratch + pairs);
+            }
+
+            count = pairs + count % 2;
+
+            if (count > 1) {
+                x86_sse(native, "mulsd", 0xF2, 0x59, 1, x86_xmm(1));
+            }
+        }
+
+        x86_load(native, 0, scratch);
+        x86_store(native, 0, slot);
+        return;
+    }
+
+    x86_sse(native, "movsd", 0xF2, 0x10, 0, x86_rip(native_double(native, coefficients[degree])));
+
+    for (size_t i = degree; i-- > 0;) {
+        size_t coefficient = native_double(native, coefficients[i]);
+
+        if (code == OP_HORNER_FMA) {
+            // Plain SSE2 has no fused multiply-add, libm's fma keeps the single rounding.
+            x86_load(native, 1, slot);
+            x86_sse(native, "movsd", 0xF2, 0x10, 2, x86_rip(coefficient));
+            x86_call(native, NATIVE_FMA);
+        } else {
+            if (i + 1 == degree) {
+                x86_load(native, 1, slot);
+            }
+
+            x86_sse(native, "mulsd", 0xF2, 0x59, 0, x86_xmm(1));
+            x86_sse(native, "addsd", 0xF2, 0x58, 0, x86_rip(coefficient));
+        }
+    }
+
+    x86_store(native, 0, slot);
+}
+
+void native_neumaier(struct native_code *native, int sum, int compensation, int value)
+{
+    // Branch-free version of the step in sum_compensated: both candidates are computed and the
+    // |sum| >= |value| mask picks one, NaN compares false like fabs(a) >= fabs(b).
+    x86_sse(native, "movapd", 0x66, 0x28, 4, x86_xmm(sum));
+    x86_sse(native, "addsd", 0xF2, 0x58, 4, x86_xmm(value));
+    x86_sse(native, "movapd", 0x66, 0x28, 5, x86_xmm(sum));
+    x86_sse(native, "subsd", 0xF2, 0x5C, 5, x86_xmm(4));
+    x86_sse(native, "addsd", 0xF2, 0x58, 5, x86_xmm(value));
+    x86_sse(native, "movapd", 0x66, 0x28, 6, x86_xmm(value));
+    x86_sse(native, "subsd", 0xF2, 0x5C, 6, x86_xmm(4));
+    x86_sse(native, "addsd", 0xF2, 0x58, 6, x86_xmm(sum));
+    x86_sse(native, "movapd", 0x66, 0x28, 1, x86_xmm(sum));
+    x86_sse(native, "andpd", 0x66, 0x54, 1, x86_xmm(7));
+    x86_sse(native, "movapd", 0x66, 0x28, 2, x86_xmm(value));
+    x86_sse(native, "andpd", 0x66, 0x54, 2, x86_xmm(7));
+    x86_compare_sd(native, 2, 2, 1);
+    x86_sse(native, "andpd", 0x66, 0x54, 5, x86_xmm(2));
+    x86_sse(native, "andnpd", 0x66, 0x55, 2, x86_xmm(6));
+    x86_sse(native, "orpd", 0x66, 0x56, 5, x86_xmm(2));
+    x86_sse(native, "addsd", 0xF2, 0x58, compensation, x86_xmm(5));
+    x86_sse(native, "movapd", 0x66, 0x28, sum, x86_xmm(4));
+}
+
+void native_sum(struct native_code *native, enum opcode code, size_t slot, size_t count)
+{
+    if (code == OP_SUM_N) {
+        // At most SUM_BLOCK_SIZE terms, so sum_pairwise is a single block of four lanes.
+        for (int lane = 0; lane < SUM_LANES; lane++) {
+            x86_sse(native, "xorpd", 0x66, 0x57, lane, x86_xmm(lane));
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            x86_sse(native, "addsd", 0xF2, 0x58, (int)(i % SUM_LANES), x86_stack(slot + i));
+        }
+
+        x86_sse(native, "addsd", 0xF2, 0x58, 0, x86_xmm(1));
+        x86_sse(native, "addsd", 0xF2, 0x58, 2, x86_xmm(3));
+        x86_sse(native, "addsd", 0xF2, 0x58, 0, x86_xmm(2));
+        x86_store(native, 0, slot);
+        return;
+    }
+
+    // Lane sums in xmm8-11, their compensations in xmm12-15 and the abs mask in xmm7.
+    x86_sse(native, "movsd", 0xF2, 0x10, 7,
+            x86_rip(native_constant(native, UINT64_C(0x7FFFFFFFFFFFFFFF))));
+
+    for (int reg = 8; reg < 16; reg++) {
+        x86_sse(native, "xorpd", 0x66, 0x57, reg, x86_xmm(reg));
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        int lane = (int)(i % SUM_LANES);
+
+        x86_load(native, 0, slot + i);
+        native_neumaier(native, 8 + lane, 12 + lane, 0);
+    }
+
+    x86_sse(native, "xorpd", 0x66, 0x57, 0, x86_xmm(0));
+    x86_sse(native, "xorpd", 0x66, 0x57, 3, x86_xmm(3));
+
+    for (int lane = 0; lane < SUM_LANES; lane++) {
+        native_neumaier(native, 0, 3, 8 + lane);
+        x86_sse(native, "addsd", 0xF2, 0x58, 3, x86_xmm(12 + lane));
+    }
+
+    x86_sse(native, "addsd", 0xF2, 0x58, 0, x86_xmm(3));
+    x86_store(native, 0, slot);
+}
+
+void native_int_power(struct native_code *native, size_t slot)
+{
+    // int_power as a loop: rax is the accumulator, rcx the base and rdx the exponent.
+    size_t loop = native_new_label(native);
+    size_t skip = native_new_label(native);
+    size_t done = native_new_label(native);
+
+    x86_load_integer(native, X86_RCX, slot);
+    x86_load_integer(native, X86_RDX, slot + 1);
+    x86_move_immediate(native, X86_RAX, 1);
+    x86_op(native, "testq", 0, true, 0x85, 1, x86_register(X86_RDX), x86_register(X86_RDX), true);
+    x86_jump(native, "js", 0x0F88, 2, native->integer_overflow);
+    native_bind_label(native, loop);
+    x86_op(native, "testq", 0, true, 0x85, 1, x86_register(X86_RDX), x86_register(X86_RDX), true);
+    x86_jump(native, "je", 0x0F84, 2, done);
+    x86_group(native, "testq", 0xF7, 1, 0, x86_register(X86_RDX), 4, 1);
+    x86_jump(native, "je", 0x0F84, 2, skip);
+    x86_op(native, "imulq", 0, true, 0x0FAF, 2, x86_register(X86_RAX), x86_register(X86_RCX),
+           false);
+    x86_jump(native, "jo", 0x0F80, 2, native->integer_overflow);
+    native_bind_label(native, skip);
+    x86_group(native, "shrq", 0xD1, 1, 5, x86_register(X86_RDX), 0, 0);
+    x86_jump(native, "je", 0x0F84, 2, done);
+    x86_op(native, "imulq", 0, true, 0x0FAF, 2, x86_register(X86_RCX), x86_register(X86_RCX),
+           false);
+    x86_jump(native, "jo", 0x0F80, 2, native->integer_overflow);
+    x86_jump(native, "jmp", 0xE9, 1, loop);
+    native_bind_label(native, done);
+    x86_store_integer(native, X86_RAX, slot);
+}
+
+void native_fail(struct native_code *native, size_t label, size_t message, size_t length)
+{
+    // Same as run_vm: the message goes to stderr and the process exits with EXIT_FAILURE.
+    native_bind_label(native, label);
+    x86_move_immediate(native, X86_RDI, 2);
+    x86_op(native, "leaq", 0, true, 0x8D, 1, x86_register(X86_RSI), x86_rip(message), false);
+    x86_move_immediate(native, X86_RDX, (int64_t)length);
+    x86_call(native, NATIVE_WRITE);
+    x86_move_immediate(native, X86_RDI, EXIT_FAILURE);
+    x86_call(native, NATIVE_EXIT);
+}
+
+void compile_native(const struct chunk *chunks, struct native_code *native)
+{
+    static const char division_message[] = "Division by zero\n";
+    static const char overflow_message[] = "Integer overflow\n";
+
+    // Every VM stack slot gets a fixed frame slot, so values survive the libm calls without any
+    // register allocation. Estrin's levels use the scratch slots above the deepest stack slot.
+    size_t max_depth = 0;
+    int64_t depth = 0;
+
+    for (size_t ip = 0; ip < chunks->code_size; ip++) {
+        depth += get_stack_effect(&chunks->code[ip]);
+        max_depth = depth > 0 && (size_t)depth > max_depth ? (size_t)depth : max_depth;
+    }
+
+    size_t scratch = max_depth;
+    size_t frame = 8 * (scratch + POW_INT_MAX_EXPONENT + 1);
+    frame += frame % 16 == 0 ? 8 : 0;
+
+    native->division_by_zero = native_new_label(native);
+    native->integer_overflow = native_new_label(native);
+    size_t division_text = native_new_label(native);
+    size_t overflow_text = native_new_label(native);
+
+    (void)fprintf(native->listing, "    .text\n    .globl f\n    .type f, @function\nf:\n");
+    x86_group(native, "subq", 0x81, 1, 5, x86_register(X86_RSP), 4, (int64_t)frame);
+
+    bool integer_slots[MAX_STACK_SIZE];
+    size_t top = 0;
+
+    for (size_t ip = 0; ip < chunks->code_size; ip++) {
+        const struct bytecode *instruction = &chunks->code[ip];
+        size_t inputs =
+            instruction->code == OP_HALT ? 1 : (size_t)(1 - get_stack_effect(instruction));
+
+        if (top < inputs) {
+            (void)fprintf(stderr, "Stack undeflow\n");
+            exit(EXIT_FAILURE);
+        }
+
+        if (top - inputs + 1 > MAX_STACK_SIZE) {
+            (void)fprintf(stderr, "Stack overflow\n");
+            exit(EXIT_FAILURE);
+        }
+
+        top -= inputs;
+
+        // Operands start at frame slot top, the result replaces the first one.
+        size_t slot = top;
+        bool integer = false;
+
+        switch (instruction->code) {
+        case OP_CONSTANT: {
+            x86_sse(native, "movsd", 0xF2, 0x10, 0,
+                    x86_rip(native_double(native, chunks->constants[instruction->const_index])));
+            x86_store(native, 0, slot);
+        } break;
+
+        case OP_NEGATE: {
+            x86_group(native, "btcq", 0x0FBA, 2, 7, x86_stack(slot), 1, 63);
+        } break;
+
+        case OP_ADD:
+        case OP_SUBTRACT:
+        case OP_MULTIPLY:
+        case OP_DIVIDE: {
+            static const char *mnemonics[] = { "addsd", "subsd", "mulsd", "divsd" };
+            static const uint8_t opcodes[] = { 0x58, 0x5C, 0x59, 0x5E };
+            size_t index = (size_t)(instruction->code - OP_ADD);
+
+            if (instruction->code == OP_DIVIDE) {
+                x86_check_zero(native, slot + 1, false);
+            }
+
+            x86_load(native, 0, slot);
+            x86_sse(native, mnemonics[index], 0xF2, opcodes[index], 0, x86_stack(slot + 1));
+            x86_store(native, 0, slot);
+        } break;
+
+        case OP_MODULO:
+        case OP_POWER: {
+            if (instruction->code == OP_MODULO) {
+                x86_check_zero(native, slot + 1, false);
+            }
+
+            x86_load(native, 0, slot);
+            x86_load(native, 1, slot + 1);
+            x86_call(native, instruction->code == OP_MODULO ? NATIVE_FMOD : NATIVE_POW);
+            x86_store(native, 0, slot);
+        } break;
+
+        case OP_POW_INT: {
+            native_pow_int(native, slot, (int64_t)instruction->operand);
+        } break;
+
+        case OP_FMA:
+        case OP_FMS: {
+            if (instruction->code == OP_FMS) {
+                x86_group(native, "btcq", 0x0FBA, 2, 7, x86_stack(slot + 2), 1, 63);
+            }
+
+            x86_load(native, 0, slot);
+            x86_load(native, 1, slot + 1);
+            x86_load(native, 2, slot + 2);
+            x86_call(native, NATIVE_FMA);
+            x86_store(native, 0, slot);
+        } break;
+
+        case OP_SQRT: {
+            x86_sse(native, "sqrtsd", 0xF2, 0x51, 0, x86_stack(slot));
+            x86_store(native, 0, slot);
+        } break;
+
+        case OP_HORNER:
+        case OP_HORNER_FMA:
+        case OP_ESTRIN: {
+            native_poly(native, instruction->code, &chunks->constants[instruction->const_index],
+                        instruction->operand, slot, scratch);
+        } break;
+
+        case OP_SUM_N:
+        case OP_COMPENSATED_SUM_N: {
+            native_sum(native, instruction->code, slot, inputs);
+        } break;
+
+        case OP_INT_CONSTANT: {
+            integer = true;
+            x86_move_immediate(native, X86_RAX, (int64_t)instruction->operand);
+            x86_store_integer(native, X86_RAX, slot);
+        } break;
+
+        case OP_INT_NEGATE: {
+            integer = true;
+            x86_load_integer(native, X86_RAX, slot);
+            x86_group(native, "negq", 0xF7, 1, 3, x86_register(X86_RAX), 0, 0);
+            x86_jump(native, "jo", 0x0F80, 2, native->integer_overflow);
+            x86_store_integer(native, X86_RAX, slot);
+        } break;
+
+        case OP_INT_ADD:
+        case OP_INT_SUBTRACT:
+        case OP_INT_MULTIPLY: {
+            integer = true;
+            x86_load_integer(native, X86_RAX, slot);
+
+            if (instruction->code == OP_INT_MULTIPLY) {
+                x86_op(native, "imulq", 0, true, 0x0FAF, 2, x86_register(X86_RAX),
+                       x86_stack(slot + 1), false);
+            } else {
+                bool add = instruction->code == OP_INT_ADD;
+                x86_op(native, add ? "addq" : "subq", 0, true, add ? 0x03 : 0x2B, 1,
+                       x86_register(X86_RAX), x86_stack(slot + 1), false);
+            }
+
+            x86_jump(native, "jo", 0x0F80, 2, native->integer_overflow);
+            x86_store_integer(native, X86_RAX, slot);
+        } break;
+
+        case OP_INT_MODULO: {
+            // INT64_MIN % -1 traps in idiv, so -1 skips straight to a zero remainder.
+            size_t store = native_new_label(native);
+
+            integer = true;
+            x86_check_zero(native, slot + 1, true);
+            x86_move_immediate(native, X86_RDX, 0);
+            x86_group(native, "cmpq", 0x83, 1, 7, x86_register(X86_RCX), 1, -1);
+            x86_jump(native, "je", 0x0F84, 2, store);
+            x86_load_integer(native, X86_RAX, slot);
+            native_bytes(native, 0x48, 1);
+            native_bytes(native, 0x99, 1);
+            native_text(native, "cqto");
+            x86_group(native, "idivq", 0xF7, 1, 7, x86_register(X86_RCX), 0, 0);
+            native_bind_label(native, store);
+            x86_store_integer(native, X86_RDX, slot);
+        } break;
+
+        case OP_INT_POWER: {
+            integer = true;
+            native_int_power(native, slot);
+        } break;
+
+        case OP_INT_TO_DOUBLE: {
+            x86_op(native, "cvtsi2sdq", 0xF2, true, 0x0F2A, 2, x86_xmm(0), x86_stack(slot),
+                   false);
+            x86_store(native, 0, slot);
+        } break;
+
+        case OP_HALT: {
+            // Integer results are widened, the signature returns a double either way.
+            if (integer_slots[top]) {
+                x86_op(native, "cvtsi2sdq", 0xF2, true, 0x0F2A, 2, x86_xmm(0), x86_stack(slot),
+                       false);
+            } else {
+                x86_load(native, 0, slot);
+            }
+
+            x86_group(native, "addq", 0x81, 1, 0, x86_register(X86_RSP), 4, (int64_t)frame);
+            native_bytes(native, 0xC3, 1);
+            native_text(native, "ret");
+        } break;
+
+        default: {
+            (void)fprintf(stderr, "Unknown instruction code");
+            exit(EXIT_FAILURE);
+        }
+        }
+
+        if (instruction->code == OP_HALT) {
+            break;
+        }
+
+        integer_slots[top++] = integer;
+    }
+
+    native_fail(native, native->division_by_zero, division_text, sizeof(division_message) - 1);
+    native_fail(native, native->integer_overflow, overflow_text, sizeof(overflow_message) - 1);
+
+    // The constants follow the code in .text, so RIP-relative loads need no relocations.
+    (void)fprintf(native->listing, "    .p2align 3\n");
+    while (native->code_size % 8 != 0) {
+        native_bytes(native, 0x90, 1);
+    }
+
+    for (size_t i = 0; i < native->constant_count; i++) {
+        native_bind_label(native, native->constants[i].label);
+        native_bytes(native, native->constants[i].bits, 8);
+        native_text(native, ".quad 0x%016" PRIx64, native->constants[i].bits);
+    }
+
+    native_bind_label(native, division_text);
+    native_text(native, ".ascii \"Division by zero\\n\"");
+    for (size_t i = 0; i < sizeof(division_message) - 1; i++) {
+        native_bytes(native, (uint8_t)division_message[i], 1);
+    }
+
+    native_bind_label(native, overflow_text);
+    native_text(native, ".ascii \"Integer overflow\\n\"");
+    for (size_t i = 0; i < sizeof(overflow_message) - 1; i++) {
+        native_bytes(native, (uint8_t)overflow_message[i], 1);
+    }
+
+    (void)fprintf(native->listing, "    .size f, .-f\n    .section .note.GNU-stack,\"\",@progbits\n");
+
+    for (size_t i = 0; i < native->fixup_count; i++) {
+        const struct x86_fixup *fixup = &native->fixups[i];
+        int64_t relative = (int64_t)native->labels[fixup->label] - (int64_t)fixup->end;
+
+        for (size_t byte = 0; byte < 4; byte++) {
+            native->code[fixup->offset + byte] = (uint8_t)((uint64_t)relative >> (8 * byte));
+        }
+    }
+}
+
+void write_native_object(const struct native_code *native, FILE *file)
+{
+    static const char *names[NATIVE_SYMBOL_COUNT] = { "pow", "fmod", "fma", "write", "exit" };
+    static const char section_names[] =
+        "\0.text\0.rela.text\0.symtab\0.strtab\0.shstrtab\0.note.GNU-stack";
+    enum { TEXT = 1, RELA = 2, SYMTAB = 3, STRTAB = 4, SHSTRTAB = 5, NOTE = 6, SECTIONS = 7 };
+
+    // Symbol 0 is the null symbol and 1 is f, the used libc/libm functions follow.
+    Elf64_Sym symbols[2 + NATIVE_SYMBOL_COUNT] = { { 0 } };
+    size_t symbol_index[NATIVE_SYMBOL_COUNT] = { 0 };
+    char strings[64] = "\0f";
+    size_t strings_size = 3;
+    size_t symbol_count = 2;
+
+    symbols[1] = (Elf64_Sym){ .st_name = 1,
+                              .st_info = ELF64_ST_INFO(STB_GLOBAL, STT_FUNC),
+                              .st_shndx = TEXT,
+                              .st_size = native->code_size };
+
+    for (size_t i = 0; i < NATIVE_SYMBOL_COUNT; i++) {
+        if (!native->used[i]) {
+            continue;
+        }
+
+        symbol_index[i] = symbol_count;
+        symbols[symbol_count++] =
+            (Elf64_Sym){ .st_name = (Elf64_Word)strings_size,
+                         .st_info = ELF64_ST_INFO(STB_GLOBAL, STT_NOTYPE) };
+        memcpy(strings + strings_size, names[i], strlen(names[i]) + 1);
+        strings_size += strlen(names[i]) + 1;
+    }
+
+    size_t text_offset = sizeof(Elf64_Ehdr);
+    size_t rela_offset = (text_offset + native->code_size + 7) & ~(size_t)7;
+    size_t symtab_offset = rela_offset + native->call_count * sizeof(Elf64_Rela);
+    size_t strtab_offset = symtab_offset + symbol_count * sizeof(Elf64_Sym);
+    size_t shstrtab_offset = strtab_offset + strings_size;
+    size_t headers_offset = (shstrtab_offset + sizeof(section_names) + 7) & ~(size_t)7;
+
+    Elf64_Ehdr header = { .e_ident = { ELFMAG0, ELFMAG1, ELFMAG2, ELFMAG3, ELFCLASS64, ELFDATA2LSB,
+                                       EV_CURRENT, ELFOSABI_SYSV },
+                          .e_type = ET_REL,
+                          .e_machine = EM_X86_64,
+                          .e_version = EV_CURRENT,
+                          .e_shoff = headers_offset,
+                          .e_ehsize = sizeof(Elf64_Ehdr),
+                          .e_shentsize = sizeof(Elf64_Shdr),
+                          .e_shnum = SECTIONS,
+                          .e_shstrndx = SHSTRTAB };
+
+    Elf64_Shdr sections[SECTIONS] = { { 0 } };
+    sections[TEXT] = (Elf64_Shdr){ .sh_name = 1,
+                                   .sh_type = SHT_PROGBITS,
+                                   .sh_flags = SHF_ALLOC | SHF_EXECINSTR,
+                                   .sh_offset = text_offset,
+                                   .sh_size = native->code_size,
+                                   .sh_addralign = 16 };
+    sections[RELA] = (Elf64_Shdr){ .sh_name = 7,
+                                   .sh_type = SHT_RELA,
+                                   .sh_flags = SHF_INFO_LINK,
+                                   .sh_offset = rela_offset,
+                                   .sh_size = native->call_count * sizeof(Elf64_Rela),
+                                   .sh_link = SYMTAB,
+                                   .sh_info = TEXT,
+                                   .sh_addralign = 8,
+                                   .sh_entsize = sizeof(Elf64_Rela) };
+    sections[SYMTAB] = (Elf64_Shdr){ .sh_name = 18,
+                                     .sh_type = SHT_SYMTAB,
+                                     .sh_offset = symtab_offset,
+                                     .sh_size = symbol_count * sizeof(Elf64_Sym),
+                                     .sh_link = STRTAB,
+                                     .sh_info = 1,
+                                     .sh_addralign = 8,
+                                     .sh_entsize = sizeof(Elf64_Sym) };
+    sections[STRTAB] = (Elf64_Shdr){ .sh_name = 26,
+                                     .sh_type = SHT_STRTAB,
+                                     .sh_offset = strtab_offset,
+                                     .sh_size = strings_size,
+                                     .sh_addralign = 1 };
+    sections[SHSTRTAB] = (Elf64_Shdr){ .sh_name = 34,
+                                       .sh_type = SHT_STRTAB,
+                                       .sh_offset = shstrtab_offset,
+                                       .sh_size = sizeof(section_names),
+                                       .sh_addralign = 1 };
+    sections[NOTE] = (Elf64_Shdr){ .sh_name = 44,
+                                   .sh_type = SHT_PROGBITS,
+                                   .sh_offset = headers_offset,
+                                   .sh_addralign = 1 };
+
+    static const uint8_t padding[8] = { 0 };
+
+    (void)fwrite(&header, sizeof(header), 1, file);
+    (void)fwrite(native->code, 1, native->code_size, file);
+    (void)fwrite(padding, 1, rela_offset - text_offset - native->code_size, file);
+
+    for (size_t i = 0; i < native->call_count; i++) {
+        // PLT32 with -4 because the displacement is relative to the end of the call.
+        Elf64_Rela relocation = {
+            .r_offset = native->calls[i].offset,
+            .r_info = ELF64_R_INFO(symbol_index[native->calls[i].symbol], R_X86_64_PLT32),
+            .r_addend = -4
+        };
+        (void)fwrite(&relocation, sizeof(relocation), 1, file);
+    }
+
+    (void)fwrite(symbols, sizeof(*symbols), symbol_count, file);
+    (void)fwrite(strings, 1, strings_size, file);
+    (void)fwrite(section_names, 1, sizeof(section_names), file);
+    (void)fwrite(padding, 1, headers_offset - shstrtab_offset - sizeof(section_names), file);
+    (void)fwrite(sections, sizeof(*sections), SECTIONS, file);
+}
+
+void write_native(const struct chunk *chunks, const char *path, bool object)
+{
+    struct native_code native = { 0 };
+    char *listing = NULL;
+    size_t listing_size = 0;
+
+    native.listing = open_memstream(&listing, &listing_size);
+    if (!native.listing) {
+        (void)fprintf(stderr, "Go download more ram\n");
+        exit(EXIT_FAILURE);
+    }
+
+    compile_native(chunks, &native);
+    (void)fclose(native.listing);
+
+    FILE *file = strcmp(path, "-") == 0 ? stdout : fopen(path, object ? "wb" : "w");
+
+    if (!file) {
+        (void)fprintf(stderr, "Could not write '%s': %s\n", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    if (object) {
+        write_native_object(&native, file);
+    } else {
+        (void)fputs(listing, file);
+    }
+
+    if (file != stdout && fclose(file) != 0) {
+        (void)fprintf(stderr, "Could not write '%s': %s\n", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    free(listing);
+    free(native.code);
+    free(native.labels);
+    free(native.fixups);
+    free(native.calls);
+    free(native.constants);
+}
+
+#ifdef VM_PROFILE_CYCLES
+uint64_t vm_profile_clock(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    // No portable cycle counter, nanoseconds keep the ranking meaningful.
+    return now_ns();
+#endif
+}
+#endif
+
+#ifdef VM_PROFILE
+int compare_profile_rows(const void *a, const void *b)
+{
+    // Rows are (key, index) pairs, largest key first.
+    const uint64_t *lhs = a;
+    const uint64_t *rhs = b;
+
+    return (lhs[0] < rhs[0]) - (lhs[0] > rhs[0]);
+}
+
+void print_vm_profile(void)
+{
+    // Written to stderr so --bench JSON on stdout stays parseable.
+    uint64_t rows[OP_COUNT][2];
+    uint64_t total_count = 0;
+    uint64_t total_cycles = 0;
+    size_t row_count = 0;
+
+    for (size_t code = 0; code < OP_COUNT; code++) {
+        total_count += vm_profile.counts[code];
+        total_cycles += vm_profile.cycles[code];
+
+        if (vm_profile.counts[code] > 0) {
+#ifdef VM_PROFILE_CYCLES
+            rows[row_count][0] = vm_profile.cycles[code];
+#else
+            rows[row_count][0] = vm_profile.counts[code];
+#endif
+            rows[row_count][1] = code;
+            row_count += 1;
+        }
+    }
+
+    qsort(rows, row_count, sizeof(rows[0]), compare_profile_rows);
+
+#ifdef VM_PROFILE_CYCLES
+    (void)fprintf(stderr, "%-20s %14s %7s %16s %7s %10s\n", "Opcode", "Count", "%", "Cycles",
+                  "%", "Cyc/op");
+#else
+    (void)fprintf(stderr, "%-20s %14s %7s\n", "Opcode", "Count", "%");
+#endif
+
+    for (size_t i = 0; i < row_count; i++) {
+        size_t code = rows[i][1];
+        uint64_t count = vm_profile.counts[code];
+
+        (void)fprintf(stderr, "%-20s %14" PRIu64 " %6.2f%%", get_opcode_string((enum opcode)code),
+                      count, 100.0 * (double)count / (double)total_count);
+#ifdef VM_PROFILE_CYCLES
+        uint64_t cycles = vm_profile.cycles[code];
+        (void)fprintf(stderr, " %16" PRIu64 " %6.2f%% %10.1f", cycles,
+                      total_cycles > 0 ? 100.0 * (double)cycles / (double)total_cycles : 0.0,
+                      (double)cycles / (double)count);
+#endif
+        (void)fprintf(stderr, "\n");
+    }
+
+    uint64_t pairs[VM_PROFILE_TOP_PAIRS + 1][2];
+    uint64_t total_pairs = 0;
+    size_t pair_count = 0;
+
+    // Insertion into a short sorted list, the pair table is too sparse to sort whole.
+    for (size_t pair = 0; pair < (size_t)OP_COUNT * OP_COUNT; pair++) {
+        uint64_t count = vm_profile.pairs[pair / OP_COUNT][pair % OP_COUNT];
+        total_pairs += count;
+
+        if (count == 0) {
+            continue;
+        }
+
+        size_t slot = pair_count < VM_PROFILE_TOP_PAIRS ? pair_count++ : VM_PROFILE_TOP_PAIRS;
+        pairs[slot][0] = count;
+        pairs[slot][1] = pair;
+
+        for (; slot > 0 && pairs[slot - 1][0] < pairs[slot][0]; slot--) {
+            uint64_t swap[2] = { pairs[slot - 1][0], pairs[slot - 1][1] };
+            pairs[slot - 1][0] = pairs[slot][0];
+            pairs[slot - 1][1] = pairs[slot][1];
+            pairs[slot][0] = swap[0];
+            pairs[slot][1] = swap[1];
+        }
+    }
+
+    (void)fprintf(stderr, "\n%-41s %14s %7s\n", "Pair", "Count", "%");
+
+    for (size_t i = 0; i < pair_count; i++) {
+        size_t pair = pairs[i][1];
+
+        (void)fprintf(stderr, "%-20s %-20s %14" PRIu64 " %6.2f%%\n",
+                      get_opcode_string((enum opcode)(pair / OP_COUNT)),
+                      get_opcode_string((enum opcode)(pair % OP_COUNT)), pairs[i][0],
+                      100.0 * (double)pairs[i][0] / (double)total_pairs);
+    }
+}
+#endif
+
+#ifdef TRACK_ALLOCATIONS
+void track_live_bytes(enum alloc_subsystem subsystem, size_t freed, size_t allocated)
+{
+    struct alloc_stats *stats = &allocation_tracker.subsystems[subsystem];
+    struct phase_stats *phase = &allocation_tracker.phases[allocation_tracker.phase];
+
+    stats->live_bytes = stats->live_bytes - freed + allocated;
+    allocation_tracker.live_bytes = allocation_tracker.live_bytes - freed + allocated;
+
+    if (stats->live_bytes > stats->peak_bytes) {
+        stats->peak_bytes = stats->live_bytes;
+    }
+
+    if (allocation_tracker.live_bytes > phase->peak_bytes) {
+        phase->peak_bytes = allocation_tracker.live_bytes;
+    }
+}
+
+void *tracked_malloc(enum alloc_subsystem subsystem, size_t size)
+{
+    void *pointer = malloc(size);
+
+    if (pointer) {
+        allocation_tracker.subsystems[subsystem].allocations += 1;
+        allocation_tracker.subsystems[subsystem].requested_bytes += size;
+        allocation_tracker.phases[allocation_tracker.phase].allocations += 1;
+        allocation_tracker.phases[allocation_tracker.phase].requested_bytes += size;
+        track_live_bytes(subsystem, 0, malloc_usable_size(pointer));
+    }
+
+    return pointer;
+}
+
+void *tracked_realloc(enum alloc_subsystem subsystem, void *pointer, size_t size)
+{
+    size_t old_size = pointer ? malloc_usable_size(pointer) : 0;
+    void *resized = realloc(pointer, size);
+
+    if (resized) {
+        struct alloc_stats *stats = &allocation_tracker.subsystems[subsystem];
+
+        stats->reallocs += 1;
+        stats->growths += size > old_size;
+        stats->moves += pointer && resized != pointer;
+        stats->requested_bytes += size > old_size ? size - old_size : 0;
+        allocation_tracker.phases[allocation_tracker.phase].allocations += 1;
+        allocation_tracker.phases[allocation_tracker.phase].requested_bytes +=
+            size > old_size ? size - old_size : 0;
+        track_live_bytes(subsystem, old_size, malloc_usable_size(resized));
+    }
+
+    return resized;
+}
+
+void tracked_free(enum alloc_subsystem subsystem, void *pointer)
+{
+    if (!pointer) {
+        return;
+    }
+
+    allocation_tracker.subsystems[subsystem].frees += 1;
+    track_live_bytes(subsystem, malloc_usable_size(pointer), 0);
+    free(pointer);
+}
+
+void track_phase(enum pipeline_phase phase)
+{
+    // A phase peak starts from whatever the earlier phases left alive.
+    allocation_tracker.runs += phase == PHASE_TOKENIZE;
+    allocation_tracker.phase = phase;
+
+    if (allocation_tracker.live_bytes > allocation_tracker.phases[phase].peak_bytes) {
+        allocation_tracker.phases[phase].peak_bytes = allocation_tracker.live_bytes;
+    }
+}
+
+void print_allocation_stats(void)
+{
+    static const char *subsystem_names[ALLOC_SUBSYSTEM_COUNT] = { "lexer", "ast", "bytecode" };
+    static const char *phase_names[PHASE_COUNT] = { "tokenize", "parse",  "passes",
+                                                    "compile",  "run_vm", "eval_ast" };
+    double runs = allocation_tracker.runs > 0 ? (double)allocation_tracker.runs : 1.0;
+
+    // Written to stderr so --bench JSON on stdout stays parseable. Counts are per run, peaks
+    // are the largest seen in any run.
+    (void)fprintf(stderr, "Runs: %" PRIu64 "\n", allocation_tracker.runs);
+    (void)fprintf(stderr, "%-10s %10s %10s %10s %10s %10s %12s %12s %12s\n", "Subsystem",
+                  "Allocs", "Reallocs", "Growths", "Moves", "Frees", "Bytes", "Live", "Peak");
+
+    for (size_t i = 0; i < ALLOC_SUBSYSTEM_COUNT; i++) {
+        const struct alloc_stats *stats = &allocation_tracker.subsystems[i];
+
+        (void)fprintf(stderr, "%-10s %10.1f %10.1f %10.1f %10.1f %10.1f %12.1f %12zu %12zu\n",
+                      subsystem_names[i], (double)stats->allocations / runs,
+                      (double)stats->reallocs / runs, (double)stats->growths / runs,
+                      (double)stats->moves / runs, (double)stats->frees / runs,
+                      (double)stats->requested_bytes / runs, stats->live_bytes,
+                      stats->peak_bytes);
+    }
+
+    (void)fprintf(stderr, "\n%-10s %10s %12s %12s\n", "Phase", "Allocs", "Bytes", "Peak");
+
+    for (size_t i = 0; i < PHASE_COUNT; i++) {
+        const struct phase_stats *stats = &allocation_tracker.phases[i];
+
+        (void)fprintf(stderr, "%-10s %10.1f %12.1f %12zu\n", phase_names[i],
+                      (double)stats->allocations / runs, (double)stats->requested_bytes / runs,
+                      stats->peak_bytes);
+    }
+}
+#endif
+
+void free_chunks(struct chunk *chunks)
+{
+    if (!chunks) {
+        return;
+    }
+
+    TRACKED_FREE(ALLOC_BYTECODE, chunks->code);
+    chunks->code = NULL;
+
+    TRACKED_FREE(ALLOC_BYTECODE, chunks->constants);
+    chunks->constants = NULL;
+
+    TRACKED_FREE(ALLOC_BYTECODE, chunks->literals);
+    chunks->literals = NULL;
+}
+
+void init_chunks(struct chunk *chunks)
+{
+    chunks->code_capacity = DEFAULT_CAPACITY;
+    chunks->code_size = 0;
+    chunks->depth = 0;
+    chunks->max_depth = 0;
+    chunks->underflow = false;
+    chunks->code = TRACKED_MALLOC(ALLOC_BYTECODE, chunks->code_capacity * sizeof(*chunks->code));
+
+    if (!chunks->code) {
+        (void)fprintf(stderr, "Go download more ram\n");
+        exit(EXIT_FAILURE);
+    }
+
+    chunks->const_capacity = DEFAULT_CAPACITY;
+    chunks->const_size = 0;
+    chunks->constants =
+        TRACKED_MALLOC(ALLOC_BYTECODE, chunks->const_capacity * sizeof(*chunks->constants));
+    chunks->literals =
+        TRACKED_MALLOC(ALLOC_BYTECODE, chunks->const_capacity * sizeof(*chunks->literals));
+
+    if (!chunks->constants || !chunks->literals) {
+        (void)fprintf(stderr, "Go download more ram\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+enum opcode get_opcode_from_token_kind(enum token_kind kind)
+{
+    switch (kind) {
+    case NUMBER:
+        return OP_CONSTANT;
+    case PLUS:
+        return OP_ADD;
+    case MINUS:
+        return OP_SUBTRACT;
+    case STAR:
+        return OP_MULTIPLY;
+    case SLASH:
+        return OP_DIVIDE;
+    case PERCENT:
+        return OP_MODULO;
+    case CARET:
+        return OP_POWER;
+    default: {
+        return OP_HALT;
+    }
+    }
+}
+
+enum opcode get_int_opcode_from_token_kind(enum token_kind kind)
+{
+    switch (kind) {
+    case NUMBER:
+        return OP_INT_CONSTANT;
+    case PLUS:
+        return OP_INT_ADD;
+    case MINUS:
+        return OP_INT_SUBTRACT;
+    case STAR:
+        return OP_INT_MULTIPLY;
+    case PERCENT:
+        return OP_INT_MODULO;
+    case CARET:
+        return OP_INT_POWER;
+    default: {
+        return OP_HALT;
+    }
+    }
+}
+
+size_t add_constant(struct chunk *chunks, double value)
+{
+    return add_literal_constant(chunks, value, NULL, 0);
+}
+
+size_t add_literal_constant(struct chunk *chunks, double value, const char *text, size_t length)
+{
+    size_t index = chunks->const_size;
+    if (chunks->const_size >= chunks->const_capacity) {
+        chunks->const_capacity *= 2;
+
+        double *new_constants = TRACKED_REALLOC(ALLOC_BYTECODE, chunks->constants,
+                                                chunks->const_capacity * sizeof(*chunks->constants));
+
+        if (!new_constants) {
+            (void)fprintf(stderr, "Go download more ram\n");
+            exit(EXIT_FAILURE);
+        }
+
+        chunks->constants = new_constants;
+
+        struct literal *new_literals = TRACKED_REALLOC(
+            ALLOC_BYTECODE, chunks->literals, chunks->const_capacity * sizeof(*chunks->literals));
+
+        if (!new_literals) {
+            (void)fprintf(stderr, "Go download more ram\n");
+            exit(EXIT_FAILURE);
+        }
+
+        chunks->literals = new_literals;
+    }
+
+    chunks->literals[chunks->const_size] = (struct literal){ .text = text, .length = length };
+    chunks->constants[chunks->const_size++] = value;
+
+    return index;
+}
+
+void compile_ast_to_bytecode(struct chunk *chunks, struct ast_node *node)
+{
+    if (!node) {
+        return;
+    }
+
+    switch (node->type) {
+    case NODE_NUMBER: {
+        if (node->value_type == VALUE_INT) {
+            emit_bytecode_with_operand(chunks, OP_INT_CONSTANT, 0,
+                                       (size_t)node->data.number.integer);
+            break;
+        }
+
+        size_t const_index =
+            add_literal_constant(chunks, node->data.number.value, node->data.number.lexeme,
+                                 node->data.number.lexeme_length);
+        emit_bytecode(chunks, OP_CONSTANT, const_index);
+    } break;
+
+    case NODE_UNARY: {
+        if (node->value_type == VALUE_INT) {
+            compile_ast_to_bytecode(chunks, node->data.unary.child);
+        } else {
+            compile_as_double(chunks, node->data.unary.child);
+        }
+
+        switch (node->data.unary.op) {
+        case MINUS: {
+            emit_bytecode(chunks, node->value_type == VALUE_INT ? OP_INT_NEGATE : OP_NEGATE, 0);
+        } break;
+
+        case SQRT: {
+            emit_bytecode(chunks, OP_SQRT, 0);
+        } break;
+
+        case PLUS:
+            break;
+
+        default: {
+            (void)fprintf(stderr, "No such unary operator");
+            exit(EXIT_FAILURE);
+        }
+        };
+    } break;
+
+    case NODE_BINARY: {
+        if (node->value_type == VALUE_INT) {
+            compile_ast_to_bytecode(chunks, node->data.binary.left);
+            compile_ast_to_bytecode(chunks, node->data.binary.right);
+
+            emit_bytecode(chunks, get_int_opcode_from_token_kind(node->data.binary.op), 0);
+            break;
+        }
+
+        int64_t exponent = 0;
+        if (node->data.binary.op == CARET &&
+            get_constant_exponent(node->data.binary.right, &exponent)) {
+            compile_as_double(chunks, node->data.binary.left);
+            emit_bytecode_with_operand(chunks, OP_POW_INT, 0, (size_t)exponent);
+            break;
+        }
+
+        compile_as_double(chunks, node->data.binary.left);
+        compile_as_double(chunks, node->data.binary.right);
+
+        emit_bytecode(chunks, get_opcode_from_token_kind(node->data.binary.op), 0);
+    } break;
+
+    case NODE_SUM: {
+        for (size_t i = 0; i < node->data.sum.count; i++) {
+            compile_as_double(chunks, node->data.sum.terms[i]);
+        }
+
+        enum opcode code =
+            node->data.sum.mode == SUM_COMPENSATED ? OP_COMPENSATED_SUM_N : OP_SUM_N;
+        emit_bytecode_with_operand(chunks, code, 0, node->data.sum.count);
+    } break;
+
+    case NODE_FMA: {
+        compile_as_double(chunks, node->data.fma.multiplicand);
+        compile_as_double(chunks, node->data.fma.multiplier);
+        compile_as_double(chunks, node->data.fma.addend);
+
+        emit_bytecode(chunks, node->data.fma.subtract ? OP_FMS : OP_FMA, 0);
+    } break;
+
+    case NODE_POLY: {
+        compile_as_double(chunks, node->data.poly.base);
+
+        size_t first = chunks->const_size;
+        for (size_t i = 0; i <= node->data.poly.degree; i++) {
+            add_constant(chunks, node->data.poly.coefficients[i]);
+        }
+
+        enum opcode code = node->data.poly.scheme == POLY_HORNER_FMA ? OP_HORNER_FMA
+                           : node->data.poly.scheme == POLY_ESTRIN   ? OP_ESTRIN
+                                                                     : OP_HORNER;
+        emit_bytecode_with_operand(chunks, code, first, node->data.poly.degree);
+    } break;
+    }
+}
+
+void compile_as_double(struct chunk *chunks, struct ast_node *node)
+{
+    compile_ast_to_bytecode(chunks, node);
+
+    if (node && node->value_type == VALUE_INT) {
+        emit_bytecode(chunks, OP_INT_TO_DOUBLE, 0);
+    }
+}
+
+void emit_bytecode(struct chunk *chunks, enum opcode code, size_t const_index)
+{
+    emit_bytecode_with_operand(chunks, code, const_index, 0);
+}
+
+void emit_bytecode_with_operand(struct chunk *chunks, enum opcode code, size_t const_index,
+                                size_t operand)
+{
+    if (chunks->code_size >= chunks->code_capacity) {
+        chunks->code_capacity *= 2;
+
+        struct bytecode *new_code = TRACKED_REALLOC(ALLOC_BYTECODE, chunks->code,
+                                                    chunks->code_capacity * sizeof(*chunks->code));
+
+        if (!new_code) {
+            (void)fprintf(stderr, "Go download more ram\n");
+            exit(EXIT_FAILURE);
+        }
+
+        chunks->code = new_code;
+    }
+
+    chunks->code[chunks->code_size++] =
+        (struct bytecode){ .code = code, .const_index = const_index, .operand = operand };
+
+    const struct bytecode *instruction = &chunks->code[chunks->code_size - 1];
+    size_t inputs = code == OP_HALT ? 1 : (size_t)(1 - get_stack_effect(instruction));
+
+    chunks->underflow = chunks->underflow || chunks->depth < inputs;
+    chunks->depth = chunks->underflow ? 0 : chunks->depth - inputs + (code == OP_HALT ? 0 : 1);
+    chunks->max_depth = chunks->depth > chunks->max_depth ? chunks->depth : chunks->max_depth;
+}
+
+double sum_pairwise(const double *values, size_t count)
+{
+    if (count > SUM_BLOCK_SIZE) {
+        size_t half = count / 2;
+        return sum_pairwise(values, half) + sum_pairwise(values + half, count - half);
+    }
+
+    // Independent lanes break the serial dependency chain and let the compiler vectorize the
+    // block, the lanes are then combined pairwise.
+    double lanes[SUM_LANES] = { 0 };
+    size_t i = 0;
+
+    for (; i + SUM_LANES <= count; i += SUM_LANES) {
+        for (size_t lane = 0; lane < SUM_LANES; lane++) {
+            lanes[lane] += values[i + lane];
+        }
+    }
+
+    for (size_t lane = 0; i < count; i++, lane++) {
+        lanes[lane] += values[i];
+    }
+
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+double sum_compensated(const double *values, size_t count)
+{
+    // Neumaier's variant of Kahan summation, run independently per lane. The compensation is
+    // selected without a branch so the lanes stay in lockstep.
+    double sums[SUM_LANES] = { 0 };
+    double compensations[SUM_LANES] = { 0 };
+    size_t i = 0;
+
+    for (; i + SUM_LANES <= count; i += SUM_LANES) {
+        for (size_t lane = 0; lane < SUM_LANES; lane++) {
+            double value = values[i + lane];
+            double total = sums[lane] + value;
+            bool sum_is_larger = fabs(sums[lane]) >= fabs(value);
+
+            compensations[lane] +=
+                sum_is_larger ? (sums[lane] - total) + value : (value - total) + sums[lane];
+            sums[lane] = total;
+        }
+    }
+
+    for (size_t lane = 0; i < count; i++, lane++) {
+        double value = values[i];
+        double total = sums[lane] + value;
+
+        compensations[lane] += fabs(sums[lane]) >= fabs(value) ? (sums[lane] - total) + value
+                                                                : (value - total) + sums[lane];
+        sums[lane] = total;
+    }
+
+    double sum = 0.0;
+    double compensation = 0.0;
+
+    for (size_t lane = 0; lane < SUM_LANES; lane++) {
+        double total = sum + sums[lane];
+
+        compensation += fabs(sum) >= fabs(sums[lane]) ? (sum - total) + sums[lane]
+                                                      : (sums[lane] - total) + sum;
+        compensation += compensations[lane];
+        sum = total;
+    }
+
+    return sum + compensation;
+}
+
+double sum_values(const double *values, size_t count, enum sum_mode mode)
+{
+    switch (mode) {
+    case SUM_COMPENSATED:
+        return sum_compensated(values, count);
+    case SUM_PAIRWISE:
+        return sum_pairwise(values, count);
+    default: {
+        (void)fprintf(stderr, "Unknown summation mode\n");
+        exit(EXIT_FAILURE);
+    }
+    }
+}
+
+struct ast_node *build_sum_tree(struct ast_node **terms, size_t count, enum sum_mode mode)
+{
+    while (count > SUM_BLOCK_SIZE) {
+        size_t group_count = (count + SUM_BLOCK_SIZE - 1) / SUM_BLOCK_SIZE;
+
+        for (size_t group = 0; group < group_count; group++) {
+            size_t first = group * SUM_BLOCK_SIZE;
+            size_t size = count - first < SUM_BLOCK_SIZE ? count - first : SUM_BLOCK_SIZE;
+
+            terms[group] = build_sum_tree(terms + first, size, mode);
+        }
+
+        count = group_count;
+    }
+
+    if (count == 1) {
+        return terms[0];
+    }
+
+    struct ast_node **block = malloc(count * sizeof(*block));
+    if (!block) {
+        (void)fprintf(stderr, "Go download more ram\n");
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(block, terms, count * sizeof(*block));
+
+    return create_ast_node(
+        NODE_SUM,
+        (union node_data){ .sum.mode = mode, .sum.terms = block, .sum.count = count },
+        block[0]->start, block[count - 1]->end);
+}
+
+struct ast_node *fold_sums(struct ast_node *node, enum sum_mode mode)
+{
+    if (!node) {
+        return NULL;
+    }
+
+    switch (node->type) {
+    case NODE_NUMBER:
+    case NODE_SUM:
+    case NODE_FMA:
+        return node;
+
+    case NODE_POLY: {
+        node->data.poly.base = fold_sums(node->data.poly.base, mode);
+        return node;
+    }
+
+    case NODE_UNARY: {
+        node->data.unary.child = fold_sums(node->data.unary.child, mode);
+        return node;
+    }
+
+    case NODE_BINARY:
+        break;
+    }
+
+    enum token_kind op = node->data.binary.op;
+    bool is_chain = op == PLUS || op == MINUS;
+    bool is_long_chain =
+        is_chain && ((node->data.binary.left->type == NODE_BINARY &&
+                      (node->data.binary.left->data.binary.op == PLUS ||
+                       node->data.binary.left->data.binary.op == MINUS)) ||
+                     (node->data.binary.right->type == NODE_BINARY &&
+                      (node->data.binary.right->data.binary.op == PLUS ||
+                       node->data.binary.right->data.binary.op == MINUS)));
+
+    // Two operands gain nothing from a multi-operand sum, keep the plain instruction.
+    if (!is_long_chain) {
+        node->data.binary.left = fold_sums(node->data.binary.left, mode);
+        node->data.binary.right = fold_sums(node->data.binary.right, mode);
+        return node;
+    }
+
+    // The chain is walked with an explicit work list because machine generated sums are millions
+    // of nodes deep on the left spine.
+    size_t work_capacity = DEFAULT_CAPACITY;
+    size_t work_size = 0;
+    struct sum_work_item *work = malloc(work_capacity * sizeof(*work));
+
+    size_t term_capacity = DEFAULT_CAPACITY;
+    size_t term_count = 0;
+    struct ast_node **terms = malloc(term_capacity * sizeof(*terms));
+
+    if (!work || !terms) {
+        (void)fprintf(stderr, "Go download more ram\n");
+        exit(EXIT_FAILURE);
+    }
+
+    work[work_size++] = (struct sum_work_item){ .node = node, .negate = false };
+
+    while (work_size > 0) {
+        struct sum_work_item item = work[--work_size];
+        struct ast_node *current = item.node;
+
+        if (current->type == NODE_BINARY &&
+            (current->data.binary.op == PLUS || current->data.binary.op == MINUS)) {
+            if (work_size + 2 > work_capacity) {
+                work_capacity *= 2;
+                struct sum_work_item *new_work = realloc(work, work_capacity * sizeof(*work));
+
+                if (!new_work) {
+                    (void)fprintf(stderr, "Go download more ram\n");
+                    exit(EXIT_FAILURE);
+                }
+
+                work = new_work;
+            }
+
+            // Negation is exact, so a - b is summed as a + (-b).
+            work[work_size++] = (struct sum_work_item){
+                .node = current->data.binary.right,
+                .negate = item.negate != (current->data.binary.op == MINUS),
+            };
+            work[work_size++] = (struct sum_work_item){ .node = current->data.binary.left,
+                                                        .negate = item.negate };
+            TRACKED_FREE(ALLOC_AST, current);
+            continue;
+        }
+
+        struct ast_node *term = fold_sums(current, mode);
+
+        if (item.negate) {
+            term = create_ast_node(NODE_UNARY,
+                                   (union node_data){ .unary.child = term, .unary.op = MINUS },
+                                   term->start, term->end);
+        }
+
+        if (term_count >= term_capacity) {
+            term_capacity *= 2;
+            struct ast_node **new_terms = realloc(terms, term_capacity * sizeof(*terms));
+
+            if (!new_terms) {
+                (void)fprintf(stderr, "Go download more ram\n");
+                exit(EXIT_FAILURE);
+            }
+
+            terms = new_terms;
+        }
+
+        terms[term_count++] = term;
+    }
+
+    struct ast_node *sum = build_sum_tree(terms, term_count, mode);
+
+    free(work);
+    free(terms);
+
+    return sum;
+}
+
+struct ast_node *fuse_multiply_add(struct ast_node *node)
+{
+    // Runs after infer_types: int64 products are already exact, so only double products are
+    // fused. c - a * b becomes fma(-a, b, c), negation being exact.
+    switch (node->type) {
+    case NODE_NUMBER:
+    case NODE_FMA:
+        return node;
+
+    case NODE_POLY: {
+        node->data.poly.base = fuse_multiply_add(node->data.poly.base);
+        return node;
+    }
+
+    case NODE_UNARY: {
+        node->data.unary.child = fuse_multiply_add(node->data.unary.child);
+        return node;
+    }
+
+    case NODE_SUM: {
+        for (size_t i = 0; i < node->data.sum.count; i++) {
+            node->data.sum.terms[i] = fuse_multiply_add(node->data.sum.terms[i]);
+        }
+
+        return node;
+    }
+
+    case NODE_BINARY:
+        break;
+    }
+
+    node->data.binary.left = fuse_multiply_add(node->data.binary.left);
+    node->data.binary.right = fuse_multiply_add(node->data.binary.right);
+
+    enum token_kind op = node->data.binary.op;
+    struct ast_node *left = node->data.binary.left;
+    struct ast_node *right = node->data.binary.right;
+    bool left_is_product = left->type == NODE_BINARY && left->data.binary.op == STAR &&
+                           left->value_type == VALUE_DOUBLE;
+    bool right_is_product = right->type == NODE_BINARY && right->data.binary.op == STAR &&
+                            right->value_type == VALUE_DOUBLE;
+
+    if (node->value_type != VALUE_DOUBLE || (op != PLUS && op != MINUS) ||
+        (!left_is_product && !right_is_product)) {
+        return node;
+    }
+
+    struct ast_node *product = left_is_product ? left : right;
+    struct ast_node *addend = left_is_product ? right : left;
+    struct ast_node *multiplicand = product->data.binary.left;
+
+    if (!left_is_product && op == MINUS) {
+        multiplicand = create_ast_node(
+            NODE_UNARY, (union node_data){ .unary.child = multiplicand, .unary.op = MINUS },
+            multiplicand->start, multiplicand->end);
+        multiplicand->value_type = VALUE_DOUBLE;
+    }
+
+    struct ast_node *fused = create_ast_node(
+        NODE_FMA,
+        (union node_data){ .fma.multiplicand = multiplicand,
+                           .fma.multiplier = product->data.binary.right,
+                           .fma.addend = addend,
+                           .fma.subtract = left_is_product && op == MINUS },
+        node->start, node->end);
+    fused->value_type = VALUE_DOUBLE;
+
+    TRACKED_FREE(ALLOC_AST, product);
+    TRACKED_FREE(ALLOC_AST, node);
+
+    return fused;
+}
+
+struct ast_node *create_number_node(double value, bool is_integer, int64_t integer, size_t start,
+                                    size_t end)
+{
+    // Constants made by a rewrite have no source text, exact modes never see rewritten trees.
+    return create_ast_node(NODE_NUMBER,
+                           (union node_data){ .number.value = value,
+                                              .number.is_integer = is_integer,
+                                              .number.integer = integer,
+                                              .number.lexeme = NULL,
+                                              .number.lexeme_length = 0 },
+                           start, end);
+}
+
+bool is_number(const struct ast_node *node, double value)
+{
+    return node->type == NODE_NUMBER && node->data.number.value == value;
+}
+
+bool is_integer_number(const struct ast_node *node, double value)
+{
+    return is_number(node, value) && node->data.number.is_integer;
+}
+
+bool has_exact_reciprocal(double value)
+{
+    // Only powers of two whose reciprocal is a normal double, x / c and x * (1 / c) are then the
+    // same exact scaling and round identically.
+    int exponent = 0;
+    double reciprocal = 1.0 / value;
+
+    return isfinite(value) && value != 0.0 && fabs(frexp(value, &exponent)) == 0.5 &&
+           isnormal(reciprocal);
+}
+
+struct ast_node *merge_chain_constants(struct ast_node *node, size_t *fired)
+{
+    // Fast-math only: every literal of a + - chain or a * chain is folded into one trailing
+    // constant, which reassociates the chain. The chain is flattened with a work list like
+    // fold_sums, nested chains of the other kind are merged recursively.
+    if (node->type == NODE_UNARY) {
+        node->data.unary.child = merge_chain_constants(node->data.unary.child, fired);
+        return node;
+    }
+
+    if (node->type == NODE_SUM) {
+        for (size_t i = 0; i < node->data.sum.count; i++) {
+            node->data.sum.terms[i] = merge_chain_constants(node->data.sum.terms[i], fired);
+        }
+
+        return node;
+    }
+
+    if (node->type == NODE_POLY) {
+        node->data.poly.base = merge_chain_constants(node->data.poly.base, fired);
+        return node;
+    }
+
+    if (node->type != NODE_BINARY) {
+        return node;
+    }
+
+    enum token_kind op = node->data.binary.op;
+    bool is_sum = op == PLUS || op == MINUS;
+
+    if (!is_sum && op != STAR) {
+        node->data.binary.left = merge_chain_constants(node->data.binary.left, fired);
+        node->data.binary.right = merge_chain_constants(node->data.binary.right, fired);
+        return node;
+    }
+
+    size_t work_capacity = DEFAULT_CAPACITY;
+    size_t work_size = 0;
+    struct sum_work_item *work = malloc(work_capacity * sizeof(*work));
+
+    size_t term_capacity = DEFAULT_CAPACITY;
+    size_t term_count = 0;
+    struct sum_work_item *terms = malloc(term_capacity * sizeof(*terms));
+
+    if (!work || !terms) {
+        (void)fprintf(stderr, "Go download more ram\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t start = node->start;
+    size_t end = node->end;
+    size_t constant_count = 0;
+    double constant = is_sum ? 0.0 : 1.0;
+    int64_t integer_constant = is_sum ? 0 : 1;
+    bool is_integer = true;
+
+    work[work_size++] = (struct sum_work_item){ .node = node, .negate = false };
+
+    while (work_size > 0) {
+        struct sum_work_item item = work[--work_size];
+        struct ast_node *current = item.node;
+        bool in_chain = current->type == NODE_BINARY &&
+                        (is_sum ? current->data.binary.op == PLUS ||
+                                      current->data.binary.op == MINUS
+                                : current->data.binary.op == STAR);
+
+        if (in_chain) {
+            if (work_size + 2 > work_capacity) {
+                work_capacity *= 2;
+                struct sum_work_item *new_work = realloc(work, work_capacity * sizeof(*work));
+
+                if (!new_work) {
+                    (void)fprintf(stderr, "Go download more ram\n");
+                    exit(EXIT_FAILURE);
+                }
+
+                work = new_work;
+            }
+
+            work[work_size++] = (struct sum_work_item){
+                .node = current->data.binary.right,
+                .negate = item.negate != (current->data.binary.op == MINUS),
+            };
+            work[work_size++] = (struct sum_work_item){ .node = current->data.binary.left,
+                                                        .negate = item.negate };
+            TRACKED_FREE(ALLOC_AST, current);
+            continue;
+        }
+
+        // A nested chain of the other kind can fold down to a literal of its own.
+        current = merge_chain_constants(current, fired);
+
+        if (current->type == NODE_NUMBER) {
+            double value = item.negate ? -current->data.number.value : current->data.number.value;
+            int64_t integer = current->data.number.integer;
+
+            constant = is_sum ? constant + value : constant * value;
+            is_integer = is_integer && current->data.number.is_integer &&
+                         (!item.negate || !__builtin_sub_overflow((int64_t)0, integer, &integer)) &&
+                         int_binary_op(is_sum ? PLUS : STAR, integer_constant, integer,
+                                       &integer_constant);
+            constant_count += 1;
+            free_ast_node(current);
+            continue;
+        }
+
+        if (term_count >= term_capacity) {
+            term_capacity *= 2;
+            struct sum_work_item *new_terms = realloc(terms, term_capacity * sizeof(*terms));
+
+            if (!new_terms) {
+                (void)fprintf(stderr, "Go download more ram\n");
+                exit(EXIT_FAILURE);
+            }
+
+            terms = new_terms;
+        }
+
+        terms[term_count++] = (struct sum_work_item){ .node = current, .negate = item.negate };
+    }
+
+    if (constant_count > 1) {
+        fired[RULE_MERGE_CONSTANTS] += 1;
+    }
+
+    // Rebuild left to right with the merged constant last, a - b stays a subtraction.
+    struct ast_node *result = NULL;
+
+    for (size_t i = 0; i < term_count; i++) {
+        struct ast_node *term = terms[i].node;
+
+        if (!result) {
+            result = terms[i].negate
+                         ? create_ast_node(
+                               NODE_UNARY,
+                               (union node_data){ .unary.child = term, .unary.op = MINUS },
+                               term->start, term->end)
+                         : term;
+            continue;
+        }
+
+        enum token_kind term_op = !is_sum ? STAR : terms[i].negate ? MINUS : PLUS;
+        result = create_ast_node(NODE_BINARY,
+                                 (union node_data){ .binary.op = term_op,
+                                                    .binary.left = result,
+                                                    .binary.right = term },
+                                 start, end);
+    }
+
+    if (constant_count > 0) {
+        bool negate = is_sum && result && constant < 0.0;
+        int64_t integer = integer_constant;
+
+        if (negate && !__builtin_sub_overflow((int64_t)0, integer_constant, &integer)) {
+            constant = -constant;
+        } else if (negate) {
+            negate = false;
+        }
+
+        struct ast_node *number = create_number_node(constant, is_integer, integer, start, end);
+
+        result = !result ? number
+                         : create_ast_node(NODE_BINARY,
+                                           (union node_data){
+                                               .binary.op = !is_sum ? STAR
+                                                            : negate ? MINUS
+                                                                     : PLUS,
+                                               .binary.left = result,
+                                               .binary.right = number },
+                                           start, end);
+    }
+
+    free(work);
+    free(terms);
+
+    return result;
+}
+
+struct ast_node *simplify_node(struct ast_node *node, bool fast_math, size_t *fired)
+{
+    // Applies at most one rule at the root of an already simplified subtree. Unless fast_math is
+    // set every rule is exact for all inputs including -0, infinities and NaN.
+    if (node->type == NODE_UNARY) {
+        struct ast_node *child = node->data.unary.child;
+
+        if (node->data.unary.op == PLUS) {
+            fired[RULE_UNARY_PLUS] += 1;
+            TRACKED_FREE(ALLOC_AST, node);
+            return child;
+        }
+
+        if (node->data.unary.op == MINUS && child->type == NODE_UNARY &&
+            child->data.unary.op == MINUS) {
+            struct ast_node *grandchild = child->data.unary.child;
+
+            fired[RULE_DOUBLE_NEGATION] += 1;
+            TRACKED_FREE(ALLOC_AST, child);
+            TRACKED_FREE(ALLOC_AST, node);
+            return grandchild;
+        }
+
+        return node;
+    }
+
+    if (node->type != NODE_BINARY) {
+        return node;
+    }
+
+    struct ast_node *left = node->data.binary.left;
+    struct ast_node *right = node->data.binary.right;
+    enum simplify_rule rule = RULE_COUNT;
+    struct ast_node *result = NULL;
+
+    switch (node->data.binary.op) {
+    case CARET: {
+        // x^2 already runs as one multiply through OP_POW_INT, the rewrite only pays off when
+        // x is a literal that can be duplicated for free.
+        if (is_number(right, 2.0) && left->type == NODE_NUMBER) {
+            struct ast_node *copy = create_ast_node(NODE_NUMBER, left->data, left->start, left->end);
+
+            node->data.binary.op = STAR;
+            node->data.binary.right = copy;
+            free_ast_node(right);
+            fired[RULE_SQUARE] += 1;
+            return node;
+        }
+
+        // sqrt(-0) is -0 and sqrt(-inf) is NaN where pow gives +0 and +inf.
+        if (fast_math && is_number(right, 0.5)) {
+            rule = RULE_SQRT;
+            result = create_ast_node(NODE_UNARY,
+                                     (union node_data){ .unary.child = left, .unary.op = SQRT },
+                                     node->start, node->end);
+            free_ast_node(right);
+        }
+    } break;
+
+    case STAR: {
+        // Like x / 1 below, x * 1.0 stays: without the double literal infer_types could keep an
+        // integer x that the multiplication would have rounded. An integer 1 never changes the type.
+        if (is_integer_number(right, 1.0) || is_integer_number(left, 1.0)) {
+            rule = RULE_MULTIPLY_ONE;
+            result = is_integer_number(right, 1.0) ? left : right;
+            free_ast_node(is_integer_number(right, 1.0) ? right : left);
+        }
+    } break;
+
+    case SLASH: {
+        // x / 1 stays, turning it into x would let infer_types keep an integer the division
+        // would have rounded.
+        if (right->type == NODE_NUMBER && fabs(right->data.number.value) != 1.0 &&
+            (has_exact_reciprocal(right->data.number.value) ||
+             (fast_math && isfinite(right->data.number.value) &&
+              right->data.number.value != 0.0))) {
+            double reciprocal = 1.0 / right->data.number.value;
+            struct ast_node *number =
+                create_number_node(reciprocal, false, 0, right->start, right->end);
+
+            node->data.binary.op = STAR;
+            node->data.binary.right = number;
+            free_ast_node(right);
+            fired[RULE_RECIPROCAL] += 1;
+            return node;
+        }
+    } break;
+
+    case PLUS: {
+        // -0 + 0 is +0, so dropping the zero is only safe under fast-math.
+        if (fast_math && (is_number(right, 0.0) || is_number(left, 0.0))) {
+            rule = RULE_ADD_ZERO;
+            result = is_number(right, 0.0) ? left : right;
+            free_ast_node(is_number(right, 0.0) ? right : left);
+        }
+    } break;
+
+    case MINUS: {
+        // -0 - (-0) is +0, so only a +0 literal is dropped without fast-math, and only an integer
+        // one for the same reason as x * 1.
+        if (is_integer_number(right, 0.0) && (fast_math || !signbit(right->data.number.value))) {
+            rule = RULE_SUBTRACT_ZERO;
+            result = left;
+            free_ast_node(right);
+        } else if (fast_math && is_number(left, 0.0)) {
+            // 0 - 0 is +0 where -0 is negative.
+            rule = RULE_ZERO_SUBTRACT;
+            result = create_ast_node(NODE_UNARY,
+                                     (union node_data){ .unary.child = right, .unary.op = MINUS },
+                                     node->start, node->end);
+            free_ast_node(left);
+        }
+    } break;
+
+    default:
+        break;
+    }
+
+    if (!result) {
+        return node;
+    }
+
+    fired[rule] += 1;
+    TRACKED_FREE(ALLOC_AST, node);
+
+    return result;
+}
+
+struct ast_node *simplify(struct ast_node *node, bool fast_math, size_t *fired)
+{
+    switch (node->type) {
+    case NODE_NUMBER:
+    case NODE_FMA:
+        return node;
+
+    case NODE_SUM: {
+        for (size_t i = 0; i < node->data.sum.count; i++) {
+            node->data.sum.terms[i] = simplify(node->data.sum.terms[i], fast_math, fired);
+        }
+
+        return node;
+    }
+
+    case NODE_POLY: {
+        node->data.poly.base = simplify(node->data.poly.base, fast_math, fired);
+        return node;
+    }
+
+    case NODE_UNARY: {
+        node->data.unary.child = simplify(node->data.unary.child, fast_math, fired);
+    } break;
+
+    case NODE_BINARY: {
+        node->data.binary.left = simplify(node->data.binary.left, fast_math, fired);
+        node->data.binary.right = simplify(node->data.binary.right, fast_math, fired);
+    } break;
+    }
+
+    // A rewrite can expose another one at the same root, e.g. 0 - -x.
+    struct ast_node *rewritten = simplify_node(node, fast_math, fired);
+
+    while (rewritten != node) {
+        node = rewritten;
+        rewritten = simplify_node(node, fast_math, fired);
+    }
+
+    return node;
+}
+
+double poly_horner(const double *coefficients, size_t degree, double x)
+{
+    double accumulator = coefficients[degree];
+
+    for (size_t i = degree; i-- > 0;) {
+        accumulator = accumulator * x + coefficients[i];
+    }
+
+    return accumulator;
+}
+
+double poly_horner_fma(const double *coefficients, size_t degree, double x)
+{
+    double accumulator = coefficients[degree];
+
+    for (size_t i = degree; i-- > 0;) {
+        accumulator = fma(accumulator, x, coefficients[i]);
+    }
+
+    return accumulator;
+}
+
+double poly_estrin(const double *coefficients, size_t degree, double x)
+{
+    // Pairs of coefficients are combined with x, then pairs of those with x^2, x^4 and so on.
+    // Each level is independent work, so the dependency chain is log2(degree) long instead of
+    // degree long.
+    double values[POW_INT_MAX_EXPONENT + 1];
+    size_t count = degree + 1;
+
+    memcpy(values, coefficients, count * sizeof(*values));
+
+    while (count > 1) {
+        size_t pairs = count / 2;
+
+        for (size_t i = 0; i < pairs; i++) {
+            values[i] = values[2 * i] + values[2 * i + 1] * x;
+        }
+
+        if (count % 2 != 0) {
+            values[pairs] = values[count - 1];
+        }
+
+        count = pairs + count % 2;
+        x *= x;
+    }
+
+    return values[0];
+}
+
+double eval_poly(enum poly_scheme scheme, const double *coefficients, size_t degree, double x)
+{
+    switch (scheme) {
+    case POLY_HORNER_FMA:
+        return poly_horner_fma(coefficients, degree, x);
+    case POLY_ESTRIN:
+        return poly_estrin(coefficients, degree, x);
+    default:
+        return poly_horner(coefficients, degree, x);
+    }
+}
+
+bool ast_equal(const struct ast_node *a, const struct ast_node *b)
+{
+    if (a->type != b->type) {
+        return false;
+    }
+
+    switch (a->type) {
+    case NODE_NUMBER:
+        return a->data.number.value == b->data.number.value &&
+               a->data.number.is_integer == b->data.number.is_integer &&
+               a->data.number.integer == b->data.number.integer;
+    case NODE_UNARY:
+        return a->data.unary.op == b->data.unary.op &&
+               ast_equal(a->data.unary.child, b->data.unary.child);
+    case NODE_BINARY:
+        return a->data.binary.op == b->data.binary.op &&
+               ast_equal(a->data.binary.left, b->data.binary.left) &&
+               ast_equal(a->data.binary.right, b->data.binary.right);
+    default:
+        return false;
+    }
+}
+
+bool get_coefficient(const struct ast_node *node, double *coefficient)
+{
+    if (node->type == NODE_UNARY && node->data.unary.op == MINUS &&
+        node->data.unary.child->type == NODE_NUMBER) {
+        *coefficient = -node->data.unary.child->data.number.value;
+        return true;
+    }
+
+    if (node->type == NODE_NUMBER) {
+        *coefficient = node->data.number.value;
+        return true;
+    }
+
+    return false;
+}
+
+bool get_monomial(const struct ast_node *node, const struct ast_node **base, int64_t *degree)
+{
+    // B^k with a constant k >= 1, or B itself when a base is already known.
+    int64_t exponent = 0;
+
+    if (node->type == NODE_BINARY && node->data.binary.op == CARET &&
+        get_constant_exponent(node->data.binary.right, &exponent) && exponent >= 1 &&
+        (!*base || ast_equal(node->data.binary.left, *base))) {
+        *base = node->data.binary.left;
+        *degree = exponent;
+        return true;
+    }
+
+    if (*base && ast_equal(node, *base)) {
+        *degree = 1;
+        return true;
+    }
+
+    return false;
+}
+
+bool get_poly_term(const struct ast_node *node, const struct ast_node **base, int64_t *degree,
+                   double *coefficient)
+{
+    // A term is c, m, c * m or m * c for a monomial m, possibly negated.
+    if (node->type == NODE_UNARY && node->data.unary.op == MINUS &&
+        get_poly_term(node->data.unary.child, base, degree, coefficient)) {
+        *coefficient = -*coefficient;
+        return true;
+    }
+
+    if (node->type == NODE_BINARY && node->data.binary.op == STAR) {
+        const struct ast_node *left = node->data.binary.left;
+        const struct ast_node *right = node->data.binary.right;
+
+        if (get_coefficient(left, coefficient) && get_monomial(right, base, degree)) {
+            return true;
+        }
+
+        return get_coefficient(right, coefficient) && get_monomial(left, base, degree);
+    }
+
+    if (get_monomial(node, base, degree)) {
+        *coefficient = 1.0;
+        return true;
+    }
+
+    if (get_coefficient(node, coefficient)) {
+        *degree = 0;
+        return true;
+    }
+
+    return false;
+}
+
+struct ast_node *clone_ast_node(const struct ast_node *node)
+{
+    struct ast_node *copy = create_ast_node(node->type, node->data, node->start, node->end);
+
+    switch (node->type) {
+    case NODE_UNARY: {
+        copy->data.unary.child = clone_ast_node(node->data.unary.child);
+    } break;
+    case NODE_BINARY: {
+        copy->data.binary.left = clone_ast_node(node->data.binary.left);
+        copy->data.binary.right = clone_ast_node(node->data.binary.right);
+    } break;
+    default:
+        break;
+    }
+
+    return copy;
+}
+
+struct ast_node *rewrite_polynomials(struct ast_node *node, enum poly_scheme scheme)
+{
+    switch (node->type) {
+    case NODE_UNARY: {
+        node->data.unary.child = rewrite_polynomials(node->data.unary.child, scheme);
+        return node;
+    }
+
+    case NODE_BINARY:
+        break;
+
+    default:
+        return node;
+    }
+
+    if (node->data.binary.op != PLUS && node->data.binary.op != MINUS) {
+        node->data.binary.left = rewrite_polynomials(node->data.binary.left, scheme);
+        node->data.binary.right = rewrite_polynomials(node->data.binary.right, scheme);
+        return node;
+    }
+
+    // The chain is flattened into slots, the addresses of the child pointers, so the terms can be
+    // rewritten in place when the chain turns out not to be a polynomial.
+    size_t slot_capacity = DEFAULT_CAPACITY;
+    size_t slot_count = 0;
+    struct ast_node ***slots = malloc(slot_capacity * sizeof(*slots));
+    bool *negated = malloc(slot_capacity * sizeof(*negated));
+
+    size_t work_capacity = DEFAULT_CAPACITY;
+    size_t work_size = 0;
+    struct ast_node ***work = malloc(work_capacity * sizeof(*work));
+    bool *work_negated = malloc(work_capacity * sizeof(*work_negated));
+
+    if (!slots || !negated || !work || !work_negated) {
+        (void)fprintf(stderr, "Go download more ram\n");
+        exit(EXIT_FAILURE);
+    }
+
+    work[work_size] = &node;
+    work_negated[work_size++] = false;
+
+    while (work_size > 0) {
+        work_size -= 1;
+        struct ast_node **slot = work[work_size];
+        bool negate = work_negated[work_size];
+        struct ast_node *current = *slot;
+
+        if (current->type == NODE_BINARY &&
+            (current->data.binary.op == PLUS || current->data.binary.op == MINUS)) {
+            if (work_size + 2 > work_capacity) {
+                work_capacity *= 2;
+                struct ast_node ***new_work = realloc(work, work_capacity * sizeof(*work));
+                bool *new_negated = realloc(work_negated, work_capacity * sizeof(*work_negated));
+
+                if (!new_work || !new_negated) {
+                    (void)fprintf(stderr, "Go download more ram\n");
+                    exit(EXIT_FAILURE);
+                }
+
+                work = new_work;
+                work_negated = new_negated;
+            }
+
+            work[work_size] = &current->data.binary.right;
+            work_negated[work_size++] = negate != (current->data.binary.op == MINUS);
+            work[work_size] = &current->data.binary.left;
+            work_negated[work_size++] = negate;
+            continue;
+        }
+
+        if (slot_count >= slot_capacity) {
+            slot_capacity *= 2;
+            struct ast_node ***new_slots = realloc(slots, slot_capacity * sizeof(*slots));
+            bool *new_negated = realloc(negated, slot_capacity * sizeof(*negated));
+
+            if (!new_slots || !new_negated) {
+                (void)fprintf(stderr, "Go download more ram\n");
+                exit(EXIT_FAILURE);
+            }
+
+            slots = new_slots;
+            negated = new_negated;
+        }
+
+        slots[slot_count] = slot;
+        negated[slot_count++] = negate;
+    }
+
+    free(work);
+    free(work_negated);
+
+    // The base comes from the first term with an exponent of at least 2, a linear chain gains
+    // nothing from the rewrite.
+    const struct ast_node *base = NULL;
+
+    for (size_t i = 0; i < slot_count && !base; i++) {
+        const struct ast_node *candidate = NULL;
+        int64_t degree = 0;
+        double coefficient = 0.0;
+
+        if (get_poly_term(*slots[i], &candidate, &degree, &coefficient) && degree >= 2) {
+            base = candidate;
+        }
+    }
+
+    double coefficients[POW_INT_MAX_EXPONENT + 1] = { 0 };
+    size_t max_degree = 0;
+    bool is_polynomial = base != NULL;
+
+    for (size_t i = 0; i < slot_count && is_polynomial; i++) {
+        int64_t degree = 0;
+        double coefficient = 0.0;
+
+        is_polynomial = get_poly_term(*slots[i], &base, &degree, &coefficient);
+
+        if (is_polynomial) {
+            coefficients[degree] += negated[i] ? -coefficient : coefficient;
+            max_degree = (size_t)degree > max_degree ? (size_t)degree : max_degree;
+        }
+    }
+
+    if (!is_polynomial) {
+        for (size_t i = 0; i < slot_count; i++) {
+            *slots[i] = rewrite_polynomials(*slots[i], scheme);
+        }
+
+        free(slots);
+        free(negated);
+        return node;
+    }
+
+    free(slots);
+    free(negated);
+
+    double *stored = malloc((max_degree + 1) * sizeof(*stored));
+    if (!stored) {
+        (void)fprintf(stderr, "Go download more ram\n");
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(stored, coefficients, (max_degree + 1) * sizeof(*stored));
+
+    enum poly_scheme chosen = scheme;
+    if (scheme == POLY_AUTO) {
+        chosen = max_degree >= ESTRIN_MIN_DEGREE ? POLY_ESTRIN : POLY_HORNER;
+    }
+
+    struct ast_node *poly = create_ast_node(
+        NODE_POLY,
+        (union node_data){ .poly.base = rewrite_polynomials(clone_ast_node(base), scheme),
+                           .poly.coefficients = stored,
+                           .poly.degree = max_degree,
+                           .poly.scheme = chosen },
+        node->start, node->end);
+
+    free_ast_node(node);
+
+    return poly;
+}
+
+bool int_power(int64_t base, int64_t exponent, int64_t *result)
+{
+    if (exponent < 0) {
+        return false;
+    }
+
+    int64_t accumulator = 1;
+
+    while (exponent > 0) {
+        if ((exponent & 1) && __builtin_mul_overflow(accumulator, base, &accumulator)) {
+            return false;
+        }
+
+        exponent >>= 1;
+
+        if (exponent > 0 && __builtin_mul_overflow(base, base, &base)) {
+            return false;
+        }
+    }
+
+    *result = accumulator;
+
+    return true;
+}
+
+double pow_int(double base, int64_t exponent)
+{
+    // Repeated squaring takes at most 2 * log2(POW_INT_MAX_EXPONENT) multiplications. While the
+    // products stay normal each one rounds by half an ulp, so the result is within
+    // (|exponent| + 1) ulp of pow() rather than correctly rounded, in exchange for skipping libm's
+    // exp/log evaluation. Once the power or its reciprocal overflows, underflows or goes
+    // subnormal that bound no longer holds and pow() computes it instead.
+    uint64_t remaining = exponent < 0 ? -(uint64_t)exponent : (uint64_t)exponent;
+    double original = base;
+    double accumulator = 1.0;
+
+    while (remaining > 0) {
+        if (remaining & 1) {
+            accumulator *= base;
+        }
+
+        remaining >>= 1;
+
+        if (remaining > 0) {
+            base *= base;
+        }
+    }
+
+    double result = exponent < 0 ? 1.0 / accumulator : accumulator;
+
+    if (!isnormal(accumulator) || !isnormal(result)) {
+        return pow(original, (double)exponent);
+    }
+
+    return result;
+}
+
+bool get_constant_exponent(const struct ast_node *node, int64_t *exponent)
+{
+    if (!node || node->type != NODE_NUMBER) {
+        return false;
+    }
+
+    double value = node->data.number.value;
+
+    if (value != trunc(value) || fabs(value) > POW_INT_MAX_EXPONENT) {
+        return false;
+    }
+
+    *exponent = (int64_t)value;
+
+    return true;
+}
+
+bool int_binary_op(enum token_kind op, int64_t lhs, int64_t rhs, int64_t *result)
+{
+    switch (op) {
+    case PLUS:
+        return !__builtin_add_overflow(lhs, rhs, result);
+    case MINUS:
+        return !__builtin_sub_overflow(lhs, rhs, result);
+    case STAR:
+        return !__builtin_mul_overflow(lhs, rhs, result);
+    case PERCENT: {
+        if (rhs == 0) {
+            return false;
+        }
+
+        *result = rhs == -1 ? 0 : lhs % rhs;
+        return true;
+    }
+    case CARET:
+        return int_power(lhs, rhs, result);
+    default:
+        return false;
+    }
+}
+
+enum value_type infer_types(struct ast_node *node, int64_t *value)
+{
+    // Every leaf is a literal, so the int64 value of an integer subtree is known here. An operation
+    // that would overflow, divide or raise to a negative power makes its node a double instead, which
+    // is the only place promotion happens; the int opcodes never see an overflowing input.
+    int64_t lhs = 0;
+    int64_t rhs = 0;
+
+    switch (node->type) {
+    case NODE_NUMBER: {
+        node->value_type = node->data.number.is_integer ? VALUE_INT : VALUE_DOUBLE;
+        *value = node->data.number.integer;
+    } break;
+
+    case NODE_UNARY: {
+        enum value_type child = infer_types(node->data.unary.child, &lhs);
+
+        node->value_type = VALUE_DOUBLE;
+        if (child == VALUE_INT && node->data.unary.op == PLUS) {
+            node->value_type = VALUE_INT;
+            *value = lhs;
+        } else if (child == VALUE_INT && node->data.unary.op == MINUS &&
+                   !__builtin_sub_overflow((int64_t)0, lhs, value)) {
+            node->value_type = VALUE_INT;
+        }
+    } break;
+
+    case NODE_BINARY: {
+        enum value_type left = infer_types(node->data.binary.left, &lhs);
+        enum value_type right = infer_types(node->data.binary.right, &rhs);
+
+        node->value_type = left == VALUE_INT && right == VALUE_INT &&
+                                   int_binary_op(node->data.binary.op, lhs, rhs, value)
+                               ? VALUE_INT
+                               : VALUE_DOUBLE;
+    } break;
+
+    case NODE_SUM: {
+        for (size_t i = 0; i < node->data.sum.count; i++) {
+            infer_types(node->data.sum.terms[i], &lhs);
+        }
+
+        node->value_type = VALUE_DOUBLE;
+    } break;
+
+    case NODE_FMA: {
+        infer_types(node->data.fma.multiplicand, &lhs);
+        infer_types(node->data.fma.multiplier, &lhs);
+        infer_types(node->data.fma.addend, &lhs);
+
+        node->value_type = VALUE_DOUBLE;
+    } break;
+
+    case NODE_POLY: {
+        infer_types(node->data.poly.base, &lhs);
+
+        node->value_type = VALUE_DOUBLE;
+    } break;
+    }
+
+    return node->value_type;
+}
+
+int64_t eval_ast_int(const struct ast_node *root)
+{
+    switch (root->type) {
+    case NODE_NUMBER:
+        return root->data.number.integer;
+
+    case NODE_UNARY: {
+        int64_t value = eval_ast_int(root->data.unary.child);
+        return root->data.unary.op == MINUS ? -value : value;
+    }
+
+    case NODE_BINARY: {
+        int64_t result = 0;
+
+        if (!int_binary_op(root->data.binary.op, eval_ast_int(root->data.binary.left),
+                           eval_ast_int(root->data.binary.right), &result)) {
+            (void)fprintf(stderr, "Integer overflow\n");
+            exit(EXIT_FAILURE);
+        }
+
+        return result;
+    }
+
+    default: {
+        (void)fprintf(stderr, "Node is not an integer expression\n");
+        exit(EXIT_FAILURE);
+    }
+    }
+}
+
+double eval_ast(const struct ast_node *root)
+{
+    if (root->value_type == VALUE_INT) {
+        return (double)eval_ast_int(root);
+    }
+
+    switch (root->type) {
+    case NODE_NUMBER: {
+        return root->data.number.value;
+    }
+
+    case NODE_UNARY: {
+        switch (root->data.unary.op) {
+        case MINUS:
+            return -eval_ast(root->data.unary.child);
+        case PLUS:
+            return eval_ast(root->data.unary.child);
+        case SQRT:
+            return sqrt(eval_ast(root->data.unary.child));
+        default: {
+            (void)fprintf(stderr, "Unknown unary operator\n");
+            exit(EXIT_FAILURE);
+        }
+        }
+    }
+
+    case NODE_BINARY: {
+        int64_t exponent = 0;
+        if (root->data.binary.op == CARET &&
+            get_constant_exponent(root->data.binary.right, &exponent)) {
+            return pow_int(eval_ast(root->data.binary.left), exponent);
+        }
+
+        double lhs = eval_ast(root->data.binary.left);
+        double rhs = eval_ast(root->data.binary.right);
+
+        switch (root->data.binary.op) {
+        case PLUS:
+            return lhs + rhs;
+        case MINUS:
+            return lhs - rhs;
+        case SLASH: {
+            if (rhs == 0.0) {
+                (void)fprintf(stderr, "Division by zero\n");
+                exit(EXIT_FAILURE);
+            }
+
+            return lhs / rhs;
+        }
+        case STAR:
+            return lhs * rhs;
+        case CARET:
+            return pow(lhs, rhs);
+        case PERCENT: {
+            if (rhs == 0.0) {
+                (void)fprintf(stderr, "Division by zero\n");
+                exit(EXIT_FAILURE);
+            }
+
+            return fmod(lhs, rhs);
+        }
+        default: {
+            (void)fprintf(stderr, "Unknown binary operator\n");
+            exit(EXIT_FAILURE);
+        }
+        }
+    }
+
+    case NODE_SUM: {
+        double values[SUM_BLOCK_SIZE];
+
+        for (size_t i = 0; i < root->data.sum.count; i++) {
+            values[i] = eval_ast(root->data.sum.terms[i]);
+        }
+
+        return sum_values(values, root->data.sum.count, root->data.sum.mode);
+    }
+
+    case NODE_FMA: {
+        double multiplicand = eval_ast(root->data.fma.multiplicand);
+        double multiplier = eval_ast(root->data.fma.multiplier);
+        double addend = eval_ast(root->data.fma.addend);
+
+        return fma(multiplicand, multiplier, root->data.fma.subtract ? -addend : addend);
+    }
+
+    case NODE_POLY: {
+        return eval_poly(root->data.poly.scheme, root->data.poly.coefficients,
+                         root->data.poly.degree, eval_ast(root->data.poly.base));
+    }
+    }
+}
+
+void bigint_init(struct bigint *value)
+{
+    *value = (struct bigint){ .limbs = NULL, .size = 0, .capacity = 0, .negative = false };
+}
+
+void bigint_free(struct bigint *value)
+{
+    free(value->limbs);
+    bigint_init(value);
+}
+
+void bigint_reserve(struct bigint *value, size_t capacity)
+{
+    if (capacity <= value->capacity) {
+        return;
+    }
+
+    uint32_t *limbs = realloc(value->limbs, capacity * sizeof(*limbs));
+    if (!limbs) {
+        (void)fprintf(stderr, "Go download more ram\n");
+        exit(EXIT_FAILURE);
+    }
+
+    value->limbs = limbs;
+    value->capacity = capacity;
+}
+
+void bigint_normalize(struct bigint *value)
+{
+    while (value->size > 0 && value->limbs[value->size - 1] == 0) {
+        value->size -= 1;
+    }
+
+    if (value->size == 0) {
+        value->negative = false;
+    }
+}
+
+void bigint_swap(struct bigint *a, struct bigint *b)
+{
+    struct bigint tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
+
+void bigint_copy(struct bigint *dest, const struct bigint *src)
+{
+    if (dest == src) {
+        return;
+    }
+
+    bigint_reserve(dest, src->size);
+    if (src->size > 0) {
+        memcpy(dest->limbs, src->limbs, src->size * sizeof(*src->limbs));
+    }
+
+    dest->size = src->size;
+    dest->negative = src->negative;
+}
+
+void bigint_set_limbs(struct bigint *dest, const uint32_t *limbs, size_t size)
+{
+    bigint_reserve(dest, size);
+    if (size > 0) {
+        memcpy(dest->limbs, limbs, size * sizeof(*limbs));
+    }
+
+    dest->size = size;
+    dest->negative = false;
+    bigint_normalize(dest);
+}
+
+void bigint_from_uint(struct bigint *value, uint64_t number)
+{
+    bigint_reserve(value, 3);
+    value->size = 0;
+    value->negative = false;
+
+    while (number > 0) {
+        value->limbs[value->size++] = (uint32_t)(number % BIGINT_BASE);
+        number /= BIGINT_BASE;
+    }
+}
+
+bool bigint_to_uint(const struct bigint *value, uint64_t *number)
+{
+    if (value->negative) {
+        return false;
+    }
+
+    uint64_t result = 0;
+
+    for (size_t i = value->size; i-- > 0;) {
+        if (__builtin_mul_overflow(result, (uint64_t)BIGINT_BASE, &result) ||
+            __builtin_add_overflow(result, (uint64_t)value->limbs[i], &result)) {
+            return false;
+        }
+    }
+
+    *number = result;
+
+    return true;
+}
+
+int mag_compare(const uint32_t *a, size_t an, const uint32_t *b, size_t bn)
+{
+    while (an > 0 && a[an - 1] == 0) {
+        an -= 1;
+    }
+
+    while (bn > 0 && b[bn - 1] == 0) {
+        bn -= 1;
+    }
+
+    if (an != bn) {
+        return an < bn ? -1 : 1;
+    }
+
+    for (size_t i = an; i-- > 0;) {
+        if (a[i] != b[i]) {
+            return a[i] < b[i] ? -1 : 1;
+        }
+    }
+
+    return 0;
+}
+
+size_t mag_add(uint32_t *result, const uint32_t *a, size_t an, const uint32_t *b, size_t bn)
+{
+    if (an < bn) {
+        const uint32_t *tmp_limbs = a;
+        a = b;
+        b = tmp_limbs;
+
+        size_t tmp_size = an;
+        an = bn;
+        bn = tmp_size;
+    }
+
+    uint32_t carry = 0;
+    size_t i = 0;
+
+    for (; i < bn; i++) {
+        uint32_t sum = a[i] + b[i] + carry;
+        carry = sum >= BIGINT_BASE;
+        result[i] = carry ? sum - BIGINT_BASE : sum;
+    }
+
+    for (; i < an; i++) {
+        uint32_t sum = a[i] + carry;
+        carry = sum >= BIGINT_BASE;
+        result[i] = carry ? sum - BIGINT_BASE : sum;
+    }
+
+    result[an] = carry;
+
+    return an + 1;
+}
+
+void mag_sub(uint32_t *result, const uint32_t *a, size_t an, const uint32_t *b, size_t bn)
+{
+    while (bn > an && b[bn - 1] == 0) {
+        bn -= 1;
+    }
+
+    assert(bn <= an);
+
+    int64_t borrow = 0;
+
+    for (size_t i = 0; i < an; i++) {
+        int64_t diff = (int64_t)a[i] - (i < bn ? (int64_t)b[i] : 0) - borrow;
+        borrow = diff < 0;
+        result[i] = (uint32_t)(borrow ? diff + BIGINT_BASE : diff);
+    }
+
+    assert(borrow == 0);
+}
+
+void mag_add_at(uint32_t *result, size_t size, const uint32_t *a, size_t an, size_t offset)
+{
+    while (an > 0 && a[an - 1] == 0) {
+        an -= 1;
+    }
+
+    uint32_t carry = 0;
+    size_t i = 0;
+
+    for (; i < an; i++) {
+        uint32_t sum = result[offset + i] + a[i] + carry;
+        carry = sum >= BIGINT_BASE;
+        result[offset + i] = carry ? sum - BIGINT_BASE : sum;
+    }
+
+    for (; carry && offset + i < size; i++) {
+        uint32_t sum = result[offset + i] + carry;
+        carry = sum >= BIGINT_BASE;
+        result[offset + i] = carry ? sum - BIGINT_BASE : sum;
+    }
+}
+
+uint32_t mag_mul_small(uint32_t *result, const uint32_t *a, size_t an, uint32_t factor)
+{
+    uint64_t carry = 0;
+
+    for (size_t i = 0; i < an; i++) {
+        uint64_t product = (uint64_t)a[i] * factor + carry;
+        result[i] = (uint32_t)(product % BIGINT_BASE);
+        carry = product / BIGINT_BASE;
+    }
+
+    return (uint32_t)carry;
+}
+
+uint32_t mag_div_small(uint32_t *result, const uint32_t *a, size_t an, uint32_t divisor)
+{
+    uint64_t remainder = 0;
+
+    for (size_t i = an; i-- > 0;) {
+        uint64_t current = remainder * BIGINT_BASE + a[i];
+        result[i] = (uint32_t)(current / divisor);
+        remainder = current % divisor;
+    }
+
+    return (uint32_t)remainder;
+}
+
+void mag_mul_schoolbook(uint32_t *result, const uint32_t *a, size_t an, const uint32_t *b,
+                        size_t bn)
+{
+    memset(result, 0, (an + bn) * sizeof(*result));
+
+    for (size_t i = 0; i < an; i++) {
+        uint64_t digit = a[i];
+        uint64_t carry = 0;
+
+        if (digit == 0) {
+            continue;
+        }
+
+        for (size_t j = 0; j < bn; j++) {
+            uint64_t current = result[i + j] + digit * b[j] + carry;
+            result[i + j] = (uint32_t)(current % BIGINT_BASE);
+            carry = current / BIGINT_BASE;
+        }
+
+        result[i + bn] = (uint32_t)carry;
+    }
+}
+
+void mag_mul_karatsuba(uint32_t *result, const uint32_t *a, size_t an, const uint32_t *b,
+                       size_t bn, enum bigint_mul_algorithm algorithm)
+{
+    // a = a1 * B^half + a0 and b = b1 * B^half + b0, with an >= bn > half so both splits are
+    // non-empty. z0 and z2 land directly in the result, the middle term is added on top.
+    size_t half = an / 2;
+    size_t a1n = an - half;
+    size_t b1n = bn - half;
+
+    mag_mul(result, a, half, b, half, algorithm);
+    mag_mul(result + 2 * half, a + half, a1n, b + half, b1n, algorithm);
+
+    size_t sum_an = a1n + 1;
+    size_t sum_bn = (b1n > half ? b1n : half) + 1;
+    size_t middle_size = sum_an + sum_bn;
+
+    uint32_t *scratch = malloc((sum_an + sum_bn + middle_size) * sizeof(*scratch));
+    if (!scratch) {
+        (void)fprintf(stderr, "Go download more ram\n");
+        exit(EXIT_FAILURE);
+    }
+
+    uint32_t *sum_a = scratch;
+    uint32_t *sum_b = sum_a + sum_an;
+    uint32_t *middle = sum_b + sum_bn;
+
+    mag_add(sum_a, a, half, a + half, a1n);
+    mag_add(sum_b, b, half, b + half, b1n);
+    mag_mul(middle, sum_a, sum_an, sum_b, sum_bn, algorithm);
+
+    mag_sub(middle, middle, middle_size, result, 2 * half);
+    mag_sub(middle, middle, middle_size, result + 2 * half, a1n + b1n);
+    mag_add_at(result, an + bn, middle, middle_size, half);
+
+    free(scratch);
+}
+
+void bigint_slice(struct bigint *dest, const uint32_t *limbs, size_t size, size_t from, size_t to)
+{
+    from = from < size ? from : size;
+    to = to < size ? to : size;
+
+    bigint_set_limbs(dest, limbs + from, to - from);
+}
+
+void mag_mul_toom3(uint32_t *result, const uint32_t *a, size_t an, const uint32_t *b, size_t bn,
+                   enum bigint_mul_algorithm algorithm)
+{
+    // Toom-Cook 3-way: split into thirds, evaluate at 0, 1, -1, -2 and infinity, multiply the five
+    // point values recursively and interpolate with Bodrato's sequence. Intermediate values can be
+    // negative, so this works on signed bigints rather than raw limbs.
+    size_t third = (an + 2) / 3;
+    struct bigint parts[6];
+    struct bigint points[10];
+    struct bigint products[5];
+
+    for (size_t i = 0; i < 6; i++) {
+        bigint_init(&parts[i]);
+    }
+    for (size_t i = 0; i < 10; i++) {
+        bigint_init(&points[i]);
+    }
+    for (size_t i = 0; i < 5; i++) {
+        bigint_init(&products[i]);
+    }
+
+    for (size_t i = 0; i < 3; i++) {
+        bigint_slice(&parts[i], a, an, i * third, (i + 1) * third);
+        bigint_slice(&parts[3 + i], b, bn, i * third, (i + 1) * third);
+    }
+
+    for (size_t side = 0; side < 2; side++) {
+        struct bigint *p0 = &parts[side * 3];
+        struct bigint *p1 = &parts[side * 3 + 1];
+        struct bigint *p2 = &parts[side * 3 + 2];
+        struct bigint *at_one = &points[side * 5];
+        struct bigint *at_minus_one = &points[side * 5 + 1];
+        struct bigint *at_minus_two = &points[side * 5 + 2];
+
+        bigint_add(at_one, p0, p2);
+        bigint_sub(at_minus_one, at_one, p1);
+        bigint_add(at_one, at_one, p1);
+        bigint_add(at_minus_two, at_minus_one, p2);
+        bigint_mul_small(at_minus_two, at_minus_two, 2);
+        bigint_sub(at_minus_two, at_minus_two, p0);
+    }
+
+    struct bigint *r0 = &products[0];
+    struct bigint *r1 = &products[1];
+    struct bigint *r2 = &products[2];
+    struct bigint *r3 = &products[3];
+    struct bigint *r_inf = &products[4];
+
+    bigint_mul_with(r0, &parts[0], &parts[3], algorithm);
+    bigint_mul_with(r1, &points[0], &points[5], algorithm);
+    bigint_mul_with(r2, &points[1], &points[6], algorithm);
+    bigint_mul_with(r3, &points[2], &points[7], algorithm);
+    bigint_mul_with(r_inf, &parts[2], &parts[5], algorithm);
+
+    // r2 holds r(-1) and r3 holds r(-2) here.
+    struct bigint *tmp = &points[3];
+    bigint_sub(r3, r3, r1);
+    bigint_div_small(r3, r3, 3);
+    bigint_sub(r1, r1, r2);
+    bigint_div_small(r1, r1, 2);
+    bigint_sub(r2, r2, r0);
+    bigint_sub(r3, r2, r3);
+    bigint_div_small(r3, r3, 2);
+    bigint_mul_small(tmp, r_inf, 2);
+    bigint_add(r3, r3, tmp);
+    bigint_add(r2, r2, r1);
+    bigint_sub(r2, r2, r_inf);
+    bigint_sub(r1, r1, r3);
+
+    memset(result, 0, (an + bn) * sizeof(*result));
+
+    for (size_t i = 0; i < 5; i++) {
+        assert(!products[i].negative);
+        mag_add_at(result, an + bn, products[i].limbs, products[i].size, i * third);
+    }
+
+    for (size_t i = 0; i < 6; i++) {
+        bigint_free(&parts[i]);
+    }
+    for (size_t i = 0; i < 10; i++) {
+        bigint_free(&points[i]);
+    }
+    for (size_t i = 0; i < 5; i++) {
+        bigint_free(&products[i]);
+    }
+}
+
+void mag_mul(uint32_t *result, const uint32_t *a, size_t an, const uint32_t *b, size_t bn,
+             enum bigint_mul_algorithm algorithm)
+{
+    if (an < bn) {
+        const uint32_t *tmp_limbs = a;
+        a = b;
+        b = tmp_limbs;
+
+        size_t tmp_size = an;
+        an = bn;
+        bn = tmp_size;
+    }
+
+    if (algorithm == MUL_SCHOOLBOOK || bn < KARATSUBA_THRESHOLD) {
+        mag_mul_schoolbook(result, a, an, b, bn);
+        return;
+    }
+
+    // Very unbalanced operands are cut into bn sized pieces so the balanced algorithms below
+    // always see a > b > a / 2.
+    if (an >= 2 * bn) {
+        uint32_t *product = malloc(2 * bn * sizeof(*product));
+        if (!product) {
+            (void)fprintf(stderr, "Go download more ram\n");
+            exit(EXIT_FAILURE);
+        }
+
+        memset(result, 0, (an + bn) * sizeof(*result));
+
+        for (size_t offset = 0; offset < an; offset += bn) {
+            size_t length = an - offset < bn ? an - offset : bn;
+
+            mag_mul(product, a + offset, length, b, bn, algorithm);
+            mag_add_at(result, an + bn, product, length + bn, offset);
+        }
+
+        free(product);
+        return;
+    }
+
+    if (algorithm == MUL_TOOM3 && bn >= TOOM3_THRESHOLD) {
+        mag_mul_toom3(result, a, an, b, bn, algorithm);
+        return;
+    }
+
+    mag_mul_karatsuba(result, a, an, b, bn, algorithm);
+}
+
+void bigint_add(struct bigint *result, const struct bigint *a, const struct bigint *b)
+{
+    struct bigint sum;
+    bigint_init(&sum);
+
+    size_t larger = a->size > b->size ? a->size : b->size;
+    bigint_reserve(&sum, larger + 1);
+
+    if (a->negative == b->negative) {
+        sum.size = mag_add(sum.limbs, a->limbs, a->size, b->limbs, b->size);
+        sum.negative = a->negative;
+    } else if (mag_compare(a->limbs, a->size, b->limbs, b->size) >= 0) {
+        mag_sub(sum.limbs, a->limbs, a->size, b->limbs, b->size);
+        sum.size = a->size;
+        sum.negative = a->negative;
+    } else {
+        mag_sub(sum.limbs, b->limbs, b->size, a->limbs, a->size);
+        sum.size = b->size;
+        sum.negative = b->negative;
+    }
+
+    bigint_normalize(&sum);
+    bigint_swap(result, &sum);
+    bigint_free(&sum);
+}
+
+void bigint_sub(struct bigint *result, const struct bigint *a, const struct bigint *b)
+{
+    struct bigint negated = *b;
+    negated.negative = b->size > 0 && !b->negative;
+
+    bigint_add(result, a, &negated);
+}
+
+void bigint_negate(struct bigint *value)
+{
+    value->negative = value->size > 0 && !value->negative;
+}
+
+void bigint_mul_with(struct bigint *result, const struct bigint *a, const struct bigint *b,
+                     enum bigint_mul_algorithm algorithm)
+{
+    struct bigint product;
+    bigint_init(&product);
+
+    if (a->size > 0 && b->size > 0) {
+        bigint_reserve(&product, a->size + b->size);
+        mag_mul(product.limbs, a->limbs, a->size, b->limbs, b->size, algorithm);
+        product.size = a->size + b->size;
+        product.negative = a->negative != b->negative;
+        bigint_normalize(&product);
+    }
+
+    bigint_swap(result, &product);
+    bigint_free(&product);
+}
+
+void bigint_mul(struct bigint *result, const struct bigint *a, const struct bigint *b)
+{
+    bigint_mul_with(result, a, b, MUL_TOOM3);
+}
+
+void bigint_mul_small(struct bigint *result, const struct bigint *a, uint32_t factor)
+{
+    bigint_reserve(result, a->size + 1);
+
+    uint32_t carry = mag_mul_small(result->limbs, a->limbs, a->size, factor);
+    result->limbs[a->size] = carry;
+    result->size = a->size + 1;
+    result->negative = a->negative;
+
+    bigint_normalize(result);
+}
+
+uint32_t bigint_div_small(struct bigint *result, const struct bigint *a, uint32_t divisor)
+{
+    bigint_reserve(result, a->size);
+
+    uint32_t remainder = mag_div_small(result->limbs, a->limbs, a->size, divisor);
+    result->size = a->size;
+    result->negative = a->negative;
+
+    bigint_normalize(result);
+
+    return remainder;
+}
+
+void bigint_divmod(struct bigint *quotient, struct bigint *remainder, const struct bigint *a,
+                   const struct bigint *b)
+{
+    // Truncating division, like C and fmod: the remainder takes the sign of the dividend.
+    struct bigint q;
+    struct bigint r;
+    bigint_init(&q);
+    bigint_init(&r);
+
+    if (mag_compare(a->limbs, a->size, b->limbs, b->size) < 0) {
+        bigint_copy(&r, a);
+    } else if (b->size == 1) {
+        uint32_t small = bigint_div_small(&q, a, b->limbs[0]);
+        bigint_from_uint(&r, small);
+    } else {
+        // Knuth's algorithm D. Scaling by d puts the top divisor limb in the upper half of the
+        // base, which keeps each estimated quotient limb at most two too large.
+        size_t n = b->size;
+        size_t m = a->size - n;
+        uint32_t d = BIGINT_BASE / (b->limbs[n - 1] + 1);
+
+        uint32_t *u = malloc((a->size + 1) * sizeof(*u));
+        uint32_t *v = malloc(n * sizeof(*v));
+        if (!u || !v) {
+            (void)fprintf(stderr, "Go download more ram\n");
+            exit(EXIT_FAILURE);
+        }
+
+        u[a->size] = mag_mul_small(u, a->limbs, a->size, d);
+        mag_mul_small(v, b->limbs, n, d);
+
+        bigint_reserve(&q, m + 1);
+        q.size = m + 1;
+
+        for (size_t j = m + 1; j-- > 0;) {
+            uint64_t numerator = (uint64_t)u[j + n] * BIGINT_BASE + u[j + n - 1];
+            uint64_t qhat = numerator / v[n - 1];
+            uint64_t rhat = numerator % v[n - 1];
+
+            while (qhat >= BIGINT_BASE ||
+                   qhat * v[n - 2] > rhat * BIGINT_BASE + u[j + n - 2]) {
+                qhat -= 1;
+                rhat += v[n - 1];
+
+                if (rhat >= BIGINT_BASE) {
+                    break;
+                }
+            }
+
+            int64_t borrow = 0;
+            uint64_t carry = 0;
+
+            for (size_t i = 0; i < n; i++) {
+                uint64_t product = qhat * v[i] + carry;
+                carry = product / BIGINT_BASE;
+
+                int64_t diff = (int64_t)u[i + j] - (int64_t)(product % BIGINT_BASE) - borrow;
+                borrow = diff < 0;
+                u[i + j] = (uint32_t)(borrow ? diff + BIGINT_BASE : diff);
+            }
+
+            int64_t top = (int64_t)u[j + n] - (int64_t)carry - borrow;
+
+            if (top < 0) {
+                qhat -= 1;
+
+                uint32_t add_carry = 0;
+                for (size_t i = 0; i < n; i++) {
+                    uint32_t sum = u[i + j] + v[i] + add_carry;
+                    add_carry = sum >= BIGINT_BASE;
+                    u[i + j] = add_carry ? sum - BIGINT_BASE : sum;
+                }
+
+                top += add_carry;
+            }
+
+            u[j + n] = (uint32_t)top;
+            q.limbs[j] = (uint32_t)qhat;
+        }
+
+        bigint_set_limbs(&r, u, n);
+        bigint_div_small(&r, &r, d);
+
+        free(u);
+        free(v);
+    }
+
+    q.negative = q.size > 0 && a->negative != b->negative;
+    r.negative = r.size > 0 && a->negative;
+    bigint_normalize(&q);
+    bigint_normalize(&r);
+
+    if (quotient) {
+        bigint_swap(quotient, &q);
+    }
+
+    if (remainder) {
+        bigint_swap(remainder, &r);
+    }
+
+    bigint_free(&q);
+    bigint_free(&r);
+}
+
+void bigint_pow(struct bigint *result, const struct bigint *base, uint64_t exponent)
+{
+    struct bigint accumulator;
+    struct bigint square;
+    bigint_init(&accumulator);
+    bigint_init(&square);
+
+    bigint_from_uint(&accumulator, 1);
+    bigint_copy(&square, base);
+
+    while (exponent > 0) {
+        if (exponent & 1) {
+            bigint_mul(&accumulator, &accumulator, &square);
+        }
+
+        exponent >>= 1;
+
+        if (exponent > 0) {
+            bigint_mul(&square, &square, &square);
+        }
+    }
+
+    bigint_swap(result, &accumulator);
+    bigint_free(&accumulator);
+    bigint_free(&square);
+}
+
+void bigint_from_digits(struct bigint *value, const char *digits, size_t count)
+{
+    bigint_reserve(value, count / BIGINT_BASE_DIGITS + 1);
+    value->size = 0;
+    value->negative = false;
+
+    // Limbs are filled from the least significant end, nine decimal digits at a time.
+    for (size_t end = count; end > 0;) {
+        size_t start = end > BIGINT_BASE_DIGITS ? end - BIGINT_BASE_DIGITS : 0;
+        uint32_t limb = 0;
+
+        for (size_t i = start; i < end; i++) {
+            limb = limb * 10 + (uint32_t)(digits[i] - '0');
+        }
+
+        value->limbs[value->size++] = limb;
+        end = start;
+    }
+
+    bigint_normalize(value);
+}
+
+void bigint_scale_pow10(struct bigint *value, uint64_t exponent)
+{
+    static const uint32_t powers[] = { 1,      10,      100,      1000,      10000,
+                                       100000, 1000000, 10000000, 100000000 };
+
+    for (; exponent >= BIGINT_BASE_DIGITS; exponent -= BIGINT_BASE_DIGITS) {
+        bigint_mul_small(value, value, 100000000);
+        bigint_mul_small(value, value, 10);
+    }
+
+    bigint_mul_small(value, value, powers[exponent]);
+}
+
+bool parse_decimal_literal(const char *text, size_t length, struct bigint *mantissa,
+                           int64_t *exponent)
+{
+    // Splits a literal such as -12.50e3 into the integer mantissa -1250 and the decimal
+    // exponent 1, so exact modes never go through a rounded double.
+    size_t cursor = 0;
+    bool negative = false;
+
+    if (cursor < length && (text[cursor] == '-' || text[cursor] == '+')) {
+        negative = text[cursor] == '-';
+        cursor += 1;
+    }
+
+    char *digits = malloc(length + 1);
+    if (!digits) {
+        (void)fprintf(stderr, "Go download more ram\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t digit_count = 0;
+    int64_t scale = 0;
+    bool seen_point = false;
+
+    for (; cursor < length; cursor++) {
+        char character = text[cursor];
+
+        if (isdigit(character)) {
+            digits[digit_count++] = character;
+            scale -= seen_point ? 1 : 0;
+        } else if (character == '.' && !seen_point) {
+            seen_point = true;
+        } else {
+            break;
+        }
+    }
+
+    if (cursor < length && (text[cursor] == 'e' || text[cursor] == 'E')) {
+        errno = 0;
+        char *end = NULL;
+        long long value = strtoll(text + cursor + 1, &end, 10);
+
+        // The fraction digits already moved scale down, so a huge exponent can still overflow it.
+        if (errno == ERANGE || end != text + length || end == text + cursor + 1 ||
+            (value > 0 && scale > INT64_MAX - value) || (value < 0 && scale < INT64_MIN - value)) {
+            free(digits);
+            return false;
+        }
+
+        scale += value;
+        cursor = length;
+    }
+
+    if (cursor != length || digit_count == 0) {
+        free(digits);
+        return false;
+    }
+
+    bigint_from_digits(mantissa, digits, digit_count);
+    mantissa->negative = negative && mantissa->size > 0;
+    *exponent = scale;
+
+    free(digits);
+
+    return true;
+}
+
+void check_exact_exponent(const char *text, size_t length, int64_t exponent)
+{
+    // Every step of the decimal exponent is a bigint multiply or divide by ten, so 1e999999999
+    // would run out of time or memory long before it ran out of digits.
+    if (exponent > EXACT_MAX_EXPONENT || exponent < -EXACT_MAX_EXPONENT) {
+        (void)fprintf(stderr, "Exponent of %.*s is out of range in exact modes\n", (int)length, text);
+        exit(EXIT_FAILURE);
+    }
+}
+
+void bigint_from_literal(struct bigint *value, const char *text, size_t length)
+{
+    int64_t exponent = 0;
+
+    if (!parse_decimal_literal(text, length, value, &exponent)) {
+        (void)fprintf(stderr, "Invalid number: %.*s\n", (int)length, text);
+        exit(EXIT_FAILURE);
+    }
+
+    check_exact_exponent(text, length, exponent);
+
+    if (exponent >= 0) {
+        bigint_scale_pow10(value, (uint64_t)exponent);
+        return;
+    }
+
+    // Trailing fractional zeros as in 3.000 are still integers.
+    for (; exponent < 0; exponent++) {
+        struct bigint quotient;
+        bigint_init(&quotient);
+
+        if (bigint_div_small(&quotient, value, 10) != 0) {
+            (void)fprintf(stderr, "Literal %.*s is not an integer\n", (int)length, text);
+            exit(EXIT_FAILURE);
+        }
+
+        bigint_swap(value, &quotient);
+        bigint_free(&quotient);
+    }
+}
+
+char *bigint_to_string(const struct bigint *value)
+{
+    size_t length = value->size * BIGINT_BASE_DIGITS + 3;
+    char *text = malloc(length);
+    if (!text) {
+        (void)fprintf(stderr, "Go download more ram\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (value->size == 0) {
+        strcpy(text, "0");
+        return text;
+    }
+
+    char *cursor = text;
+    if (value->negative) {
+        *cursor++ = '-';
+    }
+
+    cursor += sprintf(cursor, "%" PRIu32, value->limbs[value->size - 1]);
+
+    for (size_t i = value->size - 1; i-- > 0;) {
+        cursor += sprintf(cursor, "%09" PRIu32, value->limbs[i]);
+    }
+
+    return text;
+}
+
+void bigint_binary_op(enum opcode code, struct bigint *result, const struct bigint *lhs,
+                      const struct bigint *rhs)
+{
+    switch (code) {
+    case OP_ADD: {
+        bigint_add(result, lhs, rhs);
+    } break;
+    case OP_SUBTRACT: {
+        bigint_sub(result, lhs, rhs);
+    } break;
+    case OP_MULTIPLY: {
+        bigint_mul(result, lhs, rhs);
+    } break;
+    case OP_DIVIDE:
+    case OP_MODULO: {
+        if (rhs->size == 0) {
+            (void)fprintf(stderr, "Division by zero\n");
+            exit(EXIT_FAILURE);
+        }
+
+        if (code == OP_DIVIDE) {
+            bigint_divmod(result, NULL, lhs, rhs);
+        } else {
+            bigint_divmod(NULL, result, lhs, rhs);
+        }
+    } break;
+    case OP_POWER: {
+        uint64_t exponent = 0;
+
+        if (!bigint_to_uint(rhs, &exponent)) {
+            (void)fprintf(stderr, "Exponent must be a non-negative 64-bit integer in bigint mode\n");
+            exit(EXIT_FAILURE);
+        }
+
+        bigint_pow(result, lhs, exponent);
+    } break;
+    default: {
+        (void)fprintf(stderr, "Unsupported instruction in bigint mode\n");
+        exit(EXIT_FAILURE);
+    }
+    }
+}
+
+void bigint_push(struct bigint_vm *bigint_vm, struct bigint *value)
+{
+    if (bigint_vm->top >= MAX_STACK_SIZE) {
+        (void)fprintf(stderr, "Stack overflow\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // The slot takes ownership of the limbs, value is left empty.
+    bigint_vm->stack[bigint_vm->top++] = *value;
+    bigint_init(value);
+}
+
+struct bigint bigint_pop(struct bigint_vm *bigint_vm)
+{
+    if (bigint_vm->top <= 0) {
+        (void)fprintf(stderr, "Stack undeflow\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return bigint_vm->stack[--bigint_vm->top];
+}
+
+void run_bigint_vm(struct bigint_vm *bigint_vm, struct bigint *result)
+{
+    struct chunk *chunks = bigint_vm->chunks;
+    struct bigint *constants = malloc((chunks->const_size + 1) * sizeof(*constants));
+    if (!constants) {
+        (void)fprintf(stderr, "Go download more ram\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < chunks->const_size; i++) {
+        bigint_init(&constants[i]);
+        bigint_from_literal(&constants[i], chunks->literals[i].text, chunks->literals[i].length);
+    }
+
+    while (true) {
+        struct bytecode instruction = chunks->code[bigint_vm->ip];
+
+        switch (instruction.code) {
+        case OP_CONSTANT: {
+            struct bigint value;
+            bigint_init(&value);
+            bigint_copy(&value, &constants[instruction.const_index]);
+
+            bigint_push(bigint_vm, &value);
+        } break;
+
+        case OP_NEGATE: {
+            struct bigint value = bigint_pop(bigint_vm);
+            bigint_negate(&value);
+            bigint_push(bigint_vm, &value);
+        } break;
+
+        case OP_ADD:
+        case OP_SUBTRACT:
+        case OP_MULTIPLY:
+        case OP_DIVIDE:
+        case OP_MODULO:
+        case OP_POWER: {
+            struct bigint rhs = bigint_pop(bigint_vm);
+            struct bigint lhs = bigint_pop(bigint_vm);
+
+            bigint_binary_op(instruction.code, &lhs, &lhs, &rhs);
+            bigint_push(bigint_vm, &lhs);
+            bigint_free(&rhs);
+        } break;
+
+        case OP_POW_INT: {
+            int64_t exponent = (int64_t)instruction.operand;
+
+            if (exponent < 0) {
+                (void)fprintf(stderr,
+                              "Exponent must be a non-negative 64-bit integer in bigint mode\n");
+                exit(EXIT_FAILURE);
+            }
+
+            struct bigint value = bigint_pop(bigint_vm);
+            bigint_pow(&value, &value, (uint64_t)exponent);
+            bigint_push(bigint_vm, &value);
+        } break;
+
+        case OP_HALT: {
+            *result = bigint_pop(bigint_vm);
+
+            for (size_t i = 0; i < chunks->const_size; i++) {
+                bigint_free(&constants[i]);
+            }
+            free(constants);
+
+            return;
+        }
+
+        default: {
+            (void)fprintf(stderr, "Unsupported instruction in bigint mode\n");
+            exit(EXIT_FAILURE);
+        }
+        }
+
+        bigint_vm->ip += 1;
+    }
+}
+
+void eval_ast_bigint(const struct ast_node *root, struct bigint *result)
+{
+    switch (root->type) {
+    case NODE_NUMBER: {
+        bigint_from_literal(result, root->data.number.lexeme, root->data.number.lexeme_length);
+    } break;
+
+    case NODE_UNARY: {
+        eval_ast_bigint(root->data.unary.child, result);
+
+        if (root->data.unary.op == MINUS) {
+            bigint_negate(result);
+        }
+    } break;
+
+    case NODE_BINARY: {
+        struct bigint rhs;
+        bigint_init(&rhs);
+
+        eval_ast_bigint(root->data.binary.left, result);
+        eval_ast_bigint(root->data.binary.right, &rhs);
+
+        bigint_binary_op(get_opcode_from_token_kind(root->data.binary.op), result, result, &rhs);
+        bigint_free(&rhs);
+    } break;
+
+    default: {
+        (void)fprintf(stderr, "Unsupported node in bigint mode\n");
+        exit(EXIT_FAILURE);
+    }
+    }
+}
+
+int bigint_compare(const struct bigint *a, const struct bigint *b)
+{
+    if (a->negative != b->negative) {
+        return a->negative ? -1 : 1;
+    }
+
+    int magnitude = mag_compare(a->limbs, a->size, b->limbs, b->size);
+
+    return a->negative ? -magnitude : magnitude;
+}
+
+void bigint_lehmer_step(struct bigint *u, struct bigint *v, const int64_t cofactors[4])
+{
+    // (u, v) = (a * u + b * v, c * u + d * v) in one pass; the cofactors stay below 10^9, so
+    // every term fits in an int64.
+    bigint_reserve(v, u->size);
+    for (size_t i = v->size; i < u->size; i++) {
+        v->limbs[i] = 0;
+    }
+
+    int64_t carry_u = 0;
+    int64_t carry_v = 0;
+
+    for (size_t i = 0; i < u->size; i++) {
+        int64_t x = u->limbs[i];
+        int64_t y = v->limbs[i];
+        int64_t next_u = cofactors[0] * x + cofactors[1] * y + carry_u;
+        int64_t next_v = cofactors[2] * x + cofactors[3] * y + carry_v;
+        int64_t digit_u = next_u % (int64_t)BIGINT_BASE;
+        int64_t digit_v = next_v % (int64_t)BIGINT_BASE;
+
+        carry_u = next_u / (int64_t)BIGINT_BASE - (digit_u < 0);
+        carry_v = next_v / (int64_t)BIGINT_BASE - (digit_v < 0);
+        u->limbs[i] = (uint32_t)(digit_u < 0 ? digit_u + BIGINT_BASE : digit_u);
+        v->limbs[i] = (uint32_t)(digit_v < 0 ? digit_v + BIGINT_BASE : digit_v);
+    }
+
+    v->size = u->size;
+    bigint_normalize(u);
+    bigint_normalize(v);
+}
+
+void bigint_gcd(struct bigint *result, const struct bigint *a, const struct bigint *b)
+{
+    // Lehmer's GCD: the leading 18 digits pick the next run of Euclid quotients, and one pass over
+    // the limbs applies the whole run, instead of a long division or subtraction per step.
+    struct bigint u;
+    struct bigint v;
+    struct bigint remainder;
+    bigint_init(&u);
+    bigint_init(&v);
+    bigint_init(&remainder);
+    bigint_copy(&u, a);
+    bigint_copy(&v, b);
+    u.negative = false;
+    v.negative = false;
+
+    if (mag_compare(u.limbs, u.size, v.limbs, v.size) < 0) {
+        bigint_swap(&u, &v);
+    }
+
+    while (v.size > 1) {
+        size_t n = u.size;
+        int64_t cofactors[4] = {1, 0, 0, 1};
+
+        if (v.size + 1 >= n) {
+            uint64_t high_u = (uint64_t)u.limbs[n - 1] * BIGINT_BASE + u.limbs[n - 2];
+            uint64_t high_v = (v.size == n ? (uint64_t)v.limbs[n - 1] * BIGINT_BASE : 0) +
+                              v.limbs[n - 2];
+
+            if (n > 2) {
+                // Top up to 18 digits from the third limb, cut at the same place in both.
+                uint32_t scale = BIGINT_BASE;
+
+                for (; high_u < (uint64_t)BIGINT_BASE * BIGINT_BASE / 10; scale /= 10) {
+                    high_u *= 10;
+                    high_v *= 10;
+                }
+                high_u += u.limbs[n - 3] / scale;
+                high_v += v.limbs[n - 3] / scale;
+            }
+
+            int64_t x = (int64_t)high_u;
+            int64_t y = (int64_t)high_v;
+
+            // Knuth's Algorithm L: stop once the truncated digits no longer fix the quotient, or
+            // before a cofactor outgrows a limb.
+            while (y + cofactors[2] != 0 && y + cofactors[3] != 0) {
+                int64_t q = (x + cofactors[0]) / (y + cofactors[2]);
+
+                if (q >= BIGINT_BASE || q != (x + cofactors[1]) / (y + cofactors[3])) {
+                    break;
+                }
+
+                int64_t next_a = cofactors[0] - q * cofactors[2];
+                int64_t next_b = cofactors[1] - q * cofactors[3];
+
+                if (llabs(next_a) >= BIGINT_BASE || llabs(next_b) >= BIGINT_BASE) {
+                    break;
+                }
+
+                int64_t next_x = x - q * y;
+                cofactors[0] = cofactors[2];
+                cofactors[1] = cofactors[3];
+                cofactors[2] = next_a;
+                cofactors[3] = next_b;
+                x = y;
+                y = next_x;
+            }
+        }
+
+        if (cofactors[1] == 0) {
+            bigint_divmod(NULL, &remainder, &u, &v);
+            bigint_swap(&u, &v);
+            bigint_swap(&v, &remainder);
+        } else {
+            bigint_lehmer_step(&u, &v, cofactors);
+        }
+    }
+
+    if (v.size == 1) {
+        uint64_t x = v.limbs[0];
+        uint64_t y = bigint_div_small(&remainder, &u, v.limbs[0]);
+
+        while (y != 0) {
+            uint64_t next = x % y;
+            x = y;
+            y = next;
+        }
+        bigint_from_uint(&u, x);
+    }
+
+    bigint_swap(result, &u);
+    bigint_free(&u);
+    bigint_free(&v);
+    bigint_free(&remainder);
+}
+
+void rational_init(struct rational *value)
+{
+    bigint_init(&value->numerator);
+    bigint_init(&value->denominator);
+    bigint_from_uint(&value->denominator, 1);
+}
+
+void rational_free(struct rational *value)
+{
+    bigint_free(&value->numerator);
+    bigint_free(&value->denominator);
+}
+
+void rational_copy(struct rational *dest, const struct rational *src)
+{
+    bigint_copy(&dest->numerator, &src->numerator);
+    bigint_copy(&dest->denominator, &src->denominator);
+}
+
+void rational_reduce(struct rational *value)
+{
+    struct bigint divisor;
+    bigint_init(&divisor);
+
+    bigint_gcd(&divisor, &value->numerator, &value->denominator);
+
+    if (!(divisor.size == 1 && divisor.limbs[0] == 1) && divisor.size > 0) {
+        bigint_divmod(&value->numerator, NULL, &value->numerator, &divisor);
+        bigint_divmod(&value->denominator, NULL, &value->denominator, &divisor);
+    }
+
+    if (value->numerator.size == 0) {
+        bigint_from_uint(&value->denominator, 1);
+    }
+
+    bigint_free(&divisor);
+}
+
+void rational_maybe_reduce(struct rational *value)
+{
+    // Normalization is lazy: fractions stay unreduced through chains of + and * until the
+    // denominator outgrows RATIONAL_REDUCE_LIMBS, which keeps short chains free of GCDs.
+    if (value->denominator.size > RATIONAL_REDUCE_LIMBS) {
+        rational_reduce(value);
+    }
+}
+
+bool rational_is_integer(struct rational *value)
+{
+    rational_reduce(value);
+
+    return value->denominator.size == 1 && value->denominator.limbs[0] == 1;
+}
+
+void rational_from_literal(struct rational *value, const char *text, size_t length)
+{
+    int64_t exponent = 0;
+
+    if (!parse_decimal_literal(text, length, &value->numerator, &exponent)) {
+        (void)fprintf(stderr, "Invalid number: %.*s\n", (int)length, text);
+        exit(EXIT_FAILURE);
+    }
+
+    check_exact_exponent(text, length, exponent);
+
+    bigint_from_uint(&value->denominator, 1);
+
+    if (exponent >= 0) {
+        bigint_scale_pow10(&value->numerator, (uint64_t)exponent);
+    } else {
+        bigint_scale_pow10(&value->denominator, (uint64_t)-exponent);
+    }
+
+    rational_maybe_reduce(value);
+}
+
+void rational_binary_op(enum opcode code, struct rational *result, const struct rational *lhs,
+                        const struct rational *rhs)
+{
+    struct bigint left;
+    struct bigint right;
+    struct bigint denominator;
+    bigint_init(&left);
+    bigint_init(&right);
+    bigint_init(&denominator);
+
+    switch (code) {
+    case OP_ADD:
+    case OP_SUBTRACT: {
+        if (bigint_compare(&lhs->denominator, &rhs->denominator) == 0) {
+            bigint_copy(&denominator, &lhs->denominator);
+            bigint_copy(&left, &lhs->numerator);
+            bigint_copy(&right, &rhs->numerator);
+        } else {
+            bigint_mul(&denominator, &lhs->denominator, &rhs->denominator);
+            bigint_mul(&left, &lhs->numerator, &rhs->denominator);
+            bigint_mul(&right, &rhs->numerator, &lhs->denominator);
+        }
+
+        if (code == OP_ADD) {
+            bigint_add(&result->numerator, &left, &right);
+        } else {
+            bigint_sub(&result->numerator, &left, &right);
+        }
+
+        bigint_swap(&result->denominator, &denominator);
+    } break;
+
+    case OP_MULTIPLY: {
+        bigint_mul(&result->numerator, &lhs->numerator, &rhs->numerator);
+        bigint_mul(&result->denominator, &lhs->denominator, &rhs->denominator);
+    } break;
+
+    case OP_DIVIDE: {
+        if (rhs->numerator.size == 0) {
+            (void)fprintf(stderr, "Division by zero\n");
+            exit(EXIT_FAILURE);
+        }
+
+        bigint_mul(&left, &lhs->numerator, &rhs->denominator);
+        bigint_mul(&denominator, &lhs->denominator, &rhs->numerator);
+
+        bool negative = denominator.negative != left.negative;
+        denominator.negative = false;
+        left.negative = negative && left.size > 0;
+
+        bigint_swap(&result->numerator, &left);
+        bigint_swap(&result->denominator, &denominator);
+    } break;
+
+    case OP_MODULO: {
+        if (rhs->numerator.size == 0) {
+            (void)fprintf(stderr, "Division by zero\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // x - y * trunc(x / y), the same truncating remainder as fmod.
+        struct bigint quotient;
+        bigint_init(&quotient);
+
+        bigint_mul(&left, &lhs->numerator, &rhs->denominator);
+        bigint_mul(&right, &lhs->denominator, &rhs->numerator);
+        bigint_divmod(&quotient, NULL, &left, &right);
+
+        bigint_mul(&right, &rhs->numerator, &quotient);
+        bigint_mul(&left, &lhs->numerator, &rhs->denominator);
+        bigint_mul(&right, &right, &lhs->denominator);
+        bigint_sub(&result->numerator, &left, &right);
+        bigint_mul(&result->denominator, &lhs->denominator, &rhs->denominator);
+
+        bigint_free(&quotient);
+    } break;
+
+    case OP_POWER: {
+        struct rational exponent;
+        rational_init(&exponent);
+        rational_copy(&exponent, rhs);
+
+        if (!rational_is_integer(&exponent)) {
+            (void)fprintf(stderr, "Exponent must be an integer in rational mode\n");
+            exit(EXIT_FAILURE);
+        }
+
+        bool invert = exponent.numerator.negative;
+        exponent.numerator.negative = false;
+
+        uint64_t power = 0;
+        if (!bigint_to_uint(&exponent.numerator, &power)) {
+            (void)fprintf(stderr, "Exponent out of range in rational mode\n");
+            exit(EXIT_FAILURE);
+        }
+
+        rational_free(&exponent);
+        rational_pow(result, lhs, power, invert);
+    } break;
+
+    default: {
+        (void)fprintf(stderr, "Unsupported instruction in rational mode\n");
+        exit(EXIT_FAILURE);
+    }
+    }
+
+    rational_maybe_reduce(result);
+
+    bigint_free(&left);
+    bigint_free(&right);
+    bigint_free(&denominator);
+}
+
+void rational_pow(struct rational *result, const struct rational *base, uint64_t exponent,
+                  bool invert)
+{
+    struct rational reduced;
+    rational_init(&reduced);
+    rational_copy(&reduced, base);
+
+    // Powers of a reduced fraction stay reduced, so reduce once up front.
+    rational_reduce(&reduced);
+
+    if (invert) {
+        if (reduced.numerator.size == 0) {
+            (void)fprintf(stderr, "Division by zero\n");
+            exit(EXIT_FAILURE);
+        }
+
+        bool negative = reduced.numerator.negative;
+        bigint_swap(&reduced.numerator, &reduced.denominator);
+        reduced.numerator.negative = negative;
+        reduced.denominator.negative = false;
+    }
+
+    bigint_pow(&result->numerator, &reduced.numerator, exponent);
+    bigint_pow(&result->denominator, &reduced.denominator, exponent);
+
+    rational_free(&reduced);
+}
+
+char *rational_to_string(struct rational *value)
+{
+    rational_reduce(value);
+
+    // A reduced denominator of the form 2^a * 5^b terminates after max(a, b) decimals.
+    struct bigint rest;
+    bigint_init(&rest);
+    bigint_copy(&rest, &value->denominator);
+
+    uint64_t twos = 0;
+    uint64_t fives = 0;
+    struct bigint quotient;
+    bigint_init(&quotient);
+
+    while (rest.size > 0 && bigint_div_small(&quotient, &rest, 2) == 0) {
+        bigint_swap(&rest, &quotient);
+        twos += 1;
+    }
+
+    while (rest.size > 0 && bigint_div_small(&quotient, &rest, 5) == 0) {
+        bigint_swap(&rest, &quotient);
+        fives += 1;
+    }
+
+    bool terminates = rest.size == 1 && rest.limbs[0] == 1;
+    bigint_free(&rest);
+    bigint_free(&quotient);
+
+    if (!terminates) {
+        char *numerator = bigint_to_string(&value->numerator);
+        char *denominator = bigint_to_string(&value->denominator);
+        size_t length = strlen(numerator) + strlen(denominator) + 2;
+        char *text = malloc(length);
+
+        if (!text) {
+            (void)fprintf(stderr, "Go download more ram\n");
+            exit(EXIT_FAILURE);
+        }
+
+        (void)snprintf(text, length, "%s/%s", numerator, denominator);
+        free(numerator);
+        free(denominator);
+
+        return text;
+    }
+
+    uint64_t decimals = twos > fives ? twos : fives;
+    struct bigint scaled;
+    bigint_init(&scaled);
+    bigint_copy(&scaled, &value->numerator);
+    bigint_scale_pow10(&scaled, decimals);
+    bigint_divmod(&scaled, NULL, &scaled, &value->denominator);
+
+    bool negative = scaled.negative;
+    scaled.negative = false;
+
+    char *digits = bigint_to_string(&scaled);
+    bigint_free(&scaled);
+
+    size_t digit_count = strlen(digits);
+    size_t padded = digit_count > decimals ? digit_count : (size_t)decimals + 1;
+    char *text = malloc(padded + 3);
+
+    if (!text) {
+        (void)fprintf(stderr, "Go download more ram\n");
+        exit(EXIT_FAILURE);
+    }
+
+    char *cursor = text;
+    if (negative) {
+        *cursor++ = '-';
+    }
+
+    // Left pad with zeros so 1/8 prints as 0.125 rather than .125.
+    for (size_t i = digit_count; i < padded; i++) {
+        *cursor++ = '0';
+    }
+    memcpy(cursor, digits, digit_count);
+    cursor += digit_count;
+    *cursor = '\0';
+
+    if (decimals > 0) {
+        memmove(cursor - decimals + 1, cursor - decimals, decimals + 1);
+        cursor[-decimals] = '.';
+    }
+
+    free(digits);
+
+    return text;
+}
+
+void rational_push(struct rational_vm *rational_vm, struct rational *value)
+{
+    if (rational_vm->top >= MAX_STACK_SIZE) {
+        (void)fprintf(stderr, "Stack overflow\n");
+        exit(EXIT_FAILURE);
+    }
+
+    rational_vm->stack[rational_vm->top++] = *value;
+    rational_init(value);
+}
+
+struct rational rational_pop(struct rational_vm *rational_vm)
+{
+    if (rational_vm->top <= 0) {
+        (void)fprintf(stderr, "Stack undeflow\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return rational_vm->stack[--rational_vm->top];
+}
+
+void run_rational_vm(struct rational_vm *rational_vm, struct rational *result)
+{
+    struct chunk *chunks = rational_vm->chunks;
+    struct rational *constants = malloc((chunks->const_size + 1) * sizeof(*constants));
+    if (!constants) {
+        (void)fprintf(stderr, "Go download more ram\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < chunks->const_size; i++) {
+        rational_init(&constants[i]);
+        rational_from_literal(&constants[i], chunks->literals[i].text, chunks->literals[i].length);
+    }
+
+    while (true) {
+        struct bytecode instruction = chunks->code[rational_vm->ip];
+
+        switch (instruction.code) {
+        case OP_CONSTANT: {
+            struct rational value;
+            rational_init(&value);
+            rational_copy(&value, &constants[instruction.const_index]);
+
+            rational_push(rational_vm, &value);
+        } break;
+
+        case OP_NEGATE: {
+            struct rational value = rational_pop(rational_vm);
+            bigint_negate(&value.numerator);
+            rational_push(rational_vm, &value);
+        } break;
+
+        case OP_ADD:
+        case OP_SUBTRACT:
+        case OP_MULTIPLY:
+        case OP_DIVIDE:
+        case OP_MODULO:
+        case OP_POWER: {
+            struct rational rhs = rational_pop(rational_vm);
+            struct rational lhs = rational_pop(rational_vm);
+
+            rational_binary_op(instruction.code, &lhs, &lhs, &rhs);
+            rational_push(rational_vm, &lhs);
+            rational_free(&rhs);
+        } break;
+
+        case OP_POW_INT: {
+            int64_t exponent = (int64_t)instruction.operand;
+            struct rational value = rational_pop(rational_vm);
+
+            rational_pow(&value, &value, exponent < 0 ? -(uint64_t)exponent : (uint64_t)exponent,
+                         exponent < 0);
+            rational_push(rational_vm, &value);
+        } break;
+
+        case OP_HALT: {
+            *result = rational_pop(rational_vm);
+
+            for (size_t i = 0; i < chunks->const_size; i++) {
+                rational_free(&constants[i]);
+            }
+            free(constants);
+
+            return;
+        }
+
+        default: {
+            (void)fprintf(stderr, "Unsupported instruction in rational mode\n");
+            exit(EXIT_FAILURE);
+        }
+        }
+
+        rational_vm->ip += 1;
+    }
+}
+
+void eval_ast_rational(const struct ast_node *root, struct rational *result)
+{
+    switch (root->type) {
+    case NODE_NUMBER: {
+        rational_from_literal(result, root->data.number.lexeme, root->data.number.lexeme_length);
+    } break;
+
+    case NODE_UNARY: {
+        eval_ast_rational(root->data.unary.child, result);
+
+        if (root->data.unary.op == MINUS) {
+            bigint_negate(&result->numerator);
+        }
+    } break;
+
+    case NODE_BINARY: {
+        struct rational rhs;
+        rational_init(&rhs);
+
+        eval_ast_rational(root->data.binary.left, result);
+        eval_ast_rational(root->data.binary.right, &rhs);
+
+        rational_binary_op(get_opcode_from_token_kind(root->data.binary.op), result, result,
+                           &rhs);
+        rational_free(&rhs);
+    } break;
+
+    default: {
+        (void)fprintf(stderr, "Unsupported node in rational mode\n");
+        exit(EXIT_FAILURE);
+    }
+    }
+}
+
+float pow_int_f32(float base, int64_t exponent)
+{
+    // Same walk and the same powf() fallback outside the normal range as pow_int.
+    uint64_t remaining = exponent < 0 ? -(uint64_t)exponent : (uint64_t)exponent;
+    float original = base;
+    float accumulator = 1.0F;
+
+    while (remaining > 0) {
+        if (remaining & 1) {
+            accumulator *= base;
+        }
+
+        remaining >>= 1;
+
+        if (remaining > 0) {
+            base *= base;
+        }
+    }
+
+    float result = exponent < 0 ? 1.0F / accumulator : accumulator;
+
+    if (!isnormal(accumulator) || !isnormal(result)) {
+        return powf(original, (float)exponent);
+    }
+
+    return result;
+}
+
+float f32_from_literal(const struct literal *literal, double value)
+{
+    // Rounding the decimal text straight to float avoids double rounding through the double
+    // constant.
+    if (!literal->text) {
+        return (float)value;
+    }
+
+    char *buffer = malloc(literal->length + 1);
+    if (!buffer) {
+        (void)fprintf(stderr, "Go download more ram\n");
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(buffer, literal->text, literal->length);
+    buffer[literal->length] = '\0';
+
+    float result = strtof(buffer, NULL);
+    free(buffer);
+
+    return result;
+}
+
+float f32_binary_op(enum opcode code, float lhs, float rhs)
+{
+    switch (code) {
+    case OP_ADD:
+        return lhs + rhs;
+    case OP_SUBTRACT:
+        return lhs - rhs;
+    case OP_MULTIPLY:
+        return lhs * rhs;
+    case OP_DIVIDE:
+    case OP_MODULO: {
+        if (rhs == 0.0F) {
+            (void)fprintf(stderr, "Division by zero\n");
+            exit(EXIT_FAILURE);
+        }
+
+        return code == OP_DIVIDE ? lhs / rhs : fmodf(lhs, rhs);
+    }
+    case OP_POWER:
+        return powf(lhs, rhs);
+    default: {
+        (void)fprintf(stderr, "Unsupported instruction in f32 mode\n");
+        exit(EXIT_FAILURE);
+    }
+    }
+}
+
+float run_f32_vm(struct f32_vm *f32_vm)
+{
+    struct chunk *chunks = f32_vm->chunks;
+    float *constants = malloc((chunks->const_size + 1) * sizeof(*constants));
+    if (!constants) {
+        (void)fprintf(stderr, "Go download more ram\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < chunks->const_size; i++) {
+        constants[i] = f32_from_literal(&chunks->literals[i], chunks->constants[i]);
+    }
+
+    while (true) {
+        struct bytecode instruction = chunks->code[f32_vm->ip];
+
+        switch (instruction.code) {
+        case OP_CONSTANT: {
+            if (f32_vm->top >= MAX_STACK_SIZE) {
+                (void)fprintf(stderr, "Stack overflow\n");
+                exit(EXIT_FAILURE);
+            }
+
+            f32_vm->stack[f32_vm->top++] = constants[instruction.const_index];
+        } break;
+
+        case OP_NEGATE: {
+            if (f32_vm->top < 1) {
+                (void)fprintf(stderr, "Stack undeflow\n");
+                exit(EXIT_FAILURE);
+            }
+
+            f32_vm->stack[f32_vm->top - 1] = -f32_vm->stack[f32_vm->top - 1];
+        } break;
+
+        case OP_ADD:
+        case OP_SUBTRACT:
+        case OP_MULTIPLY:
+        case OP_DIVIDE:
+        case OP_MODULO:
+        case OP_POWER: {
+            if (f32_vm->top < 2) {
+                (void)fprintf(stderr, "Stack undeflow\n");
+                exit(EXIT_FAILURE);
+            }
+
+            float rhs = f32_vm->stack[--f32_vm->top];
+            float lhs = f32_vm->stack[f32_vm->top - 1];
+
+            f32_vm->stack[f32_vm->top - 1] = f32_binary_op(instruction.code, lhs, rhs);
+        } break;
+
+        case OP_POW_INT: {
+            if (f32_vm->top < 1) {
+                (void)fprintf(stderr, "Stack undeflow\n");
+                exit(EXIT_FAILURE);
+            }
+
+            f32_vm->stack[f32_vm->top - 1] =
+                pow_int_f32(f32_vm->stack[f32_vm->top - 1], (int64_t)instruction.operand);
+        } break;
+
+        case OP_HALT: {
+            if (f32_vm->top < 1) {
+                (void)fprintf(stderr, "Stack undeflow\n");
+                exit(EXIT_FAILURE);
+            }
+
+            free(constants);
+
+            return f32_vm->stack[--f32_vm->top];
+        }
+
+        default: {
+            (void)fprintf(stderr, "Unsupported instruction in f32 mode\n");
+            exit(EXIT_FAILURE);
+        }
+        }
+
+        f32_vm->ip += 1;
+    }
+}
+
+float eval_ast_f32(const struct ast_node *root)
+{
+    switch (root->type) {
+    case NODE_NUMBER: {
+        struct literal literal = { .text = root->data.number.lexeme,
+                                   .length = root->data.number.lexeme_length };
+
+        return f32_from_literal(&literal, root->data.number.value);
+    }
+
+    case NODE_UNARY: {
+        float value = eval_ast_f32(root->data.unary.child);
+        return root->data.unary.op == MINUS ? -value : value;
+    }
+
+    case NODE_BINARY: {
+        int64_t exponent = 0;
+        if (root->data.binary.op == CARET &&
+            get_constant_exponent(root->data.binary.right, &exponent)) {
+            return pow_int_f32(eval_ast_f32(root->data.binary.left), exponent);
+        }
+
+        float lhs = eval_ast_f32(root->data.binary.left);
+        float rhs = eval_ast_f32(root->data.binary.right);
+
+        return f32_binary_op(get_opcode_from_token_kind(root->data.binary.op), lhs, rhs);
+    }
+
+    default: {
+        (void)fprintf(stderr, "Unsupported node in f32 mode\n");
+        exit(EXIT_FAILURE);
+    }
+    }
+}
+
+double round_toward(double value, double error, int direction)
+{
+    // error is the exact residual (true result - value). Moving one ulp only when the residual
+    // points the requested way gives correctly rounded downward/upward results without touching
+    // the floating point environment.
+    if (direction < 0 && error < 0.0) {
+        return nextafter(value, -INFINITY);
+    }
+
+    if (direction > 0 && error > 0.0) {
+        return nextafter(value, INFINITY);
+    }
+
+    return value;
+}
+
+double round_overflow(double value, int direction)
+{
+    // A finite operation that overflowed to infinity still has a finite bound on the other side.
+    if (direction < 0 && value == INFINITY) {
+        return DBL_MAX;
+    }
+
+    if (direction > 0 && value == -INFINITY) {
+        return -DBL_MAX;
+    }
+
+    return value;
+}
+
+double add_rounded(double a, double b, int direction)
+{
+    double sum = a + b;
+
+    if (!isfinite(sum)) {
+        return isfinite(a) && isfinite(b) ? round_overflow(sum, direction) : sum;
+    }
+
+    // TwoSum: the rounding error of a + b is exactly representable.
+    double b_virtual = sum - a;
+    double a_virtual = sum - b_virtual;
+    double error = (a - a_virtual) + (b - b_virtual);
+
+    return round_toward(sum, error, direction);
+}
+
+double mul_rounded(double a, double b, int direction)
+{
+    // Interval endpoints treat 0 * inf as 0.
+    if (a == 0.0 || b == 0.0) {
+        return 0.0;
+    }
+
+    double product = a * b;
+
+    if (!isfinite(product)) {
+        return isfinite(a) && isfinite(b) ? round_overflow(product, direction) : product;
+    }
+
+    // The FMA residual is exact unless the product is near the subnormal range, where it is
+    // only known to have the right sign, so step outward unconditionally there.
+    if (fabs(product) < 0x1p-969) {
+        return nextafter(product, direction < 0 ? -INFINITY : INFINITY);
+    }
+
+    return round_toward(product, fma(a, b, -product), direction);
+}
+
+double div_rounded(double a, double b, int direction)
+{
+    if (a == 0.0) {
+        return 0.0;
+    }
+
+    double quotient = a / b;
+
+    if (!isfinite(quotient) || isinf(b)) {
+        return isfinite(a) && isfinite(b) ? round_overflow(quotient, direction) : quotient;
+    }
+
+    if (fabs(quotient) < 0x1p-969 || fabs(b) < 0x1p-969) {
+        return nextafter(quotient, direction < 0 ? -INFINITY : INFINITY);
+    }
+
+    // a - q * b is exact, and a / b - q has its sign times the sign of b.
+    double remainder = fma(-quotient, b, a);
+
+    return round_toward(quotient, b < 0.0 ? -remainder : remainder, direction);
+}
+
+struct interval interval_point(double value)
+{
+    return (struct interval){ .lo = value, .hi = value };
+}
+
+struct interval interval_entire(void)
+{
+    return (struct interval){ .lo = -INFINITY, .hi = INFINITY };
+}
+
+struct interval interval_from_literal(const struct literal *literal, double value)
+{
+    if (!literal->text) {
+        return interval_point(value);
+    }
+
+    // Sized to the literal, any length has to be bracketed for the enclosure to hold.
+    char *buffer = malloc(literal->length + 1);
+    if (!buffer) {
+        (void)fprintf(stderr, "Go download more ram\n");
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(buffer, literal->text, literal->length);
+    buffer[literal->length] = '\0';
+
+    // strtod honours the rounding mode, which brackets decimals such as 0.1 that have no exact
+    // double. Exactly representable literals come out as point intervals.
+    int previous = fegetround();
+
+    (void)fesetround(FE_DOWNWARD);
+    double lo = strtod(buffer, NULL);
+    (void)fesetround(FE_UPWARD);
+    double hi = strtod(buffer, NULL);
+    (void)fesetround(previous);
+    free(buffer);
+
+    return (struct interval){ .lo = lo, .hi = hi };
+}
+
+struct interval interval_negate(struct interval value)
+{
+    return (struct interval){ .lo = -value.hi, .hi = -value.lo };
+}
+
+struct interval interval_add(struct interval lhs, struct interval rhs)
+{
+    return (struct interval){ .lo = add_rounded(lhs.lo, rhs.lo, -1),
+                              .hi = add_rounded(lhs.hi, rhs.hi, 1) };
+}
+
+struct interval interval_sub(struct interval lhs, struct interval rhs)
+{
+    return interval_add(lhs, interval_negate(rhs));
+}
+
+struct interval interval_mul(struct interval lhs, struct interval rhs)
+{
+    double corners[4][2] = { { lhs.lo, rhs.lo },
+                             { lhs.lo, rhs.hi },
+                             { lhs.hi, rhs.lo },
+                             { lhs.hi, rhs.hi } };
+    struct interval result = { .lo = INFINITY, .hi = -INFINITY };
+
+    for (size_t i = 0; i < 4; i++) {
+        result.lo = fmin(result.lo, mul_rounded(corners[i][0], corners[i][1], -1));
+        result.hi = fmax(result.hi, mul_rounded(corners[i][0], corners[i][1], 1));
+    }
+
+    return result;
+}
+
+struct interval interval_div(struct interval lhs, struct interval rhs)
+{
+    if (rhs.lo == 0.0 && rhs.hi == 0.0) {
+        (void)fprintf(stderr, "Division by zero\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // A divisor straddling zero takes every real value near it, so the quotient is the whole
+    // line. With zero only at one end the quotient is a half line, unless the dividend also
+    // straddles zero.
+    if (rhs.lo < 0.0 && rhs.hi > 0.0) {
+        return interval_entire();
+    }
+
+    if (rhs.lo == 0.0 || rhs.hi == 0.0) {
+        bool divisor_positive = rhs.hi > 0.0;
+        double nonzero = divisor_positive ? rhs.hi : rhs.lo;
+
+        if (lhs.lo >= 0.0) {
+            return divisor_positive
+                       ? (struct interval){ .lo = div_rounded(lhs.lo, nonzero, -1), .hi = INFINITY }
+                       : (struct interval){ .lo = -INFINITY, .hi = div_rounded(lhs.lo, nonzero, 1) };
+        }
+
+        if (lhs.hi <= 0.0) {
+            return divisor_positive
+                       ? (struct interval){ .lo = -INFINITY, .hi = div_rounded(lhs.hi, nonzero, 1) }
+                       : (struct interval){ .lo = div_rounded(lhs.hi, nonzero, -1), .hi = INFINITY };
+        }
+
+        return interval_entire();
+    }
+
+    double corners[4][2] = { { lhs.lo, rhs.lo },
+                             { lhs.lo, rhs.hi },
+                             { lhs.hi, rhs.lo },
+                             { lhs.hi, rhs.hi } };
+    struct interval result = { .lo = INFINITY, .hi = -INFINITY };
+
+    for (size_t i = 0; i < 4; i++) {
+        result.lo = fmin(result.lo, div_rounded(corners[i][0], corners[i][1], -1));
+        result.hi = fmax(result.hi, div_rounded(corners[i][0], corners[i][1], 1));
+    }
+
+    return result;
+}
+
+struct interval interval_mod(struct interval lhs, struct interval rhs)
+{
+    if (rhs.lo == 0.0 && rhs.hi == 0.0) {
+        (void)fprintf(stderr, "Division by zero\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // fmod is exact, so point operands give a point result.
+    if (lhs.lo == lhs.hi && rhs.lo == rhs.hi) {
+        return interval_point(fmod(lhs.lo, rhs.lo));
+    }
+
+    // |fmod(x, y)| < |y| and the result takes the sign of x.
+    double bound = fmax(fabs(rhs.lo), fabs(rhs.hi));
+    struct interval result = { .lo = lhs.lo >= 0.0 ? 0.0 : -bound,
+                               .hi = lhs.hi <= 0.0 ? 0.0 : bound };
+
+    if (rhs.lo > 0.0 || rhs.hi < 0.0) {
+        // Where trunc(x / y) is the same n over the whole box, fmod(x, y) = x - n * y.
+        struct interval quotient = interval_div(lhs, rhs);
+
+        if (isfinite(quotient.lo) && isfinite(quotient.hi) &&
+            trunc(quotient.lo) == trunc(quotient.hi)) {
+            struct interval exact =
+                interval_sub(lhs, interval_mul(interval_point(trunc(quotient.lo)), rhs));
+
+            result.lo = fmax(result.lo, exact.lo);
+            result.hi = fmin(result.hi, exact.hi);
+        }
+    }
+
+    return result;
+}
+
+struct interval interval_pow_int(struct interval base, int64_t exponent)
+{
+    if (exponent < 0) {
+        return interval_div(interval_point(1.0),
+                            interval_pow_int(base, -exponent));
+    }
+
+    // x^n for x >= 0 by repeated squaring with every product rounded the same way bounds the
+    // power from below and from above.
+    double magnitude_lo = base.lo >= 0.0 ? base.lo : base.hi <= 0.0 ? -base.hi : 0.0;
+    double magnitude_hi = fmax(fabs(base.lo), fabs(base.hi));
+    double lo = 1.0;
+    double hi = 1.0;
+    double square_lo = magnitude_lo;
+    double square_hi = magnitude_hi;
+
+    for (uint64_t remaining = (uint64_t)exponent; remaining > 0; remaining >>= 1) {
+        if (remaining & 1) {
+            lo = mul_rounded(lo, square_lo, -1);
+            hi = mul_rounded(hi, square_hi, 1);
+        }
+
+        if (remaining > 1) {
+            square_lo = mul_rounded(square_lo, square_lo, -1);
+            square_hi = mul_rounded(square_hi, square_hi, 1);
+        }
+    }
+
+    if (exponent % 2 == 0) {
+        return (struct interval){ .lo = lo, .hi = hi };
+    }
+
+    // Odd powers keep the sign and are increasing, so map each end separately.
+    if (base.lo >= 0.0) {
+        return (struct interval){ .lo = lo, .hi = hi };
+    }
+
+    struct interval low_end = interval_pow_int(interval_point(-base.lo), exponent);
+    struct interval high_end = base.hi >= 0.0
+                                   ? interval_pow_int(interval_point(base.hi), exponent)
+                                   : interval_negate(interval_pow_int(interval_point(-base.hi),
+                                                                      exponent));
+
+    return (struct interval){ .lo = -low_end.hi, .hi = high_end.hi };
+}
+
+struct interval interval_pow(struct interval base, struct interval exponent)
+{
+    if (exponent.lo == exponent.hi && exponent.lo == trunc(exponent.lo) &&
+        fabs(exponent.lo) <= 0x1p53) {
+        return interval_pow_int(base, (int64_t)exponent.lo);
+    }
+
+    // Negative bases with non-integer exponents have no real value for most points of the box.
+    if (base.lo < 0.0) {
+        return interval_entire();
+    }
+
+    // For x >= 0, x^y is monotonic in each argument, so the extremes are at the corners. libm's
+    // pow is not correctly rounded, so each corner is widened by one ulp.
+    double corners[4][2] = { { base.lo, exponent.lo },
+                             { base.lo, exponent.hi },
+                             { base.hi, exponent.lo },
+                             { base.hi, exponent.hi } };
+    struct interval result = { .lo = INFINITY, .hi = -INFINITY };
+
+    for (size_t i = 0; i < 4; i++) {
+        double value = pow(corners[i][0], corners[i][1]);
+
+        result.lo = fmin(result.lo, nextafter(value, -INFINITY));
+        result.hi = fmax(result.hi, nextafter(value, INFINITY));
+    }
+
+    result.lo = fmax(result.lo, 0.0);
+
+    return result;
+}
+
+struct interval interval_binary_op(enum opcode code, struct interval lhs, struct interval rhs)
+{
+    switch (code) {
+    case OP_ADD:
+        return interval_add(lhs, rhs);
+    case OP_SUBTRACT:
+        return interval_sub(lhs, rhs);
+    case OP_MULTIPLY:
+        return interval_mul(lhs, rhs);
+    case OP_DIVIDE:
+        return interval_div(lhs, rhs);
+    case OP_MODULO:
+        return interval_mod(lhs, rhs);
+    case OP_POWER:
+        return interval_pow(lhs, rhs);
+    default: {
+        (void)fprintf(stderr, "Unsupported instruction in interval mode\n");
+        exit(EXIT_FAILURE);
+    }
+    }
+}
+
+struct interval run_interval_vm(struct interval_vm *interval_vm)
+{
+    struct chunk *chunks = interval_vm->chunks;
+    struct interval *constants = malloc((chunks->const_size + 1) * sizeof(*constants));
+    if (!constants) {
+        (void)fprintf(stderr, "Go download more ram\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < chunks->const_size; i++) {
+        constants[i] = interval_from_literal(&chunks->literals[i], chunks->constants[i]);
+    }
+
+    double *lo = interval_vm->lo;
+    double *hi = interval_vm->hi;
+
+    while (true) {
+        struct bytecode instruction = chunks->code[interval_vm->ip];
+        size_t top = interval_vm->top;
+
+        switch (instruction.code) {
+        case OP_CONSTANT: {
+            if (top >= MAX_STACK_SIZE) {
+                (void)fprintf(stderr, "Stack overflow\n");
+                exit(EXIT_FAILURE);
+            }
+
+            lo[top] = constants[instruction.const_index].lo;
+            hi[top] = constants[instruction.const_index].hi;
+            interval_vm->top += 1;
+        } break;
+
+        case OP_NEGATE:
+        case OP_POW_INT: {
+            if (top < 1) {
+                (void)fprintf(stderr, "Stack undeflow\n");
+                exit(EXIT_FAILURE);
+            }
+
+            struct interval value = { .lo = lo[top - 1], .hi = hi[top - 1] };
+            value = instruction.code == OP_NEGATE
+                        ? interval_negate(value)
+                        : interval_pow_int(value, (int64_t)instruction.operand);
+
+            lo[top - 1] = value.lo;
+            hi[top - 1] = value.hi;
+        } break;
+
+        case OP_ADD:
+        case OP_SUBTRACT:
+        case OP_MULTIPLY:
+        case OP_DIVIDE:
+        case OP_MODULO:
+        case OP_POWER: {
+            if (top < 2) {
+                (void)fprintf(stderr, "Stack undeflow\n");
+                exit(EXIT_FAILURE);
+            }
+
+            struct interval rhs = { .lo = lo[top - 1], .hi = hi[top - 1] };
+            struct interval lhs = { .lo = lo[top - 2], .hi = hi[top - 2] };
+            struct interval value = interval_binary_op(instruction.code, lhs, rhs);
+
+            lo[top - 2] = value.lo;
+            hi[top - 2] = value.hi;
+            interval_vm->top -= 1;
+        } break;
+
+        case OP_HALT: {
+            if (top < 1) {
+                (void)fprintf(stderr, "Stack undeflow\n");
+                exit(EXIT_FAILURE);
+            }
+
+            free(constants);
+            interval_vm->top -= 1;
+
+            return (struct interval){ .lo = lo[top - 1], .hi = hi[top - 1] };
+        }
+
+        default: {
+            (void)fprintf(stderr, "Unsupported instruction in interval mode\n");
+            exit(EXIT_FAILURE);
+        }
+        }
+
+        interval_vm->ip += 1;
+    }
+}
+
+struct interval eval_ast_interval(const struct ast_node *root)
+{
+    switch (root->type) {
+    case NODE_NUMBER: {
+        struct literal literal = { .text = root->data.number.lexeme,
+                                   .length = root->data.number.lexeme_length };
+
+        return interval_from_literal(&literal, root->data.number.value);
+    }
+
+    case NODE_UNARY: {
+        struct interval value = eval_ast_interval(root->data.unary.child);
+        return root->data.unary.op == MINUS ? interval_negate(value) : value;
+    }
+
+    case NODE_BINARY: {
+        int64_t exponent = 0;
+        if (root->data.binary.op == CARET &&
+            get_constant_exponent(root->data.binary.right, &exponent)) {
+            return interval_pow_int(eval_ast_interval(root->data.binary.left), exponent);
+        }
+
+        struct interval lhs = eval_ast_interval(root->data.binary.left);
+        struct interval rhs = eval_ast_interval(root->data.binary.right);
+
+        return interval_binary_op(get_opcode_from_token_kind(root->data.binary.op), lhs, rhs);
+    }
+
+    default: {
+        (void)fprintf(stderr, "Unsupported node in interval mode\n");
+        exit(EXIT_FAILURE);
+    }
+    }
+}
+
+struct dd dd_from_double(double value)
+{
+    return (struct dd){ .hi = value, .lo = 0.0 };
+}
+
+struct dd dd_quick_two_sum(double a, double b)
+{
+    // Requires |a| >= |b|.
+    double sum = a + b;
+
+    return (struct dd){ .hi = sum, .lo = b - (sum - a) };
+}
+
+struct dd dd_two_sum(double a, double b)
+{
+    double sum = a + b;
+    double b_virtual = sum - a;
+    double a_virtual = sum - b_virtual;
+
+    return (struct dd){ .hi = sum, .lo = (a - a_virtual) + (b - b_virtual) };
+}
+
+struct dd dd_two_prod(double a, double b)
+{
+    double product = a * b;
+
+    return (struct dd){ .hi = product, .lo = fma(a, b, -product) };
+}
+
+struct dd dd_negate(struct dd value)
+{
+    return (struct dd){ .hi = -value.hi, .lo = -value.lo };
+}
+
+struct dd dd_add(struct dd a, struct dd b)
+{
+    // The accurate (IEEE style) addition: both the high and the low parts are added with
+    // TwoSum so cancellation in the high parts does not lose the low bits.
+    struct dd high = dd_two_sum(a.hi, b.hi);
+    struct dd low = dd_two_sum(a.lo, b.lo);
+
+    if (!isfinite(high.hi)) {
+        return dd_from_double(high.hi);
+    }
+
+    high.lo += low.hi;
+    high = dd_quick_two_sum(high.hi, high.lo);
+    high.lo += low.lo;
+
+    return dd_quick_two_sum(high.hi, high.lo);
+}
+
+struct dd dd_sub(struct dd a, struct dd b)
+{
+    return dd_add(a, dd_negate(b));
+}
+
+struct dd dd_mul(struct dd a, struct dd b)
+{
+    struct dd product = dd_two_prod(a.hi, b.hi);
+
+    if (!isfinite(product.hi)) {
+        return dd_from_double(product.hi);
+    }
+
+    product.lo += a.hi * b.lo + a.lo * b.hi;
+
+    return dd_quick_two_sum(product.hi, product.lo);
+}
+
+struct dd dd_mul_double(struct dd a, double b)
+{
+    return dd_mul(a, dd_from_double(b));
+}
+
+struct dd dd_div(struct dd a, struct dd b)
+{
+    // Long division with three double sized quotient digits, each correcting the remainder of
+    // the previous one.
+    double q1 = a.hi / b.hi;
+
+    if (!isfinite(q1) || q1 == 0.0) {
+        return dd_from_double(q1);
+    }
+
+    struct dd remainder = dd_sub(a, dd_mul_double(b, q1));
+    double q2 = remainder.hi / b.hi;
+    remainder = dd_sub(remainder, dd_mul_double(b, q2));
+    double q3 = remainder.hi / b.hi;
+
+    return dd_add(dd_quick_two_sum(q1, q2), dd_from_double(q3));
+}
+
+struct dd dd_ldexp(struct dd value, int exponent)
+{
+    return (struct dd){ .hi = ldexp(value.hi, exponent), .lo = ldexp(value.lo, exponent) };
+}
+
+struct dd dd_trunc(struct dd value)
+{
+    double hi = trunc(value.hi);
+
+    if (hi != value.hi) {
+        return dd_from_double(hi);
+    }
+
+    // The high part is already integral, the low part decides which way hi + lo truncates.
+    double lo = value.hi > 0.0 ? floor(value.lo) : ceil(value.lo);
+
+    return dd_quick_two_sum(hi, lo);
+}
+
+struct dd dd_pow_int(struct dd base, int64_t exponent)
+{
+    uint64_t remaining = exponent < 0 ? -(uint64_t)exponent : (uint64_t)exponent;
+    struct dd accumulator = dd_from_double(1.0);
+
+    while (remaining > 0) {
+        if (remaining & 1) {
+            accumulator = dd_mul(accumulator, base);
+        }
+
+        remaining >>= 1;
+
+        if (remaining > 0) {
+            base = dd_mul(base, base);
+        }
+    }
+
+    return exponent < 0 ? dd_div(dd_from_double(1.0), accumulator) : accumulator;
+}
+
+struct dd dd_exp(struct dd value)
+{
+    // exp(x) = 2^k * exp(r)^1024 with r = (x - k ln 2) / 1024. The Taylor series converges in a
+    // handful of terms for such a small r, and exp(r) - 1 is squared up as s = s^2 + 2s to keep
+    // the leading bits.
+    const struct dd ln2 = { .hi = 6.931471805599452862e-01, .lo = 2.319046813846299558e-17 };
+
+    if (value.hi > 709.8) {
+        return dd_from_double(INFINITY);
+    }
+
+    if (value.hi < -745.2) {
+        return dd_from_double(0.0);
+    }
+
+    double k = floor(value.hi / ln2.hi + 0.5);
+    struct dd reduced = dd_ldexp(dd_sub(value, dd_mul_double(ln2, k)), -10);
+    struct dd term = reduced;
+    struct dd sum = reduced;
+
+    for (int n = 2; n < 30 && fabs(term.hi) > 1e-36; n++) {
+        term = dd_div(dd_mul(term, reduced), dd_from_double(n));
+        sum = dd_add(sum, term);
+    }
+
+    for (int i = 0; i < 10; i++) {
+        sum = dd_add(dd_ldexp(sum, 1), dd_mul(sum, sum));
+    }
+
+    return dd_ldexp(dd_add(sum, dd_from_double(1.0)), (int)k);
+}
+
+struct dd dd_log(struct dd value)
+{
+    if (value.hi <= 0.0) {
+        return dd_from_double(log(value.hi));
+    }
+
+    // One Newton step on exp(y) = x doubles the 53 correct bits of libm's log.
+    struct dd guess = dd_from_double(log(value.hi));
+
+    return dd_sub(dd_add(guess, dd_mul(value, dd_exp(dd_negate(guess)))), dd_from_double(1.0));
+}
+
+struct dd dd_pow(struct dd base, struct dd exponent)
+{
+    if (exponent.lo == 0.0 && exponent.hi == trunc(exponent.hi) && fabs(exponent.hi) <= 0x1p53) {
+        return dd_pow_int(base, (int64_t)exponent.hi);
+    }
+
+    // Zero, negative and non-finite bases keep pow's special cases.
+    if (!(base.hi > 0.0) || !isfinite(base.hi)) {
+        return dd_from_double(pow(base.hi, exponent.hi));
+    }
+
+    return dd_exp(dd_mul(exponent, dd_log(base)));
+}
+
+struct dd dd_fmod(struct dd a, struct dd b)
+{
+    if (!isfinite(a.hi) || !isfinite(b.hi)) {
+        return dd_from_double(fmod(a.hi, b.hi));
+    }
+
+    struct dd quotient = dd_trunc(dd_div(a, b));
+    struct dd result = dd_sub(a, dd_mul(quotient, b));
+
+    // The quotient can be one off when a / b rounds across an integer, push the remainder back
+    // into (-|b|, |b|) with the sign of a by a step of copysign(|b|, a).
+    struct dd step = signbit(b.hi) == signbit(a.hi) ? b : dd_negate(b);
+
+    if (result.hi != 0.0 && signbit(result.hi) != signbit(a.hi)) {
+        result = dd_add(result, step);
+    } else if (fabs(result.hi) >= fabs(b.hi)) {
+        // Equal high parts leave the low parts to decide, which the sign of the difference shows.
+        struct dd reduced = dd_sub(result, step);
+
+        if (reduced.hi == 0.0 || signbit(reduced.hi) == signbit(a.hi)) {
+            result = reduced;
+        }
+    }
+
+    return result;
+}
+
+struct dd dd_from_literal(const struct literal *literal, double value)
+{
+    if (!literal->text) {
+        return dd_from_double(value);
+    }
+
+    struct bigint mantissa;
+    int64_t exponent = 0;
+    bigint_init(&mantissa);
+
+    if (!parse_decimal_literal(literal->text, literal->length, &mantissa, &exponent)) {
+        (void)fprintf(stderr, "Invalid number: %.*s\n", (int)literal->length, literal->text);
+        exit(EXIT_FAILURE);
+    }
+
+    struct dd result = dd_from_double(0.0);
+
+    for (size_t i = mantissa.size; i-- > 0;) {
+        result = dd_add(dd_mul_double(result, BIGINT_BASE), dd_from_double(mantissa.limbs[i]));
+    }
+
+    if (mantissa.negative) {
+        result = dd_negate(result);
+    }
+
+    bigint_free(&mantissa);
+
+    if (exponent == 0) {
+        return result;
+    }
+
+    struct dd scale = dd_pow_int(dd_from_double(10.0), exponent < 0 ? -exponent : exponent);
+    result = exponent < 0 ? dd_div(result, scale) : dd_mul(result, scale);
+
+    // Subnormal and huge literals overflow the power of ten, strtod already rounded those.
+    if (!isfinite(scale.hi) || !isfinite(result.hi)) {
+        return dd_from_double(value);
+    }
+
+    return result;
+}
+
+void dd_to_string(struct dd value, char *buffer, size_t size)
+{
+    if (!isfinite(value.hi) || value.hi == 0.0) {
+        (void)snprintf(buffer, size, "%g", value.hi);
+        return;
+    }
+
+    // Peel decimal digits off the normalized value, then round the last kept digit.
+    char digits[DD_DIGITS + 2];
+    bool negative = value.hi < 0.0;
+    struct dd x = negative ? dd_negate(value) : value;
+    int exponent = (int)floor(log10(x.hi));
+
+    // Scale in steps so 10^exponent never overflows for subnormal inputs.
+    for (int remaining = exponent; remaining != 0;) {
+        int step = remaining > 300 ? 300 : remaining < -300 ? -300 : remaining;
+        struct dd scale = dd_pow_int(dd_from_double(10.0), step < 0 ? -step : step);
+
+        x = step < 0 ? dd_mul(x, scale) : dd_div(x, scale);
+        remaining -= step;
+    }
+
+    if (x.hi >= 10.0) {
+        x = dd_div(x, dd_from_double(10.0));
+        exponent += 1;
+    } else if (x.hi < 1.0) {
+        x = dd_mul_double(x, 10.0);
+        exponent -= 1;
+    }
+
+    for (size_t i = 0; i < DD_DIGITS + 1; i++) {
+        double digit = floor(x.hi);
+
+        if (digit < 0.0) {
+            digit = 0.0;
+        } else if (digit > 9.0) {
+            digit = 9.0;
+        }
+
+        digits[i] = (char)('0' + (int)digit);
+        x = dd_mul_double(dd_sub(x, dd_from_double(digit)), 10.0);
+    }
+
+    if (digits[DD_DIGITS] >= '5') {
+        size_t i = DD_DIGITS;
+
+        while (i-- > 0) {
+            if (digits[i] != '9') {
+                digits[i] += 1;
+                break;
+            }
+
+            digits[i] = '0';
+        }
+
+        if (i == SIZE_MAX) {
+            digits[0] = '1';
+            exponent += 1;
+        }
+    }
+
+    size_t used = DD_DIGITS;
+    while (used > 1 && digits[used - 1] == '0') {
+        used -= 1;
+    }
+
+    digits[used] = '\0';
+
+    if (exponent >= -5 && exponent < DD_DIGITS) {
+        // Plain notation, the way %g would pick it.
+        char plain[DD_DIGITS * 2 + 8];
+        size_t length = 0;
+
+        if (exponent < 0) {
+            length += (size_t)sprintf(plain, "0.");
+            for (int i = -1; i > exponent; i--) {
+                plain[length++] = '0';
+            }
+            length += (size_t)sprintf(plain + length, "%s", digits);
+        } else {
+            for (size_t i = 0; i < used || i <= (size_t)exponent; i++) {
+                if (i == (size_t)exponent + 1) {
+                    plain[length++] = '.';
+                }
+                plain[length++] = i < used ? digits[i] : '0';
+            }
+            plain[length] = '\0';
+        }
+
+        (void)snprintf(buffer, size, "%s%s", negative ? "-" : "", plain);
+        return;
+    }
+
+    (void)snprintf(buffer, size, "%s%c%s%s%se%+d", negative ? "-" : "", digits[0],
+                   used > 1 ? "." : "", digits + 1, "", exponent);
+}
+
+struct dd dd_binary_op(enum opcode code, struct dd lhs, struct dd rhs)
+{
+    switch (code) {
+    case OP_ADD:
+        return dd_add(lhs, rhs);
+    case OP_SUBTRACT:
+        return dd_sub(lhs, rhs);
+    case OP_MULTIPLY:
+        return dd_mul(lhs, rhs);
+    case OP_DIVIDE:
+    case OP_MODULO: {
+        if (rhs.hi == 0.0) {
+            (void)fprintf(stderr, "Division by zero\n");
+            exit(EXIT_FAILURE);
+        }
+
+        return code == OP_DIVIDE ? dd_div(lhs, rhs) : dd_fmod(lhs, rhs);
+    }
+    case OP_POWER:
+        return dd_pow(lhs, rhs);
+    default: {
+        (void)fprintf(stderr, "Unsupported instruction in dd mode\n");
+        exit(EXIT_FAILURE);
+    }
+    }
+}
+
+struct dd run_dd_vm(struct dd_vm *dd_vm)
+{
+    struct chunk *chunks = dd_vm->chunks;
+    struct dd *constants = malloc((chunks->const_size + 1) * sizeof(*constants));
+    if (!constants) {
+        (void)fprintf(stderr, "Go download more ram\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < chunks->const_size; i++) {
+        constants[i] = dd_from_literal(&chunks->literals[i], chunks->constants[i]);
+    }
+
+    while (true) {
+        struct bytecode instruction = chunks->code[dd_vm->ip];
+
+        switch (instruction.code) {
+        case OP_CONSTANT: {
+            if (dd_vm->top >= MAX_STACK_SIZE) {
+                (void)fprintf(stderr, "Stack overflow\n");
+                exit(EXIT_FAILURE);
+            }
+
+            dd_vm->stack[dd_vm->top++] = constants[instruction.const_index];
+        } break;
+
+        case OP_NEGATE:
+        case OP_POW_INT: {
+            if (dd_vm->top < 1) {
+                (void)fprintf(stderr, "Stack undeflow\n");
+                exit(EXIT_FAILURE);
+            }
+
+            struct dd *value = &dd_vm->stack[dd_vm->top - 1];
+            *value = instruction.code == OP_NEGATE
+                         ? dd_negate(*value)
+                         : dd_pow_int(*value, (int64_t)instruction.operand);
+        } break;
+
+        case OP_ADD:
+        case OP_SUBTRACT:
+        case OP_MULTIPLY:
+        case OP_DIVIDE:
+        case OP_MODULO:
+        case OP_POWER: {
+            if (dd_vm->top < 2) {
+                (void)fprintf(stderr, "Stack undeflow\n");
+                exit(EXIT_FAILURE);
+            }
+
+            struct dd rhs = dd_vm->stack[--dd_vm->top];
+            struct dd *lhs = &dd_vm->stack[dd_vm->top - 1];
+
+            *lhs = dd_binary_op(instruction.code, *lhs, rhs);
+        } break;
+
+        case OP_HALT: {
+            if (dd_vm->top < 1) {
+                (void)fprintf(stderr, "Stack undeflow\n");
+                exit(EXIT_FAILURE);
+            }
+
+            free(constants);
+
+            return dd_vm->stack[--dd_vm->top];
+        }
+
+        default: {
+            (void)fprintf(stderr, "Unsupported instruction in dd mode\n");
+            exit(EXIT_FAILURE);
+        }
+        }
+
+        dd_vm->ip += 1;
+    }
+}
+
+struct dd eval_ast_dd(const struct ast_node *root)
+{
+    switch (root->type) {
+    case NODE_NUMBER: {
+        struct literal literal = { .text = root->data.number.lexeme,
+                                   .length = root->data.number.lexeme_length };
+
+        return dd_from_literal(&literal, root->data.number.value);
+    }
+
+    case NODE_UNARY: {
+        struct dd value = eval_ast_dd(root->data.unary.child);
+        return root->data.unary.op == MINUS ? dd_negate(value) : value;
+    }
+
+    case NODE_BINARY: {
+        int64_t exponent = 0;
+        if (root->data.binary.op == CARET &&
+            get_constant_exponent(root->data.binary.right, &exponent)) {
+            return dd_pow_int(eval_ast_dd(root->data.binary.left), exponent);
+        }
+
+        struct dd lhs = eval_ast_dd(root->data.binary.left);
+        struct dd rhs = eval_ast_dd(root->data.binary.right);
+
+        return dd_binary_op(get_opcode_from_token_kind(root->data.binary.op), lhs, rhs);
+    }
+
+    default: {
+        (void)fprintf(stderr, "Unsupported node in dd mode\n");
+        exit(EXIT_FAILURE);
+    }
+    }
+}
+
+void mod_init(struct mod_context *context, uint64_t modulus)
+{
+    context->modulus = modulus;
+    context->montgomery = (modulus & 1) != 0;
+    context->inverse = 0;
+    context->r2 = 0;
+
+    if (!context->montgomery) {
+        return;
+    }
+
+    // Newton's iteration doubles the correct low bits of P^-1 mod 2^64, starting from the 3 bits
+    // every odd P is its own inverse for.
+    uint64_t inverse = modulus;
+    for (int i = 0; i < 5; i++) {
+        inverse *= 2 - modulus * inverse;
+    }
+
+    uint64_t r = (uint64_t)(((unsigned __int128)1 << 64) % modulus);
+
+    context->inverse = inverse;
+    context->r2 = (uint64_t)((unsigned __int128)r * r % modulus);
+}
+
+uint64_t mod_mul(const struct mod_context *context, uint64_t a, uint64_t b)
+{
+    unsigned __int128 product = (unsigned __int128)a * b;
+
+    if (!context->montgomery) {
+        return (uint64_t)(product % context->modulus);
+    }
+
+    // Montgomery reduction in the subtracting form: m * P agrees with the product in the low 64
+    // bits, so the difference of the high halves is a * b / 2^64 mod P in (-P, P) and never
+    // overflows, even for P above 2^63.
+    uint64_t m = (uint64_t)product * context->inverse;
+    uint64_t high = (uint64_t)(product >> 64);
+    uint64_t correction = (uint64_t)(((unsigned __int128)m * context->modulus) >> 64);
+
+    return high >= correction ? high - correction : high - correction + context->modulus;
+}
+
+uint64_t mod_to(const struct mod_context *context, uint64_t value)
+{
+    return context->montgomery ? mod_mul(context, value, context->r2) : value;
+}
+
+uint64_t mod_from(const struct mod_context *context, uint64_t value)
+{
+    return context->montgomery ? mod_mul(context, value, 1) : value;
+}
+
+uint64_t mod_add(const struct mod_context *context, uint64_t a, uint64_t b)
+{
+    uint64_t sum = a + b;
+
+    return sum < a || sum >= context->modulus ? sum - context->modulus : sum;
+}
+
+uint64_t mod_sub(const struct mod_context *context, uint64_t a, uint64_t b)
+{
+    return a >= b ? a - b : a - b + context->modulus;
+}
+
+uint64_t mod_negate(const struct mod_context *context, uint64_t value)
+{
+    return value == 0 ? 0 : context->modulus - value;
+}
+
+uint64_t mod_inverse(const struct mod_context *context, uint64_t value)
+{
+    // Extended Euclid on the canonical residue, the coefficient is tracked mod P so it stays
+    // unsigned.
+    uint64_t a = mod_from(context, value);
+    uint64_t b = context->modulus;
+    uint64_t x = 1;
+    uint64_t y = 0;
+
+    while (b != 0) {
+        uint64_t quotient = a / b;
+        uint64_t remainder = a - quotient * b;
+        uint64_t next = mod_sub(context, x, (uint64_t)((unsigned __int128)quotient * y %
+                                                       context->modulus));
+
+        a = b;
+        b = remainder;
+        x = y;
+        y = next;
+    }
+
+    if (a != 1) {
+        (void)fprintf(stderr, "%" PRIu64 " is not invertible mod %" PRIu64 "\n",
+                      mod_from(context, value), context->modulus);
+        exit(EXIT_FAILURE);
+    }
+
+    return mod_to(context, x);
+}
+
+uint64_t mod_pow(const struct mod_context *context, uint64_t base, uint64_t exponent)
+{
+    uint64_t accumulator = mod_to(context, 1 % context->modulus);
+
+    while (exponent > 0) {
+        if (exponent & 1) {
+            accumulator = mod_mul(context, accumulator, base);
+        }
+
+        exponent >>= 1;
+
+        if (exponent > 0) {
+            base = mod_mul(context, base, base);
+        }
+    }
+
+    return accumulator;
+}
+
+uint64_t mod_power(const struct mod_context *context, uint64_t base,
+                   const struct mod_literal *literal)
+{
+    // An exact integer exponent is used as written. Anything else, e.g. after a / or a negative
+    // power, is only known as a residue mod P, which says nothing about the exponent, so it is
+    // rejected like %.
+    if (!literal->known) {
+        (void)fprintf(stderr, "Exponent must be an integer constant in mod mode\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (literal->too_large) {
+        (void)fprintf(stderr, "Exponent does not fit in 64 bits in mod mode\n");
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t result = mod_pow(context, base, literal->magnitude);
+
+    return literal->negative ? mod_inverse(context, result) : result;
+}
+
+uint64_t mod_from_literal(const struct mod_context *context, const struct literal *literal,
+                          struct mod_literal *exact)
+{
+    struct bigint value;
+    bigint_init(&value);
+    bigint_from_literal(&value, literal->text, literal->length);
+
+    uint64_t residue = 0;
+    for (size_t i = value.size; i-- > 0;) {
+        residue = (uint64_t)(((unsigned __int128)residue * BIGINT_BASE + value.limbs[i]) %
+                             context->modulus);
+    }
+
+    // The parser folds a leading minus into the literal, the residue above is of its magnitude.
+    exact->negative = value.negative;
+    exact->known = true;
+    value.negative = false;
+    exact->too_large = !bigint_to_uint(&value, &exact->magnitude);
+
+    bigint_free(&value);
+
+    return exact->negative ? mod_negate(context, mod_to(context, residue))
+                           : mod_to(context, residue);
+}
+
+struct mod_literal mod_exact_op(enum opcode code, const struct mod_literal *lhs,
+                                const struct mod_literal *rhs)
+{
+    // Follows the exact value next to the residue so 2 ^ 2 ^ 3 still knows its exponent is 8.
+    // Once an intermediate no longer fits, the result is only known to be too large.
+    struct mod_literal result = { .known = lhs->known && rhs->known };
+
+    if (!result.known) {
+        return result;
+    }
+
+    if (lhs->too_large || rhs->too_large) {
+        result.too_large = true;
+        return result;
+    }
+
+    switch (code) {
+    case OP_ADD:
+    case OP_SUBTRACT: {
+        bool rhs_negative = code == OP_SUBTRACT ? !rhs->negative : rhs->negative;
+        __int128 value = (lhs->negative ? -(__int128)lhs->magnitude : (__int128)lhs->magnitude) +
+                         (rhs_negative ? -(__int128)rhs->magnitude : (__int128)rhs->magnitude);
+
+        result.negative = value < 0;
+        unsigned __int128 magnitude =
+            value < 0 ? -(unsigned __int128)value : (unsigned __int128)value;
+        result.too_large = magnitude > UINT64_MAX;
+        result.magnitude = (uint64_t)magnitude;
+    } break;
+
+    case OP_MULTIPLY: {
+        result.negative = lhs->negative != rhs->negative;
+        result.too_large =
+            __builtin_mul_overflow(lhs->magnitude, rhs->magnitude, &result.magnitude);
+    } break;
+
+    case OP_POWER: {
+        // A negative power is an inverse, which is not an integer any more.
+        if (rhs->negative && rhs->magnitude > 0) {
+            return (struct mod_literal){ 0 };
+        }
+
+        uint64_t base = lhs->magnitude;
+        uint64_t exponent = rhs->magnitude;
+
+        result.negative = lhs->negative && (exponent & 1);
+        result.magnitude = 1;
+
+        // A base that overflows while bits remain would overflow the result as well.
+        while (exponent > 0 && !result.too_large) {
+            if (exponent & 1) {
+                result.too_large =
+                    __builtin_mul_overflow(result.magnitude, base, &result.magnitude);
+            }
+
+            exponent >>= 1;
+
+            if (exponent > 0) {
+                result.too_large = result.too_large || __builtin_mul_overflow(base, base, &base);
+            }
+        }
+    } break;
+
+    default:
+        return (struct mod_literal){ 0 };
+    }
+
+    result.negative = result.negative && result.magnitude > 0 && !result.too_large;
+
+    return result;
+}
+
+uint64_t mod_binary_op(const struct mod_context *context, enum opcode code, uint64_t lhs,
+                       uint64_t rhs, const struct mod_literal *rhs_literal)
+{
+    switch (code) {
+    case OP_ADD:
+        return mod_add(context, lhs, rhs);
+    case OP_SUBTRACT:
+        return mod_sub(context, lhs, rhs);
+    case OP_MULTIPLY:
+        return mod_mul(context, lhs, rhs);
+    case OP_DIVIDE:
+        return mod_mul(context, lhs, mod_inverse(context, rhs));
+    case OP_POWER:
+        return mod_power(context, lhs, rhs_literal);
+    case OP_MODULO: {
+        (void)fprintf(stderr, "The %% operator is not defined on residues\n");
+        exit(EXIT_FAILURE);
+    }
+    default: {
+        (void)fprintf(stderr, "Unsupported instruction in mod mode\n");
+        exit(EXIT_FAILURE);
+    }
+    }
+}
+
+uint64_t run_mod_vm(struct mod_vm *mod_vm)
+{
+    const struct mod_context *context = mod_vm->context;
+    struct chunk *chunks = mod_vm->chunks;
+    uint64_t *constants = malloc((chunks->const_size + 1) * sizeof(*constants));
+    struct mod_literal *exact = malloc((chunks->const_size + 1) * sizeof(*exact));
+    if (!constants || !exact) {
+        (void)fprintf(stderr, "Go download more ram\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < chunks->const_size; i++) {
+        constants[i] = mod_from_literal(context, &chunks->literals[i], &exact[i]);
+    }
+
+    while (true) {
+        struct bytecode instruction = chunks->code[mod_vm->ip];
+
+        switch (instruction.code) {
+        case OP_CONSTANT: {
+            if (mod_vm->top >= MAX_STACK_SIZE) {
+                (void)fprintf(stderr, "Stack overflow\n");
+                exit(EXIT_FAILURE);
+            }
+
+            mod_vm->literals[mod_vm->top] = exact[instruction.const_index];
+            mod_vm->stack[mod_vm->top++] = constants[instruction.const_index];
+        } break;
+
+        case OP_NEGATE: {
+            if (mod_vm->top < 1) {
+                (void)fprintf(stderr, "Stack undeflow\n");
+                exit(EXIT_FAILURE);
+            }
+
+            size_t top = mod_vm->top - 1;
+            mod_vm->stack[top] = mod_negate(context, mod_vm->stack[top]);
+            mod_vm->literals[top].negative = !mod_vm->literals[top].negative;
+        } break;
+
+        case OP_POW_INT: {
+            if (mod_vm->top < 1) {
+                (void)fprintf(stderr, "Stack undeflow\n");
+                exit(EXIT_FAILURE);
+            }
+
+            int64_t exponent = (int64_t)instruction.operand;
+            struct mod_literal literal = { .known = true,
+                                           .too_large = false,
+                                           .negative = exponent < 0,
+                                           .magnitude = exponent < 0 ? -(uint64_t)exponent
+                                                                     : (uint64_t)exponent };
+            size_t top = mod_vm->top - 1;
+
+            mod_vm->stack[top] = mod_power(context, mod_vm->stack[top], &literal);
+            mod_vm->literals[top] = mod_exact_op(OP_POWER, &mod_vm->literals[top], &literal);
+        } break;
+
+        case OP_ADD:
+        case OP_SUBTRACT:
+        case OP_MULTIPLY:
+        case OP_DIVIDE:
+        case OP_MODULO:
+        case OP_POWER: {
+            if (mod_vm->top < 2) {
+                (void)fprintf(stderr, "Stack undeflow\n");
+                exit(EXIT_FAILURE);
+            }
+
+            mod_vm->top -= 1;
+            size_t top = mod_vm->top - 1;
+
+            mod_vm->stack[top] =
+                mod_binary_op(context, instruction.code, mod_vm->stack[top],
+                              mod_vm->stack[top + 1], &mod_vm->literals[top + 1]);
+            mod_vm->literals[top] = mod_exact_op(instruction.code, &mod_vm->literals[top],
+                                                 &mod_vm->literals[top + 1]);
+        } break;
+
+        case OP_HALT: {
+            if (mod_vm->top < 1) {
+                (void)fprintf(stderr, "Stack undeflow\n");
+                exit(EXIT_FAILURE);
+            }
+
+            free(constants);
+            free(exact);
+
+            return mod_vm->stack[--mod_vm->top];
+        }
+
+        default: {
+            (void)fprintf(stderr, "Unsupported instruction in mod mode\n");
+            exit(EXIT_FAILURE);
+        }
+        }
+
+        mod_vm->ip += 1;
+    }
+}
+
+uint64_t eval_ast_mod(const struct ast_node *root, const struct mod_context *context,
+                      struct mod_literal *exact)
+{
+    // exact mirrors the VM's tracking of exact integer values.
+
+    switch (root->type) {
+    case NODE_NUMBER: {
+        struct literal literal = { .text = root->data.number.lexeme,
+                                   .length = root->data.number.lexeme_length };
+
+        return mod_from_literal(context, &literal, exact);
+    }
+
+    case NODE_UNARY: {
+        uint64_t value = eval_ast_mod(root->data.unary.child, context, exact);
+
+        if (root->data.unary.op == MINUS) {
+            exact->negative = !exact->negative;
+            return mod_negate(context, value);
+        }
+
+        return value;
+    }
+
+    case NODE_BINARY: {
+        int64_t exponent = 0;
+        struct mod_literal lhs_literal;
+        uint64_t lhs = eval_ast_mod(root->data.binary.left, context, &lhs_literal);
+
+        if (root->data.binary.op == CARET &&
+            get_constant_exponent(root->data.binary.right, &exponent)) {
+            struct mod_literal literal = { .known = true,
+                                           .too_large = false,
+                                           .negative = exponent < 0,
+                                           .magnitude = exponent < 0 ? -(uint64_t)exponent
+                                                                     : (uint64_t)exponent };
+
+            *exact = mod_exact_op(OP_POWER, &lhs_literal, &literal);
+            return mod_power(context, lhs, &literal);
+        }
+
+        struct mod_literal rhs_literal;
+        enum opcode code = get_opcode_from_token_kind(root->data.binary.op);
+        uint64_t rhs = eval_ast_mod(root->data.binary.right, context, &rhs_literal);
+
+        *exact = mod_exact_op(code, &lhs_literal, &rhs_literal);
+        return mod_binary_op(context, code, lhs, rhs, &rhs_literal);
+    }
+
+    default: {
+        (void)fprintf(stderr, "Unsupported node in mod mode\n");
+        exit(EXIT_FAILURE);
+    }
+    }
+}
+
+uint64_t now_ns(void)
+{
+    struct timespec time = { 0 };
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (uint64_t)time.tv_sec * 1000000000u + (uint64_t)time.tv_nsec;
+}
+
+uint64_t next_random(uint64_t *state)
+{
+    // xorshift64*, plenty for benchmark inputs.
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+void benchmark_bigint_multiplication(void)
+{
+    static const size_t digit_counts[] = { 10, 100, 1000, 10000, 100000, 1000000 };
+    static const char *names[] = { "schoolbook", "karatsuba", "toom-3" };
+    const uint64_t min_total_ns = 200000000u;
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+
+    printf("%-10s %16s %16s %16s\n", "digits", names[MUL_SCHOOLBOOK], names[MUL_KARATSUBA],
+           names[MUL_TOOM3]);
+
+    for (size_t d = 0; d < sizeof(digit_counts) / sizeof(*digit_counts); d++) {
+        size_t limbs = (digit_counts[d] + BIGINT_BASE_DIGITS - 1) / BIGINT_BASE_DIGITS;
+        struct bigint a;
+        struct bigint b;
+        struct bigint expected;
+        struct bigint product;
+        bigint_init(&a);
+        bigint_init(&b);
+        bigint_init(&expected);
+        bigint_init(&product);
+
+        bigint_reserve(&a, limbs);
+        bigint_reserve(&b, limbs);
+        for (size_t i = 0; i < limbs; i++) {
+            a.limbs[i] = (uint32_t)(next_random(&seed) % BIGINT_BASE);
+            b.limbs[i] = (uint32_t)(next_random(&seed) % BIGINT_BASE);
+        }
+        a.size = limbs;
+        b.size = limbs;
+        bigint_normalize(&a);
+        bigint_normalize(&b);
+
+        bigint_mul_with(&expected, &a, &b, MUL_TOOM3);
+        printf("%-10zu", digit_counts[d]);
+
+        for (int algorithm = MUL_SCHOOLBOOK; algorithm <= MUL_TOOM3; algorithm++) {
+            // Quadratic multiplication of a million digits takes minutes, leave it out.
+            if (algorithm == MUL_SCHOOLBOOK && digit_counts[d] > 100000) {
+                printf(" %16s", "-");
+                continue;
+            }
+
+            uint64_t start = now_ns();
+            uint64_t elapsed = 0;
+            size_t iterations = 0;
+
+            do {
+                bigint_mul_with(&product, &a, &b, (enum bigint_mul_algorithm)algorithm);
+                iterations += 1;
+                elapsed = now_ns() - start;
+            } while (elapsed < min_total_ns);
+
+            if (mag_compare(product.limbs, product.size, expected.limbs, expected.size) != 0) {
+                (void)fprintf(stderr, "%s produced a wrong product\n", names[algorithm]);
+                exit(EXIT_FAILURE);
+            }
+
+            printf(" %13.3f us", (double)elapsed / (double)iterations / 1000.0);
+        }
+
+        printf("\n");
+
+        bigint_free(&a);
+        bigint_free(&b);
+        bigint_free(&expected);
+        bigint_free(&product);
+    }
+}
+
+const char *rational_mode_obstacle(const struct ast_node *node, struct rational *value)
+{
+    // Evaluates like eval_ast_rational, but returns what run_rational_vm would exit on instead of
+    // exiting. NULL means value holds the result.
+    switch (node->type) {
+    case NODE_NUMBER: {
+        rational_from_literal(value, node->data.number.lexeme, node->data.number.lexeme_length);
+        return NULL;
+    }
+
+    case NODE_UNARY: {
+        const char *obstacle = rational_mode_obstacle(node->data.unary.child, value);
+
+        if (!obstacle && node->data.unary.op == MINUS) {
+            bigint_negate(&value->numerator);
+        }
+
+        return obstacle;
+    }
+
+    case NODE_BINARY: {
+        enum opcode code = get_opcode_from_token_kind(node->data.binary.op);
+        struct rational rhs;
+        rational_init(&rhs);
+
+        const char *obstacle = rational_mode_obstacle(node->data.binary.left, value);
+        obstacle = obstacle ? obstacle : rational_mode_obstacle(node->data.binary.right, &rhs);
+
+        if (!obstacle && (code == OP_DIVIDE || code == OP_MODULO) && rhs.numerator.size == 0) {
+            obstacle = "division by zero";
+        } else if (!obstacle && code == OP_POWER) {
+            uint64_t exponent = 0;
+            bool negative = rhs.numerator.negative;
+
+            rhs.numerator.negative = false;
+            if (!rational_is_integer(&rhs)) {
+                obstacle = "non-integer exponent";
+            } else if (!bigint_to_uint(&rhs.numerator, &exponent)) {
+                obstacle = "exponent too large";
+            } else if (negative && value->numerator.size == 0) {
+                obstacle = "division by zero";
+            }
+            rhs.numerator.negative = negative;
+        }
+
+        if (!obstacle) {
+            rational_binary_op(code, value, value, &rhs);
+        }
+
+        rational_free(&rhs);
+
+        return obstacle;
+    }
+
+    default:
+        return "rewritten by a pass";
+    }
+}
+
+const char *bigint_mode_obstacle(const struct ast_node *node, struct bigint *value,
+                                 bool *truncated)
+{
+    // The same for run_bigint_vm. truncated is set when / drops a remainder, where bigint stops
+    // agreeing with the other modes.
+    switch (node->type) {
+    case NODE_NUMBER: {
+        struct rational literal;
+        rational_init(&literal);
+        rational_from_literal(&literal, node->data.number.lexeme, node->data.number.lexeme_length);
+        bool integral = rational_is_integer(&literal);
+        rational_free(&literal);
+
+        if (!integral) {
+            return "not an integer expression";
+        }
+
+        bigint_from_literal(value, node->data.number.lexeme, node->data.number.lexeme_length);
+        return NULL;
+    }
+
+    case NODE_UNARY: {
+        const char *obstacle = bigint_mode_obstacle(node->data.unary.child, value, truncated);
+
+        if (!obstacle && node->data.unary.op == MINUS) {
+            bigint_negate(value);
+        }
+
+        return obstacle;
+    }
+
+    case NODE_BINARY: {
+        enum opcode code = get_opcode_from_token_kind(node->data.binary.op);
+        struct bigint rhs;
+        bigint_init(&rhs);
+
+        const char *obstacle = bigint_mode_obstacle(node->data.binary.left, value, truncated);
+        obstacle =
+            obstacle ? obstacle : bigint_mode_obstacle(node->data.binary.right, &rhs, truncated);
+
+        if (!obstacle && (code == OP_DIVIDE || code == OP_MODULO) && rhs.size == 0) {
+            obstacle = "division by zero";
+        } else if (!obstacle && code == OP_DIVIDE) {
+            struct bigint remainder;
+            bigint_init(&remainder);
+            bigint_divmod(NULL, &remainder, value, &rhs);
+            *truncated = *truncated || remainder.size > 0;
+            bigint_free(&remainder);
+        } else if (!obstacle && code == OP_POWER) {
+            uint64_t exponent = 0;
+
+            if (rhs.negative && rhs.size > 0) {
+                obstacle = "negative exponent";
+            } else if (!bigint_to_uint(&rhs, &exponent)) {
+                obstacle = "exponent too large";
+            }
+        }
+
+        if (!obstacle) {
+            bigint_binary_op(code, value, value, &rhs);
+        }
+
+        bigint_free(&rhs);
+
+        return obstacle;
+    }
+
+    default:
+        return "rewritten by a pass";
+    }
+}
+
+const char *exact_mode_obstacle(const struct ast_node *node, bool integers_only, bool *truncated)
+{
+    // The exact VMs exit on inputs they cannot represent, the benchmark evaluates the tree once up
+    // front instead and reports why. NULL means the tree is supported.
+    bool unused = false;
+    const char *obstacle = NULL;
+
+    if (integers_only) {
+        struct bigint value;
+        bigint_init(&value);
+        obstacle = bigint_mode_obstacle(node, &value, truncated ? truncated : &unused);
+        bigint_free(&value);
+    } else {
+        struct rational value;
+        rational_init(&value);
+        obstacle = rational_mode_obstacle(node, &value);
+        rational_free(&value);
+    }
+
+    return obstacle;
+}
+
+bool exact_mode_supported(const struct ast_node *node, bool integers_only)
+{
+    return exact_mode_obstacle(node, integers_only, NULL) == NULL;
+}
+
+void print_benchmark_row(const char *mode, uint64_t elapsed, size_t iterations, double baseline,
+                         const char *result)
+{
+    double per_run = (double)elapsed / (double)iterations;
+    size_t length = strlen(result);
+
+    printf("%-10s %14.1f %10.1fx  %.*s%s\n", mode, per_run, per_run / baseline,
+           length > 40 ? 40 : (int)length, result, length > 40 ? "..." : "");
+}
+
+void benchmark_numeric_modes(struct chunk *chunks, const struct ast_node *root)
+{
+    const uint64_t min_total_ns = 100000000u;
+    char text[64];
+    uint64_t start = 0;
+    uint64_t elapsed = 0;
+    size_t iterations = 0;
+
+    printf("%-10s %14s %11s  %s\n", "mode", "ns/eval", "vs f64", "result");
+
+    double number = 0.0;
+    start = now_ns();
+    iterations = 0;
+    do {
+        struct vm stack_vm = { .ip = 0, .top = 0, .chunks = chunks, .stack = { { 0 } } };
+        number = run_vm(&stack_vm).number;
+        iterations += 1;
+        elapsed = now_ns() - start;
+    } while (elapsed < min_total_ns);
+
+    double baseline = (double)elapsed / (double)iterations;
+    (void)snprintf(text, sizeof(text), "%.17g", number);
+    print_benchmark_row("f64", elapsed, iterations, baseline, text);
+
+    struct dd dd_result = { 0 };
+    start = now_ns();
+    iterations = 0;
+    do {
+        struct dd_vm dd_vm = { .chunks = chunks, .ip = 0, .top = 0 };
+        dd_result = run_dd_vm(&dd_vm);
+        iterations += 1;
+        elapsed = now_ns() - start;
+    } while (elapsed < min_total_ns);
+
+    dd_to_string(dd_result, text, sizeof(text));
+    print_benchmark_row("dd", elapsed, iterations, baseline, text);
+
+    bool truncated = false;
+    const char *rational_obstacle = exact_mode_obstacle(root, false, NULL);
+    const char *bigint_obstacle = exact_mode_obstacle(root, true, &truncated);
+
+    if (!rational_obstacle) {
+        struct rational result;
+        start = now_ns();
+        iterations = 0;
+        do {
+            if (iterations > 0) {
+                rational_free(&result);
+            }
+
+            struct rational_vm rational_vm = { .chunks = chunks, .ip = 0, .top = 0 };
+            run_rational_vm(&rational_vm, &result);
+            iterations += 1;
+            elapsed = now_ns() - start;
+        } while (elapsed < min_total_ns);
+
+        char *result_text = rational_to_string(&result);
+        print_benchmark_row("rational", elapsed, iterations, baseline, result_text);
+        free(result_text);
+        rational_free(&result);
+    } else {
+        printf("%-10s %14s %11s  %s\n", "rational", "-", "-", rational_obstacle);
+    }
+
+    if (!bigint_obstacle) {
+        struct bigint result;
+        start = now_ns();
+        iterations = 0;
+        do {
+            if (iterations > 0) {
+                bigint_free(&result);
+            }
+
+            struct bigint_vm bigint_vm = { .chunks = chunks, .ip = 0, .top = 0 };
+            run_bigint_vm(&bigint_vm, &result);
+            iterations += 1;
+            elapsed = now_ns() - start;
+        } while (elapsed < min_total_ns);
+
+        char *result_text = bigint_to_string(&result);
+        print_benchmark_row(truncated ? "bigint*" : "bigint", elapsed, iterations, baseline,
+                            result_text);
+        free(result_text);
+        bigint_free(&result);
+
+        if (truncated) {
+            printf("* / truncated a quotient, so bigint differs from the exact result\n");
+        }
+    } else {
+        printf("%-10s %14s %11s  %s\n", "bigint", "-", "-", bigint_obstacle);
+    }
+}
+
+void gen_flush(struct gen_state *gen)
+{
+    if (gen->size > 0 && fwrite(gen->buffer, 1, gen->size, gen->stream) != gen->size) {
+        (void)fprintf(stderr, "Could not write the generated expression\n");
+        exit(EXIT_FAILURE);
+    }
+
+    gen->size = 0;
+}
+
+void gen_write(struct gen_state *gen, const char *text, size_t length)
+{
+    if (gen->size + length > sizeof(gen->buffer)) {
+        gen_flush(gen);
+    }
+
+    memcpy(gen->buffer + gen->size, text, length);
+    gen->size += length;
+}
+
+void gen_write_digits(struct gen_state *gen, uint64_t value, size_t min_width)
+{
+    char digits[24];
+    size_t count = 0;
+
+    do {
+        digits[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0 || count < min_width);
+
+    char text[24];
+    for (size_t i = 0; i < count; i++) {
+        text[i] = digits[count - 1 - i];
+    }
+
+    gen_write(gen, text, count);
+}
+
+uint64_t gen_below(struct gen_state *gen, uint64_t bound)
+{
+    // Multiply-shift instead of %, the bias is negligible and there is no division per draw.
+    return (uint64_t)(((unsigned __int128)next_random(&gen->random) * bound) >> 64);
+}
+
+void gen_literal(struct gen_state *gen, bool nonzero)
+{
+    // Leading zeros are avoided so every literal reads the way a person would write it.
+    enum gen_literal_kind kind = gen->options->literal_kinds[gen_below(
+        gen, gen->options->literal_kind_count)];
+
+    if (gen->options->negative_literals && gen_below(gen, 4) == 0) {
+        gen_write(gen, "-", 1);
+    }
+
+    switch (kind) {
+    case GEN_LITERAL_INT: {
+        uint64_t limit = 1;
+        for (uint64_t digits = 1 + gen_below(gen, 6); digits > 0; digits--) {
+            limit *= 10;
+        }
+
+        gen_write_digits(gen, nonzero ? 1 + gen_below(gen, limit - 1) : gen_below(gen, limit), 1);
+    } break;
+
+    case GEN_LITERAL_DECIMAL: {
+        uint64_t fraction_digits = 1 + gen_below(gen, 6);
+        uint64_t limit = 1;
+        for (uint64_t i = 0; i < fraction_digits; i++) {
+            limit *= 10;
+        }
+
+        gen_write_digits(gen, gen_below(gen, 1000), 1);
+        gen_write(gen, ".", 1);
+        gen_write_digits(gen, nonzero ? 1 + gen_below(gen, limit - 1) : gen_below(gen, limit),
+                         fraction_digits);
+    } break;
+
+    case GEN_LITERAL_EXPONENT: {
+        uint64_t exponent = gen_below(gen, 41);
+
+        gen_write_digits(gen, 1 + gen_below(gen, 9), 1);
+        gen_write(gen, ".", 1);
+        gen_write_digits(gen, gen_below(gen, 1000), 3);
+        gen_write(gen, exponent < 20 ? "e-" : "e", exponent < 20 ? 2 : 1);
+        gen_write_digits(gen, exponent < 20 ? 20 - exponent : exponent - 20, 1);
+    } break;
+    }
+}
+
+char gen_operator(struct gen_state *gen, bool right_is_leaf)
+{
+    // /, % and ^ only ever get a literal on their right, so no subtree can evaluate to a zero
+    // divisor and exponents stay small.
+    const char *ops = gen->options->ops;
+    size_t count = 0;
+
+    for (const char *op = ops; *op != '\0'; op++) {
+        count += right_is_leaf || strchr("/%^", *op) == NULL;
+    }
+
+    if (count == 0) {
+        return 0;
+    }
+
+    size_t pick = gen_below(gen, count);
+
+    for (const char *op = ops;; op++) {
+        if (right_is_leaf || strchr("/%^", *op) == NULL) {
+            if (pick == 0) {
+                return *op;
+            }
+
+            pick -= 1;
+        }
+    }
+}
+
+int32_t gen_add_node(struct gen_state *gen, int32_t left, int32_t right)
+{
+    char op = gen_operator(gen, right == GEN_LEAF);
+
+    gen->nodes[gen->node_count] = (struct gen_node){ .op = op, .left = left, .right = right };
+
+    return (int32_t)gen->node_count++;
+}
+
+size_t gen_capacity(size_t depth)
+{
+    return depth >= 62 ? SIZE_MAX : (size_t)1 << depth;
+}
+
+int32_t gen_build(struct gen_state *gen, size_t leaves, size_t depth)
+{
+    if (leaves == 1) {
+        return GEN_LEAF;
+    }
+
+    size_t split = leaves / 2;
+
+    if (gen->options->shape == GEN_SHAPE_RANDOM) {
+        size_t capacity = gen_capacity(depth - 1);
+        size_t low = leaves - 1 < capacity ? 1 : leaves - capacity;
+        size_t high = leaves - 1 < capacity ? leaves - 1 : capacity;
+
+        split = low + gen_below(gen, high - low + 1);
+    }
+
+    int32_t left = gen_build(gen, split, depth - 1);
+    int32_t right = gen_build(gen, leaves - split, depth - 1);
+
+    return gen_add_node(gen, left, right);
+}
+
+int gen_precedence(char op)
+{
+    return op == '+' || op == '-' ? 1 : op == '^' ? 3 : 2;
+}
+
+void gen_print(struct gen_state *gen, int32_t root)
+{
+    // Iterative so left and right chains of any length print without deep recursion. Parens are
+    // emitted where the parser would otherwise regroup the tree, plus redundant ones at the
+    // requested density.
+    size_t top = 0;
+    struct gen_frame *stack = gen->frames;
+
+    if (root == GEN_LEAF) {
+        gen_literal(gen, false);
+        return;
+    }
+
+    stack[top++] = (struct gen_frame){ .node = root, .state = 0, .parens = false };
+
+    while (top > 0) {
+        struct gen_frame *frame = &stack[top - 1];
+        const struct gen_node *node = &gen->nodes[frame->node];
+        int32_t child = GEN_LEAF;
+        bool is_right = false;
+
+        if (frame->state == 0) {
+            if (frame->parens) {
+                gen_write(gen, "(", 1);
+            }
+
+            child = node->left;
+        } else if (frame->state == 1) {
+            char text[3] = { ' ', node->op, ' ' };
+            gen_write(gen, text, sizeof(text));
+
+            child = node->right;
+            is_right = true;
+        } else {
+            if (frame->parens) {
+                gen_write(gen, ")", 1);
+            }
+
+            top -= 1;
+            continue;
+        }
+
+        frame->state += 1;
+
+        if (child == GEN_LEAF) {
+            if (is_right && node->op == '^') {
+                gen_write_digits(gen, gen_below(gen, 4), 1);
+            } else {
+                gen_literal(gen, is_right && (node->op == '/' || node->op == '%'));
+            }
+
+            continue;
+        }
+
+        int parent = gen_precedence(node->op);
+        int precedence = gen_precedence(gen->nodes[child].op);
+        bool needed = precedence < parent ||
+                      (precedence == parent && (is_right ? node->op != '^' : node->op == '^'));
+        bool extra = gen->options->paren_density > 0.0 &&
+                     (double)gen_below(gen, 1u << 30) < gen->options->paren_density * (1u << 30);
+
+        stack[top++] = (struct gen_frame){ .node = child, .state = 0, .parens = needed || extra };
+    }
+}
+
+void generate_expressions(const struct gen_options *options, FILE *stream)
+{
+    size_t leaves = options->size;
+    size_t depth = options->depth > 0 ? options->depth : 64;
+
+    if (leaves == 0 || leaves > GEN_MAX_SIZE) {
+        (void)fprintf(stderr, "Generator size must be between 1 and %d\n", GEN_MAX_SIZE);
+        exit(EXIT_FAILURE);
+    }
+
+    // A mix of only /, % and ^ cannot put a subtree on the right, so it always grows a left chain.
+    enum gen_shape shape = strspn(options->ops, "/%^") == strlen(options->ops) ? GEN_SHAPE_LEFT
+                                                                               : options->shape;
+    bool is_chain = shape == GEN_SHAPE_LEFT || shape == GEN_SHAPE_RIGHT;
+    if ((is_chain && options->depth > 0 && options->depth < leaves - 1) ||
+        (!is_chain && gen_capacity(depth) < leaves)) {
+        (void)fprintf(stderr, "%zu literals do not fit in depth %zu\n", leaves, depth);
+        exit(EXIT_FAILURE);
+    }
+
+    struct gen_state *gen = malloc(sizeof(*gen));
+    if (!gen) {
+        (void)fprintf(stderr, "Go download more ram\n");
+        exit(EXIT_FAILURE);
+    }
+
+    gen->options = options;
+    gen->stream = stream;
+    gen->size = 0;
+    gen->random = options->seed * 0x9E3779B97F4A7C15ULL + 0x2545F4914F6CDD1DULL;
+    gen->random = gen->random != 0 ? gen->random : 1;
+    gen->nodes = malloc(leaves * sizeof(*gen->nodes));
+    gen->frames = malloc(leaves * sizeof(*gen->frames));
+
+    if (!gen->nodes || !gen->frames) {
+        (void)fprintf(stderr, "Go download more ram\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t expression = 0; expression < options->count; expression++) {
+        int32_t root = GEN_LEAF;
+        gen->node_count = 0;
+
+        if (shape == GEN_SHAPE_LEFT) {
+            for (size_t i = 1; i < leaves; i++) {
+                root = gen_add_node(gen, root, GEN_LEAF);
+            }
+        } else if (shape == GEN_SHAPE_RIGHT) {
+            for (size_t i = 1; i < leaves; i++) {
+                root = gen_add_node(gen, GEN_LEAF, root);
+            }
+        } else {
+            root = gen_build(gen, leaves, depth);
+        }
+
+        gen_print(gen, root);
+        gen_write(gen, "\n", 1);
+    }
+
+    gen_flush(gen);
+    free(gen->nodes);
+    free(gen->frames);
+    free(gen);
+}
+
+void parse_gen_spec(char *spec, struct gen_options *options)
+{
+    // --gen=size=1000,shape=left,ops=+-*,literals=int:exponent:negative,seed=7
+    static char *const keys[] = { "size",  "depth", "shape", "ops",   "literals",
+                                  "parens", "seed", "count", NULL };
+    char *value = NULL;
+
+    while (spec && *spec != '\0') {
+        int key = getsubopt(&spec, keys, &value);
+
+        if (key < 0 || !value) {
+            (void)fprintf(stderr, "Unknown or empty generator option '%s'\n", value ? value : "");
+            exit(EXIT_FAILURE);
+        }
+
+        switch (key) {
+        case 0:
+        case 1:
+        case 6:
+        case 7: {
+            char *end = NULL;
+            errno = 0;
+            unsigned long long number = strtoull(value, &end, 10);
+
+            if (errno == ERANGE || end == value || *end != '\0' || !isdigit((unsigned char)*value)) {
+                (void)fprintf(stderr, "Invalid generator number '%s'\n", value);
+                exit(EXIT_FAILURE);
+            }
+
+            if (key == 0) {
+                options->size = (size_t)number;
+            } else if (key == 1) {
+                options->depth = (size_t)number;
+            } else if (key == 6) {
+                options->seed = (uint64_t)number;
+            } else {
+                options->count = (size_t)number;
+            }
+        } break;
+
+        case 2: {
+            static const char *shapes[] = { "random", "left", "right", "balanced" };
+            size_t shape = 0;
+
+            while (shape < 4 && strcmp(value, shapes[shape]) != 0) {
+                shape += 1;
+            }
+
+            if (shape == 4) {
+                (void)fprintf(stderr, "Unknown shape '%s'\n", value);
+                exit(EXIT_FAILURE);
+            }
+
+            options->shape = (enum gen_shape)shape;
+        } break;
+
+        case 3: {
+            if (*value == '\0' || strspn(value, "+-*/%^") != strlen(value)) {
+                (void)fprintf(stderr, "Operators must be a mix of + - * / %% ^\n");
+                exit(EXIT_FAILURE);
+            }
+
+            options->ops = value;
+        } break;
+
+        case 4: {
+            options->literal_kind_count = 0;
+            options->negative_literals = false;
+
+            for (char *kind = strtok(value, ":"); kind; kind = strtok(NULL, ":")) {
+                // Repeating a kind weights it, e.g. int:int:decimal.
+                if (options->literal_kind_count == GEN_MAX_LITERAL_KINDS) {
+                    (void)fprintf(stderr, "At most %d literal kinds\n", GEN_MAX_LITERAL_KINDS);
+                    exit(EXIT_FAILURE);
+                }
+
+                if (strcmp(kind, "negative") == 0) {
+                    options->negative_literals = true;
+                } else if (strcmp(kind, "int") == 0) {
+                    options->literal_kinds[options->literal_kind_count++] = GEN_LITERAL_INT;
+                } else if (strcmp(kind, "decimal") == 0) {
+                    options->literal_kinds[options->literal_kind_count++] = GEN_LITERAL_DECIMAL;
+                } else if (strcmp(kind, "exponent") == 0) {
+                    options->literal_kinds[options->literal_kind_count++] = GEN_LITERAL_EXPONENT;
+                } else {
+                    (void)fprintf(stderr, "Unknown literal kind '%s'\n", kind);
+                    exit(EXIT_FAILURE);
+                }
+            }
+
+            if (options->literal_kind_count == 0) {
+                options->literal_kinds[options->literal_kind_count++] = GEN_LITERAL_INT;
+            }
+        } break;
+
+        case 5: {
+            char *end = NULL;
+            double density = strtod(value, &end);
+
+            if (end == value || *end != '\0' || !(density >= 0.0 && density <= 1.0)) {
+                (void)fprintf(stderr, "Paren density must be between 0 and 1\n");
+                exit(EXIT_FAILURE);
+            }
+
+            options->paren_density = density;
+        } break;
+
+        default:
+            break;
+        }
+    }
+}
+
+char *get_poly_scheme_string(enum poly_scheme scheme)
+{
+    switch (scheme) {
+    case POLY_HORNER_FMA:
+        return "horner-fma";
+    case POLY_ESTRIN:
+        return "estrin";
+    default:
+        return "horner";
+    }
+}
+
+char *get_token_kind_string(enum token_kind kind)
+{
+    switch (kind) {
+    case MINUS:
+        return "-";
+    case PLUS:
+        return "+";
+    case SLASH:
+        return "/";
+    case STAR:
+        return "*";
+    case CARET:
+        return "expt";
+    case PERCENT:
+        return "mod";
+    case SQRT:
+        return "sqrt";
+    default:
+        return "?";
+    }
+}
+
+void print_indent(size_t level)
+{
+    for (size_t i = 0; i < level; i++) {
+        printf(" ");
+    }
+}
+
+void print_ast_json(const struct ast_node *node, size_t level)
+{
+    if (!node) {
+        printf("null");
+        return;
+    }
+
+    size_t indent = level * 2;
+
+    switch (node->type) {
+    case NODE_NUMBER: {
+        printf("{\n");
+        print_indent(indent + 2);
+        printf("\"type\": \"number\",\n");
+        print_indent(indent + 2);
+        if (node->data.number.is_integer) {
+            printf("\"value\": %" PRId64 ",\n", node->data.number.integer);
+        } else {
+            printf("\"value\": %g,\n", node->data.number.value);
+        }
+        print_indent(indent + 2);
+        printf("\"start\": %zu,\n", node->start);
+        print_indent(indent + 2);
+        printf("\"end\": %zu\n", node->end);
+        print_indent(indent);
+        printf("}");
+    } break;
+
+    case NODE_UNARY: {
+        printf("{\n");
+        print_indent(indent + 2);
+        printf("\"type\": \"unary\",\n");
+        print_indent(indent + 2);
+        printf("\"op\": \"%s\",\n", get_token_kind_string(node->data.unary.op));
+        print_indent(indent + 2);
+        printf("\"start\": %zu,\n", node->start);
+        print_indent(indent + 2);
+        printf("\"end\": %zu,\n", node->end);
+        print_indent(indent + 2);
+        printf("\"child\": ");
+        print_ast_json(node->data.unary.child, level + 1);
+        printf("\n");
+        print_indent(indent);
+        printf("}");
+    } break;
+
+    case NODE_BINARY: {
+        printf("{\n");
+        print_indent(indent + 2);
+        printf("\"type\": \"binary\",\n");
+        print_indent(indent + 2);
+        printf("\"op\": \"%s\",\n", get_token_kind_string(node->data.binary.op));
+        print_indent(indent + 2);
+        printf("\"start\": %zu,\n", node->start);
+        print_indent(indent + 2);
+        printf("\"end\": %zu,\n", node->end);
+        print_indent(indent + 2);
+        printf("\"left\": ");
+        print_ast_json(node->data.binary.left, level + 1);
+        printf(",\n");
+        print_indent(indent + 2);
+        printf("\"right\": ");
+        print_ast_json(node->data.binary.right, level + 1);
+        printf("\n");
+        print_indent(indent);
+        printf("}");
+    } break;
+
+    case NODE_SUM: {
+        printf("{\n");
+        print_indent(indent + 2);
+        printf("\"type\": \"sum\",\n");
+        print_indent(indent + 2);
+        printf("\"mode\": \"%s\",\n",
+               node->data.sum.mode == SUM_COMPENSATED ? "kahan" : "pairwise");
+        print_indent(indent + 2);
+        printf("\"start\": %zu,\n", node->start);
+        print_indent(indent + 2);
+        printf("\"end\": %zu,\n", node->end);
+        print_indent(indent + 2);
+        printf("\"terms\": [");
+
+        for (size_t i = 0; i < node->data.sum.count; i++) {
+            printf(i == 0 ? "\n" : ",\n");
+            print_indent(indent + 4);
+            print_ast_json(node->data.sum.terms[i], level + 2);
+        }
+
+        printf("\n");
+        print_indent(indent + 2);
+        printf("]\n");
+        print_indent(indent);
+        printf("}");
+    } break;
+
+    case NODE_FMA: {
+        printf("{\n");
+        print_indent(indent + 2);
+        printf("\"type\": \"%s\",\n", node->data.fma.subtract ? "fms" : "fma");
+        print_indent(indent + 2);
+        printf("\"start\": %zu,\n", node->start);
+        print_indent(indent + 2);
+        printf("\"end\": %zu,\n", node->end);
+        print_indent(indent + 2);
+        printf("\"multiplicand\": ");
+        print_ast_json(node->data.fma.multiplicand, level + 1);
+        printf(",\n");
+        print_indent(indent + 2);
+        printf("\"multiplier\": ");
+        print_ast_json(node->data.fma.multiplier, level + 1);
+        printf(",\n");
+        print_indent(indent + 2);
+        printf("\"addend\": ");
+        print_ast_json(node->data.fma.addend, level + 1);
+        printf("\n");
+        print_indent(indent);
+        printf("}");
+    } break;
+
+    case NODE_POLY: {
+        printf("{\n");
+        print_indent(indent + 2);
+        printf("\"type\": \"%s\",\n", get_poly_scheme_string(node->data.poly.scheme));
+        print_indent(indent + 2);
+        printf("\"start\": %zu,\n", node->start);
+        print_indent(indent + 2);
+        printf("\"end\": %zu,\n", node->end);
+        print_indent(indent + 2);
+        printf("\"coefficients\": [");
+
+        for (size_t i = 0; i <= node->data.poly.degree; i++) {
+            printf(i == 0 ? "%g" : ", %g", node->data.poly.coefficients[i]);
+        }
+
+        printf("],\n");
+        print_indent(indent + 2);
+        printf("\"base\": ");
+        print_ast_json(node->data.poly.base, level + 1);
+        printf("\n");
+        print_indent(indent);
+        printf("}");
+    } break;
+    }
+}
+
+void print_ast(const struct ast_node *node)
+{
+    if (!node) {
+        return;
+    }
+
+    switch (node->type) {
+    case NODE_NUMBER: {
+        if (node->data.number.is_integer) {
+            printf("%" PRId64, node->data.number.integer);
+        } else {
+            printf("%g", node->data.number.value);
+        }
+    } break;
+
+    case NODE_UNARY: {
+        printf("(%s ", get_token_kind_string(node->data.unary.op));
+        print_ast(node->data.unary.child);
+        printf(")");
+    } break;
+
+    case NODE_BINARY: {
+        printf("(%s ", get_token_kind_string(node->data.binary.op));
+        print_ast(node->data.binary.left);
+        printf(" ");
+        print_ast(node->data.binary.right);
+        printf(")");
+    } break;
+
+    case NODE_SUM: {
+        printf("(sum");
+
+        for (size_t i = 0; i < node->data.sum.count; i++) {
+            printf(" ");
+            print_ast(node->data.sum.terms[i]);
+        }
+
+        printf(")");
+    } break;
+
+    case NODE_FMA: {
+        printf("(%s ", node->data.fma.subtract ? "fms" : "fma");
+        print_ast(node->data.fma.multiplicand);
+        printf(" ");
+        print_ast(node->data.fma.multiplier);
+        printf(" ");
+        print_ast(node->data.fma.addend);
+        printf(")");
+    } break;
+
+    case NODE_POLY: {
+        printf("(%s ", get_poly_scheme_string(node->data.poly.scheme));
+        print_ast(node->data.poly.base);
+
+        for (size_t i = 0; i <= node->data.poly.degree; i++) {
+            printf(" %g", node->data.poly.coefficients[i]);
+        }
+
+        printf(")");
+    } break;
+    }
+}
+
+uint8_t get_left_binding_power(enum token_kind kind)
+{
+    switch (kind) {
+    case PLUS:
+    case MINUS:
+        return 1;
+    case STAR:
+    case SLASH:
+    case PERCENT:
+        return 2;
+    case CARET:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+uint8_t get_right_binding_power(enum token_kind kind)
+{
+    switch (kind) {
+    case PLUS:
+    case MINUS:
+        return 1;
+    case STAR:
+    case SLASH:
+    case PERCENT:
+        return 2;
+    case CARET:
+        return 3;
+    default:
+        return 0;
+    }
+}
+
+struct ast_node *create_ast_node(enum node_type type, union node_data data, size_t start,
+                                 size_t end)
+{
+    struct ast_node *node = TRACKED_MALLOC(ALLOC_AST, sizeof(struct ast_node));
+    if (!node) {
+        (void)fprintf(stderr, "Go download more ram\n");
+        exit(EXIT_FAILURE);
+    }
+
+    node->type = type;
+    node->value_type = VALUE_DOUBLE;
+    node->start = start;
+    node->end = end;
+    node->data = data;
+
+    return node;
+}
+
+struct token get_next_token(struct parser *parser)
+{
+    if (parser->tokens[parser->current_index].kind == END_OF_FILE) {
+        (void)fprintf(stderr, "EOF\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return parser->tokens[parser->current_index++];
+}
+
+struct ast_node *parse(struct lexer *lex)
+{
+    struct parser parser =
+        (struct parser){ .tokens = lex->tokens, .size = lex->size, .current_index = 0 };
+
+    return parse_expression(&parser, 0);
+}
+
+void check_ast_depth(const struct ast_node *root)
+{
+    // Every pass, evaluator and free recurses on the tree, so a tree deeper than the C stack
+    // allows is turned away here; the walk itself uses a work list.
+    size_t capacity = DEFAULT_CAPACITY;
+    size_t size = 0;
+    struct depth_work_item *work = malloc(capacity * sizeof(*work));
+
+    if (!work) {
+        (void)fprintf(stderr, "Go download more ram\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (root) {
+        work[size++] = (struct depth_work_item){ .node = root, .depth = 1 };
+    }
+
+    while (size > 0) {
+        struct depth_work_item item = work[--size];
+        const struct ast_node *node = item.node;
+        const struct ast_node *children[3] = { NULL, NULL, NULL };
+        struct ast_node *const *terms = NULL;
+        size_t term_count = 0;
+
+        if (item.depth > MAX_AST_DEPTH) {
+            (void)fprintf(stderr,
+                          "Expression nests deeper than %d levels, --sum folds long + chains\n",
+                          MAX_AST_DEPTH);
+            exit(EXIT_FAILURE);
+        }
+
+        switch (node->type) {
+        case NODE_NUMBER:
+            break;
+        case NODE_UNARY:
+            children[0] = node->data.unary.child;
+            break;
+        case NODE_BINARY:
+            children[0] = node->data.binary.left;
+            children[1] = node->data.binary.right;
+            break;
+        case NODE_SUM:
+            terms = node->data.sum.terms;
+            term_count = node->data.sum.count;
+            break;
+        case NODE_FMA:
+            children[0] = node->data.fma.multiplicand;
+            children[1] = node->data.fma.multiplier;
+            children[2] = node->data.fma.addend;
+            break;
+        case NODE_POLY:
+            children[0] = node->data.poly.base;
+            break;
+        }
+
+        while (size + 3 + term_count >= capacity) {
+            work = grow_array(work, &capacity, size + 3 + term_count, sizeof(*work));
+        }
+
+        for (size_t i = 0; i < 3 && children[i]; i++) {
+            work[size++] = (struct depth_work_item){ .node = children[i], .depth = item.depth + 1 };
+        }
+        for (size_t i = 0; i < term_count; i++) {
+            work[size++] = (struct depth_work_item){ .node = terms[i], .depth = item.depth + 1 };
+        }
+    }
+
+    free(work);
+}
+
+struct ast_node *parse_expression(struct parser *parser, uint8_t binding_power)
+{
+    if (parser->tokens[parser->current_index].kind == END_OF_FILE) {
+        return NULL;
+    }
+
+    // Left-deep chains loop below, only parentheses, prefix operators and right operands recurse.
+    if (++parser->depth > MAX_AST_DEPTH) {
+        (void)fprintf(stderr, "Expression nests deeper than %d levels\n", MAX_AST_DEPTH);
+        exit(EXIT_FAILURE);
+    }
+
+    struct token tok = get_next_token(parser);
+    struct ast_node *lhs = parse_prefix(parser, &tok);
+
+    if (!lhs) {
+        (void)fprintf(stderr, "Expected left hand side\n");
+        exit(EXIT_FAILURE);
+    }
+
+    while (parser->tokens[parser->current_index].kind != END_OF_FILE) {
+        struct token next = parser->tokens[parser->current_index];
+
+        uint8_t left_binding_power = get_left_binding_power(next.kind);
+        if (left_binding_power <= binding_power) {
+            break;
+        }
+
+        struct token operator = get_next_token(parser);
+        uint8_t right_binding_power = get_right_binding_power(operator.kind);
+
+        struct ast_node *rhs = parse_expression(parser, right_binding_power);
+
+        if (!rhs) {
+            (void)fprintf(stderr, "Expected right hand side\n");
+            exit(EXIT_FAILURE);
+        }
+
+        lhs = create_ast_node(NODE_BINARY,
+                              (union node_data){ .binary.left = lhs,
+                                                 .binary.right = rhs,
+                                                 .binary.op = operator.kind },
+                              lhs->start, rhs->end);
+    }
+
+    parser->depth -= 1;
+
+    return lhs;
+}
+
+struct ast_node *parse_prefix(struct parser *parser, const struct token *token)
+{
+    if (token->kind == NUMBER) {
+        return create_ast_node(NODE_NUMBER,
+                               (union node_data){ .number.value = token->value.number_value,
+                                                  .number.is_integer = token->is_integer,
+                                                  .number.integer = token->integer_value,
+                                                  .number.lexeme = token->lexeme,
+                                                  .number.lexeme_length =
+                                                      token->end - token->start + 1 },
+                               token->start, token->end);
+    }
+
+    if (token->kind == MINUS) {
+        struct ast_node *rhs = parse_expression(parser, UNARY_DEFAULT);
+
+        if (!rhs) {
+            (void)fprintf(stderr, "Expected right hand side\n");
+            exit(EXIT_FAILURE);
+        }
+
+        return create_ast_node(NODE_UNARY,
+                               (union node_data){ .unary.child = rhs, .unary.op = token->kind },
+                               token->start, token->end);
+    }
+
+    if (token->kind == PLUS) {
+        struct ast_node *rhs = parse_expression(parser, UNARY_DEFAULT);
+
+        if (!rhs) {
+            (void)fprintf(stderr, "Expected right hand side\n");
+            exit(EXIT_FAILURE);
+        }
+
+        return create_ast_node(NODE_UNARY,
+                               (union node_data){ .unary.child = rhs, .unary.op = token->kind },
+                               token->start, token->end);
+    }
+
+    if (token->kind == LPAREN) {
+        struct ast_node *expr = parse_expression(parser, 0);
+
+        if (!expr) {
+            (void)fprintf(stderr, "Expected expression\n");
+            exit(EXIT_FAILURE);
+        }
+
+        struct token tok = get_next_token(parser);
+
+        if (tok.kind != RPAREN) {
+            (void)fprintf(stderr, "Expected ')' at position %zu\n", tok.start);
+            exit(EXIT_FAILURE);
+        }
+
+        return expr;
+    }
+
+    (void)fprintf(stderr, "Invalid prefix token\n");
+    exit(EXIT_FAILURE);
+}
+
+void free_ast_node(struct ast_node *node)
+{
+    if (!node) {
+        return;
+    }
+
+    switch (node->type) {
+    case NODE_NUMBER:
+        break;
     case NODE_UNARY: {
-        printf("{\n");
-        print_indent(indent + 2);
-        printf("\"type\": \"unary\",\n");
-        print_indent(indent + 2);
-        printf("\"op\": \"%s\",\n", get_token_kind_string(node->data.unary.op));
-        print_indent(indent + 2);
-        printf("\"start\": %zu,\n", node->start);
-        print_indent(indent + 2);
-        printf("\"end\": %zu,\n", node->end);
-        print_indent(indent + 2);
-        printf("\"child\": ");
-        print_ast_json(node->data.unary.child, level + 1);
-        printf("\n");
-        print_indent(indent);
-        printf("}");
+        free_ast_node(node->data.unary.child);
+    } break;
+    case NODE_BINARY: {
+        free_ast_node(node->data.binary.left);
+        free_ast_node(node->data.binary.right);
+    } break;
+    case NODE_SUM: {
+        for (size_t i = 0; i < node->data.sum.count; i++) {
+            free_ast_node(node->data.sum.terms[i]);
+        }
+
+        free(node->data.sum.terms);
+    } break;
+    case NODE_FMA: {
+        free_ast_node(node->data.fma.multiplicand);
+        free_ast_node(node->data.fma.multiplier);
+        free_ast_node(node->data.fma.addend);
     } break;
+    case NODE_POLY: {
+        free_ast_node(node->data.poly.base);
+        free(node->data.poly.coefficients);
+    } break;
+    }
+
+    TRACKED_FREE(ALLOC_AST, node);
+}
+
+void free_tokens(struct token *tokens)
+{
+    if (!tokens) {
+        return;
+    }
+
+    TRACKED_FREE(ALLOC_LEXER, tokens);
+}
+
+void append_token(struct lexer *lex, struct token tok)
+{
+    if (lex->size >= lex->capacity) {
+        lex->capacity *= 2;
+        struct token *new_tokens =
+            TRACKED_REALLOC(ALLOC_LEXER, lex->tokens, lex->capacity * sizeof(*lex->tokens));
+
+        if (!new_tokens) {
+            (void)fprintf(stderr, "Go download more ram\n");
+            exit(EXIT_FAILURE);
+        }
+
+        lex->tokens = new_tokens;
+    }
+
+    lex->tokens[lex->size++] = tok;
+}
+
+struct token create_token(enum token_kind kind, union token_value value, size_t start, size_t end)
+{
+    return (struct token){ .kind = kind, .value = value, .start = start, .end = end };
+}
+
+void init_lexer(struct lexer *lex)
+{
+    lex->cursor = 0;
+    lex->capacity = DEFAULT_CAPACITY;
+    lex->size = 0;
+    lex->tokens = TRACKED_MALLOC(ALLOC_LEXER, lex->capacity * sizeof(*lex->tokens));
+
+    if (!lex->tokens) {
+        (void)fprintf(stderr, "Go download more ram\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+bool is_part_of_number(char character)
+{
+    return isdigit(character) || character == '.' || character == 'e' || character == 'E' ||
+           character == '+' || character == '-';
+}
+
+void parse_number(struct lexer *lex, const char *source)
+{
+    size_t source_len = lex->source_len;
+    size_t start = lex->cursor;
+
+    while (lex->cursor < source_len && is_part_of_number(source[lex->cursor]) &&
+           !isspace(source[lex->cursor])) {
+        lex->cursor += 1;
+    }
+
+    size_t digits_len = lex->cursor - start;
+
+    if (!digits_len) {
+        (void)fprintf(stderr, "Invalid character at position %zu", lex->cursor);
+        exit(EXIT_FAILURE);
+    }
+
+    char *digits = TRACKED_MALLOC(ALLOC_LEXER, digits_len + 1);
+    if (!digits) {
+        (void)fprintf(stderr, "Go download more ram\n");
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(digits, source + start, digits_len);
+    digits[digits_len] = '\0';
+
+    errno = 0;
+    char *end = NULL;
+    double val = strtod(digits, &end);
+
+    if ((errno == ERANGE && !lex->allow_out_of_range) || *end != '\0') {
+        (void)fprintf(stderr, "Invalid or out of range number: %s\n", digits);
+        exit(EXIT_FAILURE);
+    }
+
+    struct token tok = create_token(NUMBER, (union token_value){ .number_value = val }, start,
+                                    start + digits_len - 1);
+    tok.lexeme = source + start;
+
+    size_t first_digit = digits[0] == '-' || digits[0] == '+' ? 1 : 0;
+    bool all_digits = digits_len > first_digit;
+
+    for (size_t i = first_digit; i < digits_len && all_digits; i++) {
+        all_digits = isdigit(digits[i]);
+    }
+
+    if (all_digits) {
+        errno = 0;
+        long long integer = strtoll(digits, &end, 10);
+
+        tok.is_integer = errno != ERANGE && *end == '\0';
+        tok.integer_value = integer;
+    }
+
+    append_token(lex, tok);
+    TRACKED_FREE(ALLOC_LEXER, digits);
+}
+
+void tokenize(struct lexer *lex, const char *source)
+{
+    size_t source_len = strlen(source);
+    lex->source_len = source_len;
+
+    while (lex->cursor < source_len) {
+        size_t cursor = lex->cursor;
+        char character = source[cursor];
+
+        if (isspace(character)) {
+            lex->cursor += 1;
+            continue;
+        }
+
+        union token_value value = (union token_value){ .value = character };
+
+        switch (character) {
+        case '-': {
+            if (cursor + 1 < source_len && isdigit(source[cursor + 1])) {
+                parse_number(lex, source);
+                continue;
+            }
+
+            append_token(lex, create_token(MINUS, value, cursor, cursor));
+        } break;
+
+        case '+': {
+            append_token(lex, create_token(PLUS, value, cursor, cursor));
+        } break;
+
+        case '*': {
+            append_token(lex, create_token(STAR, value, cursor, cursor));
+        } break;
+
+        case '/': {
+            append_token(lex, create_token(SLASH, value, cursor, cursor));
+        } break;
+
+        case '%': {
+            append_token(lex, create_token(PERCENT, value, cursor, cursor));
+        } break;
+
+        case '^': {
+            append_token(lex, create_token(CARET, value, cursor, cursor));
+        } break;
+
+        case '(': {
+            append_token(lex, create_token(LPAREN, value, cursor, cursor));
+        } break;
+
+        case ')': {
+            append_token(lex, create_token(RPAREN, value, cursor, cursor));
+        } break;
+
+        default: {
+            if (isdigit(character)) {
+                parse_number(lex, source);
+                continue;
+            }
+
+            (void)fprintf(stderr, "Unknown token '%c' at position %zu\n", character, lex->cursor);
+            exit(EXIT_FAILURE);
+        };
+        }
+
+        lex->cursor += 1;
+    }
+
+    append_token(lex, create_token(END_OF_FILE, (union token_value){ .value = '\0' }, lex->cursor,
+                                   lex->cursor));
+}
+
+void print_help(void)
+{
+    printf("Usage:\n");
+    printf("  ./main [OPTIONS] [EXPRESSION]\n\n");
+
+    printf("Options:\n");
+    printf(
+        "  -e, --eval EXPRESSION       Evaluate expression directly (default if expression provided)\n");
+    printf("  -a, --ast [FORMAT]          Show AST visualization\n");
+    printf("                               FORMAT can be 'json' (default is S-expression)\n");
+    printf("  -f, --file PATH             Read the expression from PATH ('-' for stdin)\n");
+    printf("  -s, --sum[=MODE]            Evaluate + chains with a multi-operand sum\n");
+    printf("                               MODE can be 'pairwise' (default) or 'kahan', and\n");
+    printf("                               chains beyond %d terms need it\n", MAX_AST_DEPTH);
+    printf("      --no-int                Evaluate integer literals as doubles\n");
+    printf("      --bigint                Evaluate with exact arbitrary-precision integers, / and %%\n");
+    printf("                               truncate toward zero like C\n");
+    printf("      --bench-bigint          Time bigint multiplication from 10 to 10^6 digits\n");
+    printf("      --rational              Evaluate with exact fractions\n");
+    printf("      --precision=PREC        Floating point precision, 'f64' (default), 'f32' or\n");
+    printf("                               'dd' (double-double, ~32 digits), both report the\n");
+    printf("                               error against f64\n");
+    printf("      --interval              Evaluate guaranteed [lo, hi] bounds of the result\n");
+    printf("      --bench-modes           Time the expression in f64, dd, rational and bigint\n");
+    printf("      --fma                   Fuse a * b + c and a * b - c into single-rounding FMAs\n");
+    printf("      --simplify[=report]     Apply IEEE-exact algebraic rewrites before compiling\n");
+    printf("                               'report' prints how often each rule fired\n");
+    printf("      --fast-math             Also allow rewrites that change -0, NaN or rounding\n");
+    printf("      --mod P                 Evaluate with residues mod P (2 <= P < 2^64), / is the\n");
+    printf("                               modular inverse, exponents must be integer constants\n");
+    printf("      --disasm                Print the compiled bytecode with stack depths and a\n");
+    printf("                               static cost estimate per instruction\n");
+#ifndef TAIL_TRAMPOLINE
+    printf("      --tail-vm               Run the bytecode on the tail-call threaded interpreter\n");
+    printf("                               instead of the run_vm switch loop\n");
+#endif
+    printf("      --acc-vm                Compile to accumulator code, where constants and\n");
+    printf("                               temporaries are operands, and run that instead\n");
+    printf("      --emit-c FILE           Write the compiled bytecode as a straight-line C function\n");
+    printf("                               double f(const double *vars), '-' for stdout\n");
+    printf("      --aot                   Compile that C with $CC (default cc), dlopen it and print\n");
+    printf("                               its result, objects are cached by source hash under\n");
+    printf("                               $XDG_CACHE_HOME/arithmetic-compiler\n");
+    printf("      --emit-asm FILE         Write f as x86-64 SysV GNU assembly using SSE2 and libm\n");
+    printf("      --emit-obj FILE         Write f as a relocatable x86-64 ELF object directly,\n");
+    printf("                               ready to link with -lm and no assembler needed\n");
+    printf("      --bench[=N]             Time each pipeline phase over N runs (default 1000)\n");
+    printf("                               and print min/median/p99 as JSON\n");
+    printf("      --perf-counters         With --bench, also count cycles, instructions, branch\n");
+    printf("                               and cache misses per phase via perf_event_open\n");
+    printf("      --bench-suite           Time a fixed corpus through every front-end\n");
+    printf("                               configuration and evaluator, print JSON\n");
+    printf("      --baseline FILE         Compare --bench-suite with an earlier run and fail on\n");
+    printf("                               regressions, repeat to merge several runs\n");
+    printf("      --threshold PCT         Allowed slowdown of the median against the baseline\n");
+    printf("                               (default 10), beyond the noise and on a repeat\n");
+    printf("      --trace FILE            Write per-expression phase timelines to FILE in Chrome\n");
+    printf("                               trace format (Perfetto, about:tracing)\n");
+    printf("      --stats                 Report allocations and peak bytes per subsystem and\n");
+    printf("                               phase (needs -DTRACK_ALLOCATIONS)\n");
+    printf("      --latency               With --bench, keep log-bucketed latency histograms per\n");
+    printf("                               phase and print p50/p90/p99/p99.9/max to stderr at\n");
+    printf("                               the end and on SIGUSR1\n");
+    printf("      --gen[=SPEC]            Print random expressions instead of evaluating, SPEC is\n");
+    printf("                               a comma separated list of size=N, depth=N,\n");
+    printf("                               shape=random|left|right|balanced, ops=+-*/%%^,\n");
+    printf("                               literals=int:decimal:exponent:negative,\n");
+    printf("                               parens=DENSITY, seed=N and count=N\n");
+    printf("      --horner[=SCHEME]       Evaluate polynomial + chains without powers\n");
+    printf("                               SCHEME can be 'auto' (default, Estrin from degree\n");
+    printf("                               8), 'plain', 'fma' or 'estrin'\n");
+    printf("  -h, --help                  Show this help message\n\n");
+}
+
+void parse_args(int argc, char **argv, struct cli_options *opts)
+{
+    static struct option long_options[] = {
+        { "help", no_argument, 0, 'h' },
+        { "eval", required_argument, 0, 'e' },
+        { "ast", optional_argument, 0, 'a' },
+        { "file", required_argument, 0, 'f' },
+        { "sum", optional_argument, 0, 's' },
+        { "no-int", no_argument, 0, OPT_NO_INT },
+        { "bigint", no_argument, 0, OPT_BIGINT },
+        { "bench-bigint", no_argument, 0, OPT_BENCH_BIGINT },
+        { "rational", no_argument, 0, OPT_RATIONAL },
+        { "precision", required_argument, 0, OPT_PRECISION },
+        { "interval", no_argument, 0, OPT_INTERVAL },
+        { "bench-modes", no_argument, 0, OPT_BENCH_MODES },
+        { "fma", no_argument, 0, OPT_FMA },
+        { "simplify", optional_argument, 0, OPT_SIMPLIFY },
+        { "fast-math", no_argument, 0, OPT_FAST_MATH },
+        { "horner", optional_argument, 0, OPT_HORNER },
+        { "mod", required_argument, 0, OPT_MOD },
+        { "bench", optional_argument, 0, OPT_BENCH },
+        { "gen", optional_argument, 0, OPT_GEN },
+        { "stats", no_argument, 0, OPT_STATS },
+        { "perf-counters", no_argument, 0, OPT_PERF_COUNTERS },
+        { "trace", required_argument, 0, OPT_TRACE },
+        { "bench-suite", no_argument, 0, OPT_BENCH_SUITE },
+        { "baseline", required_argument, 0, OPT_BASELINE },
+        { "threshold", required_argument, 0, OPT_THRESHOLD },
+        { "disasm", no_argument, 0, OPT_DISASM },
+        { "latency", no_argument, 0, OPT_LATENCY },
+        { "emit-c", required_argument, 0, OPT_EMIT_C },
+        { "aot", no_argument, 0, OPT_AOT },
+        { "emit-asm", required_argument, 0, OPT_EMIT_ASM },
+        { "emit-obj", required_argument, 0, OPT_EMIT_OBJ },
+        { "tail-vm", no_argument, 0, OPT_TAIL_VM },
+        { "acc-vm", no_argument, 0, OPT_ACC_VM },
+        { NULL, 0, NULL, 0 },
+    };
+
+    int opt = 0;
+
+    while ((opt = getopt_long(argc, argv, "he:a::f:s::", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 'h': {
+            opts->show_help = true;
+        } break;
+
+        case 'e': {
+            opts->expression = optarg;
+        } break;
+
+        case 'a': {
+            // optarg is null for short option?? e.g. -a json
+
+            if (!argv[optind]) {
+                opts->show_ast = AST_S_EXPR;
+            } else if (optind < argc && strcmp(argv[optind], "json") == 0) {
+                opts->show_ast = AST_JSON;
+            }
+        } break;
 
-    case NODE_BINARY: {
-        printf("{\n");
-        print_indent(indent + 2);
-        printf("\"type\": \"binary\",\n");
-        print_indent(indent + 2);
-        printf("\"op\": \"%s\",\n", get_token_kind_string(node->data.binary.op));
-        print_indent(indent + 2);
-        printf("\"start\": %zu,\n", node->start);
-        print_indent(indent + 2);
-        printf("\"end\": %zu,\n", node->end);
-        print_indent(indent + 2);
-        printf("\"left\": ");
-        print_ast_json(node->data.binary.left, level + 1);
-        printf(",\n");
-        print_indent(indent + 2);
-        printf("\"right\": ");
-        print_ast_json(node->data.binary.right, level + 1);
-        printf("\n");
-        print_indent(indent);
-        printf("}");
-    } break;
+        case 'f': {
+            opts->expression_file = optarg;
+        } break;
+
+        case 's': {
+            opts->sum_mode = parse_sum_mode(optarg);
+        } break;
+
+        case OPT_NO_INT: {
+            opts->no_int = true;
+        } break;
+
+        case OPT_BIGINT: {
+            opts->numeric_mode = NUMERIC_BIGINT;
+        } break;
+
+        case OPT_BENCH_BIGINT: {
+            opts->bench_bigint = true;
+        } break;
+
+        case OPT_RATIONAL: {
+            opts->numeric_mode = NUMERIC_RATIONAL;
+        } break;
+
+        case OPT_PRECISION: {
+            opts->numeric_mode = parse_precision(optarg);
+        } break;
+
+        case OPT_INTERVAL: {
+            opts->numeric_mode = NUMERIC_INTERVAL;
+        } break;
+
+        case OPT_BENCH_MODES: {
+            opts->bench_modes = true;
+        } break;
+
+        case OPT_FMA: {
+            opts->fma = true;
+        } break;
+
+        case OPT_SIMPLIFY: {
+            if (optarg && strcmp(optarg, "report") != 0) {
+                (void)fprintf(stderr, "Unknown simplify option '%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+
+            opts->simplify = true;
+            opts->simplify_report = optarg != NULL;
+        } break;
+
+        case OPT_FAST_MATH: {
+            opts->simplify = true;
+            opts->fast_math = true;
+        } break;
+
+        case OPT_HORNER: {
+            opts->poly_scheme = parse_poly_scheme(optarg);
+        } break;
+
+        case OPT_MOD: {
+            opts->numeric_mode = NUMERIC_MOD;
+            opts->modulus = parse_modulus(optarg);
+        } break;
+
+        case OPT_BENCH: {
+            opts->bench_iterations = DEFAULT_BENCH_ITERATIONS;
+
+            if (optarg) {
+                char *end = NULL;
+                errno = 0;
+                unsigned long long value = strtoull(optarg, &end, 10);
+
+                if (errno == ERANGE || end == optarg || *end != '\0' || value == 0 ||
+                    !isdigit((unsigned char)optarg[0])) {
+                    (void)fprintf(stderr, "Invalid iteration count '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+
+                opts->bench_iterations = (size_t)value;
+            }
+        } break;
+
+        case OPT_GEN: {
+            opts->generate = true;
+            opts->gen = (struct gen_options){ .size = 16,
+                                              .depth = 0,
+                                              .count = 1,
+                                              .shape = GEN_SHAPE_RANDOM,
+                                              .ops = "+-*/",
+                                              .literal_kinds = { GEN_LITERAL_INT,
+                                                                 GEN_LITERAL_DECIMAL },
+                                              .literal_kind_count = 2,
+                                              .negative_literals = false,
+                                              .paren_density = 0.0,
+                                              .seed = 1 };
+            parse_gen_spec(optarg, &opts->gen);
+        } break;
+
+        case OPT_STATS: {
+#ifndef TRACK_ALLOCATIONS
+            (void)fprintf(stderr, "--stats needs a build with -DTRACK_ALLOCATIONS\n");
+            exit(EXIT_FAILURE);
+#endif
+            opts->stats = true;
+        } break;
+
+        case OPT_PERF_COUNTERS: {
+            opts->perf_counters = true;
+        } break;
+
+        case OPT_TRACE: {
+            opts->trace_path = optarg;
+        } break;
+
+        case OPT_DISASM: {
+            opts->disasm = true;
+        } break;
+
+        case OPT_LATENCY: {
+            opts->latency = true;
+        } break;
+
+        case OPT_EMIT_C: {
+            opts->emit_c_path = optarg;
+        } break;
+
+        case OPT_AOT: {
+            opts->aot = true;
+        } break;
+
+        case OPT_EMIT_ASM: {
+            opts->emit_asm_path = optarg;
+        } break;
+
+        case OPT_EMIT_OBJ: {
+            opts->emit_obj_path = optarg;
+        } break;
+
+        case OPT_TAIL_VM: {
+            opts->tail_vm = true;
+        } break;
+
+        case OPT_ACC_VM: {
+            opts->acc_vm = true;
+        } break;
+
+        case OPT_BENCH_SUITE: {
+            opts->bench_suite = true;
+        } break;
+
+        case OPT_BASELINE: {
+            if (opts->baseline_count >= SUITE_MAX_BASELINES) {
+                (void)fprintf(stderr, "At most %d --baseline files\n", SUITE_MAX_BASELINES);
+                exit(EXIT_FAILURE);
+            }
+
+            opts->baseline_paths[opts->baseline_count++] = optarg;
+        } break;
+
+        case OPT_THRESHOLD: {
+            char *end = NULL;
+            errno = 0;
+            opts->threshold = strtod(optarg, &end);
+
+            if (errno == ERANGE || end == optarg || *end != '\0' || !(opts->threshold >= 0.0)) {
+                (void)fprintf(stderr, "Invalid regression threshold '%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+        } break;
+
+        case '?':
+        default:
+            break;
+        }
+    }
+
+    if (!opts->expression && optind < argc) {
+        opts->expression = argv[optind];
+    }
+}
+
+enum sum_mode parse_sum_mode(const char *name)
+{
+    if (!name || strcmp(name, "pairwise") == 0) {
+        return SUM_PAIRWISE;
+    }
+
+    if (strcmp(name, "kahan") == 0) {
+        return SUM_COMPENSATED;
+    }
+
+    (void)fprintf(stderr, "Unknown summation mode '%s'\n", name);
+    exit(EXIT_FAILURE);
+}
+
+enum poly_scheme parse_poly_scheme(const char *name)
+{
+    if (!name || strcmp(name, "auto") == 0) {
+        return POLY_AUTO;
+    }
+
+    if (strcmp(name, "plain") == 0) {
+        return POLY_HORNER;
+    }
+
+    if (strcmp(name, "fma") == 0) {
+        return POLY_HORNER_FMA;
+    }
+
+    if (strcmp(name, "estrin") == 0) {
+        return POLY_ESTRIN;
+    }
+
+    (void)fprintf(stderr, "Unknown polynomial scheme '%s'\n", name);
+    exit(EXIT_FAILURE);
+}
+
+uint64_t parse_modulus(const char *text)
+{
+    errno = 0;
+    char *end = NULL;
+    unsigned long long value = strtoull(text, &end, 10);
+
+    if (errno == ERANGE || end == text || *end != '\0' || !isdigit((unsigned char)text[0]) ||
+        value < 2) {
+        (void)fprintf(stderr, "Invalid modulus '%s', expected an integer from 2 to 2^64 - 1\n",
+                      text);
+        exit(EXIT_FAILURE);
+    }
+
+    return (uint64_t)value;
+}
+
+enum numeric_mode parse_precision(const char *name)
+{
+    if (strcmp(name, "f64") == 0) {
+        return NUMERIC_DOUBLE;
+    }
+
+    if (strcmp(name, "f32") == 0) {
+        return NUMERIC_F32;
+    }
+
+    if (strcmp(name, "dd") == 0) {
+        return NUMERIC_DD;
+    }
+
+    (void)fprintf(stderr, "Unknown precision '%s'\n", name);
+    exit(EXIT_FAILURE);
+}
+
+char *read_expression_file(const char *path)
+{
+    FILE *file = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+
+    if (!file) {
+        (void)fprintf(stderr, "Could not open '%s': %s\n", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    size_t capacity = 4096;
+    size_t size = 0;
+    char *buffer = malloc(capacity);
+
+    if (!buffer) {
+        (void)fprintf(stderr, "Go download more ram\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t read = 0;
+    while ((read = fread(buffer + size, 1, capacity - size - 1, file)) > 0) {
+        size += read;
+
+        if (size + 1 >= capacity) {
+            capacity *= 2;
+            char *new_buffer = realloc(buffer, capacity);
+
+            if (!new_buffer) {
+                (void)fprintf(stderr, "Go download more ram\n");
+                exit(EXIT_FAILURE);
+            }
+
+            buffer = new_buffer;
+        }
+    }
+
+    // fread returns 0 on errors too, which would otherwise evaluate a truncated expression.
+    if (ferror(file)) {
+        (void)fprintf(stderr, "Could not read '%s': %s\n", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    if (file != stdin) {
+        (void)fclose(file);
+    }
+
+    buffer[size] = '\0';
+
+    return buffer;
+}
+
+void execute_bigint(struct chunk *chunks, const struct ast_node *root)
+{
+    struct bigint_vm bigint_vm = { .chunks = chunks, .ip = 0, .top = 0 };
+    struct bigint result;
+    struct bigint eval_result;
+    bigint_init(&result);
+    bigint_init(&eval_result);
+
+    run_bigint_vm(&bigint_vm, &result);
+    eval_ast_bigint(root, &eval_result);
+
+    assert(mag_compare(result.limbs, result.size, eval_result.limbs, eval_result.size) == 0 &&
+           result.negative == eval_result.negative);
+
+    char *result_text = bigint_to_string(&result);
+    char *eval_text = bigint_to_string(&eval_result);
+
+    printf("VM Result: %s\n", result_text);
+    printf("Eval Result: %s\n", eval_text);
+
+    free(result_text);
+    free(eval_text);
+    bigint_free(&result);
+    bigint_free(&eval_result);
+}
+
+void execute_rational(struct chunk *chunks, const struct ast_node *root)
+{
+    struct rational_vm rational_vm = { .chunks = chunks, .ip = 0, .top = 0 };
+    struct rational result;
+    struct rational eval_result;
+    rational_init(&eval_result);
+
+    run_rational_vm(&rational_vm, &result);
+    eval_ast_rational(root, &eval_result);
+
+    char *result_text = rational_to_string(&result);
+    char *eval_text = rational_to_string(&eval_result);
+
+    assert(bigint_compare(&result.numerator, &eval_result.numerator) == 0 &&
+           bigint_compare(&result.denominator, &eval_result.denominator) == 0);
+
+    printf("VM Result: %s\n", result_text);
+    printf("Eval Result: %s\n", eval_text);
+
+    free(result_text);
+    free(eval_text);
+    rational_free(&result);
+    rational_free(&eval_result);
+}
+
+void execute_f32(struct chunk *chunks, const struct ast_node *root)
+{
+    struct f32_vm f32_vm = { .chunks = chunks, .ip = 0, .top = 0, .stack = { 0 } };
+    float result = run_f32_vm(&f32_vm);
+    float eval_result = eval_ast_f32(root);
+
+    assert(result == eval_result || (isnan(result) && isnan(eval_result)));
+    printf("VM Result: %.9g\n", result);
+    printf("Eval Result: %.9g\n", eval_result);
+
+    // The untyped tree evaluates in plain double, which is the reference for the report.
+    double reference = eval_ast(root);
+    double absolute_error = fabs((double)result - reference);
+    double relative_error = reference != 0.0 ? absolute_error / fabs(reference) : absolute_error;
+    float magnitude = fabsf((float)reference);
+    double ulp = (double)nextafterf(magnitude, INFINITY) - (double)magnitude;
+
+    printf("f64 Result: %.17g\n", reference);
+    printf("Absolute Error: %.3g\n", absolute_error);
+    printf("Relative Error: %.3g\n", relative_error);
+    printf("Error (f32 ulps): %.3g\n", absolute_error / ulp);
+}
+
+void execute_interval(struct chunk *chunks, const struct ast_node *root)
+{
+    struct interval_vm interval_vm = { .chunks = chunks, .ip = 0, .top = 0 };
+    struct interval result = run_interval_vm(&interval_vm);
+    struct interval eval_result = eval_ast_interval(root);
+
+    assert(memcmp(&result, &eval_result, sizeof(result)) == 0);
+    printf("VM Result: [%.17g, %.17g]\n", result.lo, result.hi);
+    printf("Eval Result: [%.17g, %.17g]\n", eval_result.lo, eval_result.hi);
+    printf("Width: %.3g\n", result.hi - result.lo);
+}
+
+void execute_dd(struct chunk *chunks, const struct ast_node *root)
+{
+    struct dd_vm dd_vm = { .chunks = chunks, .ip = 0, .top = 0 };
+    struct dd result = run_dd_vm(&dd_vm);
+    struct dd eval_result = eval_ast_dd(root);
+    char result_text[64];
+    char eval_text[64];
+
+    assert(memcmp(&result, &eval_result, sizeof(result)) == 0 ||
+           (isnan(result.hi) && isnan(eval_result.hi)));
+    dd_to_string(result, result_text, sizeof(result_text));
+    dd_to_string(eval_result, eval_text, sizeof(eval_text));
+    printf("VM Result: %s\n", result_text);
+    printf("Eval Result: %s\n", eval_text);
+
+    // How much the plain double pipeline lost, measured against the extended result.
+    double reference = eval_ast(root);
+    struct dd error = dd_sub(dd_from_double(reference), result);
+    double relative_error = result.hi != 0.0 ? fabs(error.hi / result.hi) : fabs(error.hi);
+
+    printf("f64 Result: %.17g\n", reference);
+    printf("f64 Relative Error: %.3g\n", relative_error);
+}
+
+void execute_mod(struct chunk *chunks, const struct ast_node *root, uint64_t modulus)
+{
+    struct mod_context context;
+    mod_init(&context, modulus);
+
+    struct mod_vm mod_vm = { .chunks = chunks, .context = &context, .ip = 0, .top = 0 };
+    struct mod_literal exact;
+    uint64_t result = mod_from(&context, run_mod_vm(&mod_vm));
+    uint64_t eval_result = mod_from(&context, eval_ast_mod(root, &context, &exact));
+
+    assert(result == eval_result);
+    printf("VM Result: %" PRIu64 "\n", result);
+    printf("Eval Result: %" PRIu64 "\n", eval_result);
+}
+
+struct ast_node *apply_passes(struct ast_node *root, const struct cli_options *opts, size_t *fired)
+{
+    // The rewrites and the int64 fast path are double semantics, exact modes see the tree as
+    // parsed. The mode benchmark runs one chunk through every VM, so it needs the plain one too.
+    if (opts->numeric_mode != NUMERIC_DOUBLE || opts->bench_modes) {
+        check_ast_depth(root);
+        return root;
+    }
+
+    // fold_sums walks + chains with a work list, so with --sum only the folded tree has to fit.
+    if (opts->sum_mode == SUM_NONE) {
+        check_ast_depth(root);
+    }
+
+    // Before the other rewrites, which would take the powers and + chains it matches apart.
+    if (opts->poly_scheme != POLY_NONE) {
+        root = rewrite_polynomials(root, opts->poly_scheme);
+    }
+
+    if (opts->sum_mode != SUM_NONE) {
+        root = fold_sums(root, opts->sum_mode);
+        check_ast_depth(root);
+    }
+
+    if (opts->fast_math) {
+        root = merge_chain_constants(root, fired);
+    }
+
+    if (opts->simplify) {
+        root = simplify(root, opts->fast_math, fired);
+    }
+
+    if (!opts->no_int) {
+        int64_t value = 0;
+        infer_types(root, &value);
+    }
+
+    // Fusing changes results in the last bit, so it is opt-in.
+    if (opts->fma) {
+        root = fuse_multiply_add(root);
+    }
+
+    return root;
+}
+
+void trace_record(const char *name, char phase, bool new_expression)
+{
+    uint64_t timestamp = now_ns();
+    struct trace_buffer *buffer = trace_local;
+
+    if (!buffer) {
+        buffer = calloc(1, sizeof(*buffer));
+        if (!buffer) {
+            (void)fprintf(stderr, "Go download more ram\n");
+            exit(EXIT_FAILURE);
+        }
+
+        buffer->thread_id = atomic_fetch_add(&trace_thread_count, 1) + 1;
+        buffer->next = atomic_load(&trace_buffers);
+        while (!atomic_compare_exchange_weak(&trace_buffers, &buffer->next, buffer)) {
+        }
+
+        trace_local = buffer;
+    }
+
+    if (buffer->size >= buffer->capacity) {
+        size_t capacity = buffer->capacity > 0 ? buffer->capacity * 2 : TRACE_INITIAL_EVENTS;
+        struct trace_event *events = realloc(buffer->events, capacity * sizeof(*events));
+
+        if (!events) {
+            (void)fprintf(stderr, "Go download more ram\n");
+            exit(EXIT_FAILURE);
+        }
+
+        buffer->events = events;
+        buffer->capacity = capacity;
+    }
+
+    buffer->expression += new_expression;
+    buffer->events[buffer->size++] = (struct trace_event){
+        .name = name, .timestamp = timestamp, .expression = buffer->expression, .phase = phase
+    };
+}
+
+void trace_flush(void)
+{
+    // Registered with atexit, so runs that stop on an error still leave a readable trace.
+    trace_enabled = false;
+
+    FILE *file = fopen(trace_path, "w");
+    if (!file) {
+        (void)fprintf(stderr, "Could not write trace '%s': %s\n", trace_path, strerror(errno));
+        return;
+    }
+
+    bool first = true;
+    (void)fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+    for (struct trace_buffer *buffer = atomic_load(&trace_buffers); buffer;) {
+        (void)fprintf(file,
+                      "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%" PRIu64
+                      ",\"args\":{\"name\":\"thread %" PRIu64 "\"}}",
+                      first ? "" : ",", buffer->thread_id, buffer->thread_id);
+        first = false;
+
+        for (size_t i = 0; i < buffer->size; i++) {
+            const struct trace_event *event = &buffer->events[i];
+
+            (void)fprintf(file,
+                          ",\n{\"name\":\"%s\",\"cat\":\"pipeline\",\"ph\":\"%c\",\"ts\":%.3f,"
+                          "\"pid\":1,\"tid\":%" PRIu64 ",\"args\":{\"expression\":%zu}}",
+                          event->name, event->phase, (double)event->timestamp / 1e3,
+                          buffer->thread_id, event->expression);
+        }
+
+        struct trace_buffer *next = buffer->next;
+        free(buffer->events);
+        free(buffer);
+        buffer = next;
+    }
+
+    (void)fprintf(file, "\n]}\n");
+
+    if (fclose(file) != 0) {
+        (void)fprintf(stderr, "Could not write trace '%s': %s\n", trace_path, strerror(errno));
+    }
+}
+
+size_t latency_bucket(uint64_t value)
+{
+    if (value < LATENCY_SUB_BUCKETS) {
+        return (size_t)value;
     }
+
+    size_t exponent = 63 - (size_t)__builtin_clzll(value);
+    size_t shift = exponent - LATENCY_SUB_BUCKET_BITS;
+    size_t sub_bucket = (size_t)(value >> shift) & (LATENCY_SUB_BUCKETS - 1);
+
+    return (shift + 1) * LATENCY_SUB_BUCKETS + sub_bucket;
 }
 
-void print_ast(const struct ast_node *node)
+uint64_t latency_bucket_value(size_t bucket)
 {
-    if (!node) {
-        return;
+    // The highest value that lands in the bucket, as HdrHistogram reports percentiles.
+    if (bucket < LATENCY_SUB_BUCKETS) {
+        return bucket;
     }
 
-    switch (node->type) {
-    case NODE_NUMBER: {
-        printf("%g", node->data.number.value);
-    } break;
+    size_t shift = bucket / LATENCY_SUB_BUCKETS - 1;
+    uint64_t lowest = (uint64_t)(LATENCY_SUB_BUCKETS + bucket % LATENCY_SUB_BUCKETS) << shift;
 
-    case NODE_UNARY: {
-        printf("(%s ", get_token_kind_string(node->data.unary.op));
-        print_ast(node->data.unary.child);
-        printf(")");
-    } break;
+    return lowest + (((uint64_t)1 << shift) - 1);
+}
 
-    case NODE_BINARY: {
-        printf("(%s ", get_token_kind_string(node->data.binary.op));
-        print_ast(node->data.binary.left);
-        printf(" ");
-        print_ast(node->data.binary.right);
-        printf(")");
-    } break;
+void latency_record(size_t phase, uint64_t value)
+{
+    struct latency_recorder *recorder = latency_local;
+
+    if (!recorder) {
+        recorder = calloc(1, sizeof(*recorder));
+        if (!recorder) {
+            (void)fprintf(stderr, "Go download more ram\n");
+            exit(EXIT_FAILURE);
+        }
+
+        recorder->next = atomic_load(&latency_recorders);
+        while (!atomic_compare_exchange_weak(&latency_recorders, &recorder->next, recorder)) {
+        }
+
+        latency_local = recorder;
+    }
+
+    // Only the owning thread writes, so a relaxed load and store replace a locked increment.
+    struct latency_histogram *histogram = &recorder->phases[phase];
+    _Atomic uint64_t *count = &histogram->counts[latency_bucket(value)];
+
+    atomic_store_explicit(count, atomic_load_explicit(count, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+
+    if (value > atomic_load_explicit(&histogram->max, memory_order_relaxed)) {
+        atomic_store_explicit(&histogram->max, value, memory_order_relaxed);
     }
 }
 
-uint8_t get_left_binding_power(enum token_kind kind)
+void request_latency_report(int signal_number)
 {
-    switch (kind) {
-    case PLUS:
-    case MINUS:
-        return 1;
-    case STAR:
-    case SLASH:
-    case PERCENT:
-        return 2;
-    case CARET:
-        return 4;
-    default:
-        return 0;
+    // Only sets a flag, the benchmark loop prints the report between runs.
+    (void)signal_number;
+    latency_report_requested = 1;
+}
+
+void print_latency_report(void)
+{
+    static const char *names[BENCH_PHASE_COUNT + 1] = { "tokenize", "parse",    "passes",
+                                                        "compile",  "run_vm",   "eval_ast",
+                                                        "expression" };
+    static const double percentiles[] = { 50.0, 90.0, 99.0, 99.9 };
+    const size_t percentile_count = sizeof(percentiles) / sizeof(percentiles[0]);
+
+    (void)fprintf(stderr, "%-12s %10s %10s %10s %10s %10s %10s\n", "Latency (ns)", "count",
+                  "p50", "p90", "p99", "p99.9", "max");
+
+    for (size_t phase = 0; phase <= BENCH_PHASE_COUNT; phase++) {
+        static uint64_t merged[LATENCY_BUCKETS];
+        uint64_t total = 0;
+        uint64_t max = 0;
+
+        memset(merged, 0, sizeof(merged));
+
+        for (struct latency_recorder *recorder = atomic_load(&latency_recorders); recorder;
+             recorder = recorder->next) {
+            const struct latency_histogram *histogram = &recorder->phases[phase];
+
+            for (size_t bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+                merged[bucket] +=
+                    atomic_load_explicit(&histogram->counts[bucket], memory_order_relaxed);
+            }
+
+            uint64_t recorder_max = atomic_load_explicit(&histogram->max, memory_order_relaxed);
+            max = recorder_max > max ? recorder_max : max;
+        }
+
+        for (size_t bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+            total += merged[bucket];
+        }
+
+        (void)fprintf(stderr, "%-12s %10" PRIu64, names[phase], total);
+
+        size_t bucket = 0;
+        uint64_t seen = 0;
+
+        for (size_t i = 0; i < percentile_count; i++) {
+            // Nearest rank, walking the buckets once for all percentiles.
+            uint64_t rank = (uint64_t)ceil(percentiles[i] / 100.0 * (double)total);
+            rank = rank > 0 ? rank : 1;
+
+            while (bucket < LATENCY_BUCKETS && seen + merged[bucket] < rank) {
+                seen += merged[bucket];
+                bucket += 1;
+            }
+
+            uint64_t value = total > 0 ? latency_bucket_value(bucket) : 0;
+            (void)fprintf(stderr, " %10" PRIu64, value < max ? value : max);
+        }
+
+        (void)fprintf(stderr, " %10" PRIu64 "\n", max);
     }
 }
 
-uint8_t get_right_binding_power(enum token_kind kind)
+size_t count_ast_nodes(const struct ast_node *node)
 {
-    switch (kind) {
-    case PLUS:
-    case MINUS:
+    switch (node->type) {
+    case NODE_NUMBER:
         return 1;
-    case STAR:
-    case SLASH:
-    case PERCENT:
-        return 2;
-    case CARET:
-        return 3;
-    default:
-        return 0;
+    case NODE_UNARY:
+        return 1 + count_ast_nodes(node->data.unary.child);
+    case NODE_BINARY:
+        return 1 + count_ast_nodes(node->data.binary.left) +
+               count_ast_nodes(node->data.binary.right);
+    case NODE_SUM: {
+        size_t count = 1;
+
+        for (size_t i = 0; i < node->data.sum.count; i++) {
+            count += count_ast_nodes(node->data.sum.terms[i]);
+        }
+
+        return count;
+    }
+    case NODE_FMA:
+        return 1 + count_ast_nodes(node->data.fma.multiplicand) +
+               count_ast_nodes(node->data.fma.multiplier) +
+               count_ast_nodes(node->data.fma.addend);
+    case NODE_POLY:
+        return 1 + count_ast_nodes(node->data.poly.base);
     }
+
+    return 0;
 }
 
-struct ast_node *create_ast_node(enum node_type type, union node_data data, size_t start,
-                                 size_t end)
+bool perf_counters_open(struct perf_counters *counters)
 {
-    struct ast_node *node = malloc(sizeof(struct ast_node));
-    if (!node) {
-        (void)fprintf(stderr, "Go download more ram\n");
-        exit(EXIT_FAILURE);
+    counters->opened = 0;
+    counters->leader = -1;
+
+    for (size_t i = 0; i < PERF_COUNTER_COUNT; i++) {
+        counters->fds[i] = -1;
+        counters->slots[i] = SIZE_MAX;
     }
 
-    node->type = type;
-    node->start = start;
-    node->end = end;
-    node->data = data;
+#ifdef __linux__
+    static const struct {
+        uint32_t type;
+        uint64_t config;
+    } events[PERF_COUNTER_COUNT] = {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+        { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+        { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    };
+    int error = 0;
+
+    for (size_t i = 0; i < PERF_COUNTER_COUNT; i++) {
+        struct perf_event_attr attr = { 0 };
+        attr.size = sizeof(attr);
+        attr.type = events[i].type;
+        attr.config = events[i].config;
+        attr.disabled = counters->leader == -1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                           PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, counters->leader, 0);
+
+        if (fd == -1) {
+            error = errno;
+            continue;
+        }
 
-    return node;
+        if (counters->leader == -1) {
+            counters->leader = fd;
+        }
+
+        counters->fds[i] = fd;
+        counters->slots[i] = counters->opened++;
+    }
+
+    if (counters->leader == -1) {
+        (void)fprintf(stderr, "Performance counters unavailable (%s), timing only\n",
+                      strerror(error));
+        return false;
+    }
+
+    if (ioctl(counters->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP) == -1) {
+        (void)fprintf(stderr, "Performance counters unavailable (%s), timing only\n",
+                      strerror(errno));
+        perf_counters_close(counters);
+        return false;
+    }
+
+    return true;
+#else
+    (void)fprintf(stderr, "Performance counters need Linux perf_event_open, timing only\n");
+    return false;
+#endif
 }
 
-struct token get_next_token(struct parser *parser)
+bool perf_counters_read(const struct perf_counters *counters, uint64_t *values)
 {
-    if (parser->tokens[parser->current_index].kind == END_OF_FILE) {
-        (void)fprintf(stderr, "EOF\n");
-        exit(EXIT_FAILURE);
+#ifdef __linux__
+    // Layout of a PERF_FORMAT_GROUP read: nr, time enabled, time running, one value per event.
+    uint64_t buffer[3 + PERF_COUNTER_COUNT] = { 0 };
+
+    if (read(counters->leader, buffer, sizeof(buffer)) < (ssize_t)(3 * sizeof(uint64_t))) {
+        return false;
     }
 
-    return parser->tokens[parser->current_index++];
+    for (size_t i = 0; i < PERF_COUNTER_COUNT; i++) {
+        values[i] = counters->slots[i] < buffer[0] ? buffer[3 + counters->slots[i]] : 0;
+    }
+
+    // A group the PMU could not schedule reports zero running time and no counts.
+    return buffer[2] > 0;
+#else
+    (void)counters;
+    (void)values;
+    return false;
+#endif
 }
 
-struct ast_node *parse(struct lexer *lex)
+void perf_counters_close(struct perf_counters *counters)
 {
-    struct parser parser =
-        (struct parser){ .tokens = lex->tokens, .size = lex->size, .current_index = 0 };
+#ifdef __linux__
+    for (size_t i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (counters->fds[i] != -1) {
+            close(counters->fds[i]);
+            counters->fds[i] = -1;
+        }
+    }
+#endif
 
-    return parse_expression(&parser, 0);
+    counters->leader = -1;
+    counters->opened = 0;
 }
 
-struct ast_node *parse_expression(struct parser *parser, uint8_t binding_power)
+int compare_u64(const void *a, const void *b)
 {
-    if (parser->tokens[parser->current_index].kind == END_OF_FILE) {
-        return NULL;
-    }
+    uint64_t lhs = *(const uint64_t *)a;
+    uint64_t rhs = *(const uint64_t *)b;
 
-    struct token tok = get_next_token(parser);
-    struct ast_node *lhs = parse_prefix(parser, &tok);
+    return (lhs > rhs) - (lhs < rhs);
+}
 
-    if (!lhs) {
-        (void)fprintf(stderr, "Expected left hand side\n");
-        exit(EXIT_FAILURE);
+int compare_double(const void *a, const void *b)
+{
+    double lhs = *(const double *)a;
+    double rhs = *(const double *)b;
+
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+void mark_phase_boundary(uint64_t *time, const struct perf_counters *counters, uint64_t *values,
+                         bool *counted)
+{
+    // The clock is read first, so the cost of reading the counters lands in the next phase's
+    // time rather than in the phase that just ended.
+    *time = now_ns();
+
+    if (counters) {
+        *counted = perf_counters_read(counters, values) && *counted;
     }
+}
 
-    while (parser->tokens[parser->current_index].kind != END_OF_FILE) {
-        struct token next = parser->tokens[parser->current_index];
+void print_phase_json(const char *name, uint64_t *samples, size_t count, size_t units,
+                      const char *unit)
+{
+    qsort(samples, count, sizeof(*samples), compare_u64);
+
+    // Nearest-rank percentiles, so p99 of fewer than 100 runs is the slowest run.
+    uint64_t median = samples[(count - 1) / 2];
+    uint64_t p99 = samples[(count * 99 + 99) / 100 - 1];
+    double throughput = median > 0 ? (double)units * 1e9 / (double)median : 0.0;
+
+    printf("    {\n");
+    printf("      \"name\": \"%s\",\n", name);
+    printf("      \"min_ns\": %" PRIu64 ",\n", samples[0]);
+    printf("      \"median_ns\": %" PRIu64 ",\n", median);
+    printf("      \"p99_ns\": %" PRIu64 ",\n", p99);
+    printf("      \"throughput\": %.6g,\n", throughput);
+    printf("      \"unit\": \"%s\"", unit);
+}
 
-        uint8_t left_binding_power = get_left_binding_power(next.kind);
-        if (left_binding_power <= binding_power) {
-            break;
+void print_counters_json(const struct perf_counters *counters, const uint64_t *totals,
+                         size_t runs, size_t units, const char *unit)
+{
+    static const char *names[PERF_COUNTER_COUNT] = { "cycles", "instructions", "branch_misses",
+                                                     "l1d_misses", "llc_misses" };
+
+    // Averages per run, then per token, node or instruction of the phase.
+    printf(",\n      \"counters\": {\n");
+
+    for (size_t i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (counters->fds[i] == -1) {
+            printf("        \"%s\": null,\n", names[i]);
+        } else {
+            printf("        \"%s\": %.1f,\n", names[i], (double)totals[i] / (double)runs);
         }
+    }
 
-        struct token operator = get_next_token(parser);
-        uint8_t right_binding_power = get_right_binding_power(operator.kind);
+    if (counters->fds[PERF_CYCLES] != -1 && counters->fds[PERF_INSTRUCTIONS] != -1 &&
+        totals[PERF_CYCLES] > 0) {
+        printf("        \"ipc\": %.3f,\n",
+               (double)totals[PERF_INSTRUCTIONS] / (double)totals[PERF_CYCLES]);
+    } else {
+        printf("        \"ipc\": null,\n");
+    }
 
-        struct ast_node *rhs = parse_expression(parser, right_binding_power);
+    printf("        \"per_%s\": {", unit);
 
-        if (!rhs) {
-            (void)fprintf(stderr, "Expected right hand side\n");
-            exit(EXIT_FAILURE);
+    bool first = true;
+    for (size_t i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (counters->fds[i] != -1 && units > 0) {
+            printf("%s \"%s\": %.4g", first ? "" : ",", names[i],
+                   (double)totals[i] / (double)runs / (double)units);
+            first = false;
         }
-
-        lhs = create_ast_node(NODE_BINARY,
-                              (union node_data){ .binary.left = lhs,
-                                                 .binary.right = rhs,
-                                                 .binary.op = operator.kind },
-                              lhs->start, rhs->end);
     }
 
-    return lhs;
+    printf(" }\n");
+    printf("      }");
 }
 
-struct ast_node *parse_prefix(struct parser *parser, const struct token *token)
+void benchmark_pipeline(const struct cli_options *opts)
 {
-    if (token->kind == NUMBER) {
-        return create_ast_node(NODE_NUMBER,
-                               (union node_data){ .number.value = token->value.number_value },
-                               token->start, token->end);
+    if (!opts->expression) {
+        (void)fprintf(stderr, "Missinng expression");
+        return;
     }
 
-    if (token->kind == MINUS) {
-        struct ast_node *rhs = parse_expression(parser, UNARY_DEFAULT);
+    if (opts->numeric_mode != NUMERIC_DOUBLE) {
+        (void)fprintf(stderr, "--bench times the double pipeline, drop the numeric mode\n");
+        exit(EXIT_FAILURE);
+    }
 
-        if (!rhs) {
-            (void)fprintf(stderr, "Expected right hand side\n");
+    if (opts->latency) {
+        struct sigaction action = { 0 };
+        action.sa_handler = request_latency_report;
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = SA_RESTART;
+        sigaction(SIGUSR1, &action, NULL);
+    }
+
+    size_t iterations = opts->bench_iterations;
+    size_t warmup = iterations / 10 > 0 ? iterations / 10 : 1;
+    uint64_t *samples = malloc(BENCH_PHASE_COUNT * iterations * sizeof(*samples));
+    if (!samples) {
+        (void)fprintf(stderr, "Go download more ram\n");
+        exit(EXIT_FAILURE);
+    }
+
+    struct perf_counters perf = { 0 };
+    const struct perf_counters *counters =
+        opts->perf_counters && perf_counters_open(&perf) ? &perf : NULL;
+    uint64_t counter_totals[BENCH_PHASE_COUNT][PERF_COUNTER_COUNT] = { { 0 } };
+    size_t counted_runs = 0;
+
+    size_t bytes = strlen(opts->expression);
+    size_t token_count = 0;
+    size_t node_count = 0;
+    size_t instruction_count = 0;
+    volatile double sink = 0.0;
+
+    for (size_t run = 0; run < warmup + iterations; run++) {
+        uint64_t times[BENCH_PHASE_COUNT + 1];
+        uint64_t values[BENCH_PHASE_COUNT + 1][PERF_COUNTER_COUNT];
+        bool counted = true;
+        size_t fired[RULE_COUNT] = { 0 };
+        struct lexer lex = { 0 };
+        struct chunk chunks = { 0 };
+        struct acc_chunk acc = { 0 };
+
+        TRACE_BEGIN_EXPRESSION();
+        TRACE_BEGIN("tokenize");
+        TRACK_PHASE(PHASE_TOKENIZE);
+        mark_phase_boundary(&times[0], counters, values[0], &counted);
+        init_lexer(&lex);
+        tokenize(&lex, opts->expression);
+        mark_phase_boundary(&times[1], counters, values[1], &counted);
+        TRACE_END("tokenize");
+
+        TRACE_BEGIN("parse");
+        TRACK_PHASE(PHASE_PARSE);
+        struct ast_node *root = parse(&lex);
+        mark_phase_boundary(&times[2], counters, values[2], &counted);
+        TRACE_END("parse");
+
+        if (!root) {
+            (void)fprintf(stderr, "Error: Empty expression\n");
             exit(EXIT_FAILURE);
         }
 
-        return create_ast_node(NODE_UNARY,
-                               (union node_data){ .unary.child = rhs, .unary.op = token->kind },
-                               token->start, token->end);
-    }
+        TRACE_BEGIN("passes");
+        TRACK_PHASE(PHASE_PASSES);
+        root = apply_passes(root, opts, fired);
+        mark_phase_boundary(&times[3], counters, values[3], &counted);
+        TRACE_END("passes");
+
+        TRACE_BEGIN("compile");
+        TRACK_PHASE(PHASE_COMPILE);
+        init_chunks(&chunks);
+        compile_ast_to_bytecode(&chunks, root);
+        emit_bytecode(&chunks, OP_HALT, 0);
+        if (opts->acc_vm) {
+            compile_accumulator(&acc, root);
+        }
+        mark_phase_boundary(&times[4], counters, values[4], &counted);
+        TRACE_END("compile");
+
+        TRACE_BEGIN("execute");
+        TRACK_PHASE(PHASE_RUN);
+        struct vm stack_vm = { .ip = 0, .top = 0, .chunks = &chunks, .stack = { { 0 } } };
+        union value result = opts->acc_vm    ? run_acc_vm(&acc)
+                             : opts->tail_vm ? run_tail_vm(&chunks)
+                                             : run_vm(&stack_vm);
+        mark_phase_boundary(&times[5], counters, values[5], &counted);
+        TRACE_END("execute");
+
+        TRACE_BEGIN("eval_ast");
+        TRACK_PHASE(PHASE_EVAL);
+        sink = root->value_type == VALUE_INT ? (double)eval_ast_int(root) : eval_ast(root);
+        mark_phase_boundary(&times[6], counters, values[6], &counted);
+        TRACE_END("eval_ast");
+
+        sink = sink + (root->value_type == VALUE_INT ? (double)result.integer : result.number);
+
+        if (run == 0) {
+            token_count = lex.size;
+            node_count = count_ast_nodes(root);
+            instruction_count = opts->acc_vm ? acc.code_size : chunks.code_size;
+        }
 
-    if (token->kind == PLUS) {
-        struct ast_node *rhs = parse_expression(parser, UNARY_DEFAULT);
+        if (run >= warmup) {
+            for (size_t phase = 0; phase < BENCH_PHASE_COUNT; phase++) {
+                samples[phase * iterations + run - warmup] = times[phase + 1] - times[phase];
+            }
+        }
 
-        if (!rhs) {
-            (void)fprintf(stderr, "Expected right hand side\n");
-            exit(EXIT_FAILURE);
+        if (run >= warmup && opts->latency) {
+            for (size_t phase = 0; phase < BENCH_PHASE_COUNT; phase++) {
+                latency_record(phase, times[phase + 1] - times[phase]);
+            }
+
+            latency_record(BENCH_PHASE_COUNT, times[BENCH_PHASE_COUNT] - times[0]);
         }
 
-        return create_ast_node(NODE_UNARY,
-                               (union node_data){ .unary.child = rhs, .unary.op = token->kind },
-                               token->start, token->end);
-    }
+        if (latency_report_requested) {
+            latency_report_requested = 0;
+            print_latency_report();
+        }
 
-    if (token->kind == LPAREN) {
-        struct ast_node *expr = parse_expression(parser, 0);
+        if (run >= warmup && counters && counted) {
+            counted_runs += 1;
 
-        if (!expr) {
-            (void)fprintf(stderr, "Expected expression\n");
-            exit(EXIT_FAILURE);
+            for (size_t phase = 0; phase < BENCH_PHASE_COUNT; phase++) {
+                for (size_t i = 0; i < PERF_COUNTER_COUNT; i++) {
+                    counter_totals[phase][i] += values[phase + 1][i] - values[phase][i];
+                }
+            }
         }
 
-        struct token tok = get_next_token(parser);
+        free_ast_node(root);
+        free_tokens(lex.tokens);
+        free_chunks(&chunks);
+        free_acc_chunk(&acc);
+        TRACE_END("expression");
+    }
 
-        if (tok.kind != RPAREN) {
-            (void)fprintf(stderr, "Expected ')' at position %zu\n", tok.start);
-            exit(EXIT_FAILURE);
+    // Tokens, nodes and instructions per second, the passes are measured over the final tree.
+    static const char *names[BENCH_PHASE_COUNT] = { "tokenize", "parse",  "passes",
+                                                    "compile",  "run_vm", "eval_ast" };
+    static const char *units[BENCH_PHASE_COUNT] = { "bytes/s", "nodes/s",        "nodes/s",
+                                                    "instructions/s", "instructions/s",
+                                                    "nodes/s" };
+    size_t counts[BENCH_PHASE_COUNT] = { bytes,      node_count,        node_count,
+                                         instruction_count, instruction_count, node_count };
+    static const char *counter_units[BENCH_PHASE_COUNT] = { "token",       "node",
+                                                            "node",        "instruction",
+                                                            "instruction", "node" };
+    size_t counter_counts[BENCH_PHASE_COUNT] = { token_count,       node_count,
+                                                 node_count,        instruction_count,
+                                                 instruction_count, node_count };
+
+    if (counters && counted_runs == 0) {
+        (void)fprintf(stderr, "Performance counters were never scheduled, timing only\n");
+        counters = NULL;
+    }
+
+    printf("{\n");
+    printf("  \"iterations\": %zu,\n", iterations);
+    printf("  \"warmup\": %zu,\n", warmup);
+    printf("  \"bytes\": %zu,\n", bytes);
+    printf("  \"tokens\": %zu,\n", token_count);
+    printf("  \"nodes\": %zu,\n", node_count);
+    printf("  \"instructions\": %zu,\n", instruction_count);
+    if (counters) {
+        printf("  \"counted_runs\": %zu,\n", counted_runs);
+    }
+
+    printf("  \"phases\": [\n");
+
+    for (size_t phase = 0; phase < BENCH_PHASE_COUNT; phase++) {
+        print_phase_json(names[phase], samples + phase * iterations, iterations, counts[phase],
+                         units[phase]);
+
+        if (counters) {
+            print_counters_json(counters, counter_totals[phase], counted_runs,
+                                counter_counts[phase], counter_units[phase]);
         }
 
-        return expr;
+        printf("\n    }%s\n", phase + 1 == BENCH_PHASE_COUNT ? "" : ",");
+    }
+
+    printf("  ]\n");
+    printf("}\n");
+
+    if (opts->latency) {
+        print_latency_report();
+    }
+
+    perf_counters_close(&perf);
+    free(samples);
+}
+
+char *generate_corpus(const struct gen_options *options)
+{
+    char *text = NULL;
+    size_t size = 0;
+    FILE *stream = open_memstream(&text, &size);
+
+    if (!stream) {
+        (void)fprintf(stderr, "Go download more ram\n");
+        exit(EXIT_FAILURE);
+    }
+
+    generate_expressions(options, stream);
+    (void)fclose(stream);
+
+    // One expression per case, without the newline the generator ends it with.
+    if (size > 0 && text[size - 1] == '\n') {
+        text[size - 1] = '\0';
+    }
+
+    return text;
+}
+
+double run_suite_once(enum suite_evaluator evaluator, const char *expression,
+                      const struct cli_options *config, struct chunk *chunks,
+                      const struct acc_chunk *acc, const struct ast_node *root)
+{
+    switch (evaluator) {
+    case SUITE_FRONTEND: {
+        size_t fired[RULE_COUNT] = { 0 };
+        struct lexer lex = { 0 };
+        struct chunk compiled = { 0 };
+
+        init_lexer(&lex);
+        lex.allow_out_of_range = config->bench_modes;
+        tokenize(&lex, expression);
+
+        struct ast_node *tree = apply_passes(parse(&lex), config, fired);
+        init_chunks(&compiled);
+        compile_ast_to_bytecode(&compiled, tree);
+        emit_bytecode(&compiled, OP_HALT, 0);
+
+        double size = (double)compiled.code_size;
+        free_ast_node(tree);
+        free_tokens(lex.tokens);
+        free_chunks(&compiled);
+
+        return size;
+    }
+
+    case SUITE_RUN_VM: {
+        struct vm stack_vm = { .ip = 0, .top = 0, .chunks = chunks, .stack = { { 0 } } };
+        union value result = run_vm(&stack_vm);
+
+        return root->value_type == VALUE_INT ? (double)result.integer : result.number;
+    }
+
+    case SUITE_EVAL_AST:
+        return root->value_type == VALUE_INT ? (double)eval_ast_int(root) : eval_ast(root);
+
+    case SUITE_TAIL_VM: {
+        union value result = run_tail_vm(chunks);
+        return root->value_type == VALUE_INT ? (double)result.integer : result.number;
+    }
+
+    case SUITE_ACC_VM: {
+        union value result = run_acc_vm(acc);
+        return root->value_type == VALUE_INT ? (double)result.integer : result.number;
+    }
+
+    case SUITE_F32_VM: {
+        struct f32_vm f32_vm = { .chunks = chunks, .ip = 0, .top = 0, .stack = { 0 } };
+        return (double)run_f32_vm(&f32_vm);
+    }
+
+    case SUITE_DD_VM: {
+        struct dd_vm dd_vm = { .chunks = chunks, .ip = 0, .top = 0 };
+        return run_dd_vm(&dd_vm).hi;
     }
 
-    (void)fprintf(stderr, "Invalid prefix token\n");
-    exit(EXIT_FAILURE);
-}
+    case SUITE_INTERVAL_VM: {
+        struct interval_vm interval_vm = { .chunks = chunks, .ip = 0, .top = 0 };
+        return run_interval_vm(&interval_vm).lo;
+    }
 
-void free_ast_node(struct ast_node *node)
-{
-    if (!node) {
-        return;
+    case SUITE_RATIONAL_VM: {
+        struct rational result;
+        struct rational_vm rational_vm = { .chunks = chunks, .ip = 0, .top = 0 };
+
+        run_rational_vm(&rational_vm, &result);
+        rational_free(&result);
+
+        return 0.0;
     }
 
-    switch (node->type) {
-    case NODE_NUMBER:
-        break;
-    case NODE_UNARY: {
-        free_ast_node(node->data.unary.child);
-    } break;
-    case NODE_BINARY: {
-        free_ast_node(node->data.binary.left);
-        free_ast_node(node->data.binary.right);
-    } break;
+    case SUITE_BIGINT_VM: {
+        struct bigint result;
+        struct bigint_vm bigint_vm = { .chunks = chunks, .ip = 0, .top = 0 };
+
+        run_bigint_vm(&bigint_vm, &result);
+        bigint_free(&result);
+
+        return 0.0;
+    }
     }
 
-    free(node);
+    return 0.0;
 }
 
-void free_tokens(struct token *tokens)
+void measure_suite_batches(enum suite_evaluator evaluator, const char *expression,
+                           const struct cli_options *config, struct chunk *chunks,
+                           const struct acc_chunk *acc, const struct ast_node *root,
+                           uint64_t *per_run)
 {
-    if (!tokens) {
-        return;
+    // Each batch repeats until it has run for SUITE_BATCH_NS, so tiny inputs are not dominated
+    // by the clock. An extra first batch only warms caches and branch predictors.
+    volatile double sink = 0.0;
+
+    for (size_t batch = 0; batch <= SUITE_BATCHES; batch++) {
+        uint64_t start = now_ns();
+        uint64_t elapsed = 0;
+        size_t runs = 0;
+
+        do {
+            sink = sink + run_suite_once(evaluator, expression, config, chunks, acc, root);
+            runs += 1;
+            elapsed = now_ns() - start;
+        } while (elapsed < SUITE_BATCH_NS);
+
+        if (batch > 0) {
+            per_run[batch - 1] = elapsed / runs;
+        }
     }
-
-    free(tokens);
 }
 
-void append_token(struct lexer *lex, struct token tok)
+void summarize_suite_samples(const uint64_t *samples, struct suite_result *result)
 {
-    if (lex->size >= lex->capacity) {
-        lex->capacity *= 2;
-        struct token *new_tokens = realloc(lex->tokens, lex->capacity * sizeof(*lex->tokens));
+    // The samples come from passes spread over the whole suite, so their median absolute
+    // deviation covers the machine drifting between passes as well as batch to batch noise.
+    uint64_t sorted[SUITE_SAMPLES];
+    uint64_t deviations[SUITE_SAMPLES];
 
-        if (!new_tokens) {
-            (void)fprintf(stderr, "Go download more ram\n");
-            exit(EXIT_FAILURE);
-        }
+    memcpy(sorted, samples, sizeof(sorted));
+    qsort(sorted, SUITE_SAMPLES, sizeof(*sorted), compare_u64);
+    uint64_t median = sorted[SUITE_SAMPLES / 2];
 
-        lex->tokens = new_tokens;
+    for (size_t i = 0; i < SUITE_SAMPLES; i++) {
+        deviations[i] = sorted[i] > median ? sorted[i] - median : median - sorted[i];
     }
 
-    lex->tokens[lex->size++] = tok;
+    qsort(deviations, SUITE_SAMPLES, sizeof(*deviations), compare_u64);
+    result->min_ns = (double)sorted[0];
+    result->median_ns = (double)median;
+    result->mad_ns = (double)deviations[SUITE_SAMPLES / 2];
 }
 
-struct token create_token(enum token_kind kind, union token_value value, size_t start, size_t end)
+bool suite_regressed(const struct suite_result *result, const struct suite_result *previous,
+                     double threshold, double *change)
 {
-    return (struct token){ .kind = kind, .value = value, .start = start, .end = end };
+    // A slowdown has to clear the threshold and the noise of both sides. Older baselines have no
+    // deviation, which leaves only this run's.
+    double difference = result->median_ns - previous->median_ns;
+    *change = difference / previous->median_ns * 100.0;
+
+    return *change > threshold &&
+           difference > SUITE_NOISE_MADS * (result->mad_ns + previous->mad_ns);
 }
 
-void init_lexer(struct lexer *lex)
+struct suite_result *load_suite_baseline(const char *path, size_t *count)
 {
-    lex->cursor = 0;
-    lex->capacity = DEFAULT_CAPACITY;
-    lex->size = 0;
-    lex->tokens = malloc(lex->capacity * sizeof(*lex->tokens));
+    // Only reads back what benchmark_suite writes, one result object per line.
+    char *text = read_expression_file(path);
+    size_t capacity = DEFAULT_CAPACITY;
+    struct suite_result *results = malloc(capacity * sizeof(*results));
 
-    if (!lex->tokens) {
+    if (!results) {
         (void)fprintf(stderr, "Go download more ram\n");
         exit(EXIT_FAILURE);
     }
-}
 
-bool is_part_of_number(char character)
-{
-    return isdigit(character) || character == '.' || character == 'e' || character == 'E' ||
-           character == '+' || character == '-';
-}
+    *count = 0;
 
-void parse_number(struct lexer *lex, const char *source)
-{
-    size_t source_len = strlen(source);
-    size_t start = lex->cursor;
+    for (char *line = text; line && *line != '\0';) {
+        char *next = strchr(line, '\n');
+        if (next) {
+            *next = '\0';
+        }
 
-    while (lex->cursor < source_len && is_part_of_number(source[lex->cursor]) &&
-           !isspace(source[lex->cursor])) {
-        lex->cursor += 1;
-    }
+        struct suite_result entry = { 0 };
+        if (sscanf(line,
+                   " {\"case\": \"%31[^\"]\", \"config\": \"%31[^\"]\", \"evaluator\": "
+                   "\"%31[^\"]\", \"min_ns\": %lf, \"median_ns\": %lf, \"mad_ns\": %lf",
+                   entry.case_name, entry.config, entry.evaluator, &entry.min_ns,
+                   &entry.median_ns, &entry.mad_ns) >= 5) {
+            if (*count >= capacity) {
+                capacity *= 2;
+                struct suite_result *grown = realloc(results, capacity * sizeof(*results));
+
+                if (!grown) {
+                    (void)fprintf(stderr, "Go download more ram\n");
+                    exit(EXIT_FAILURE);
+                }
+
+                results = grown;
+            }
 
-    size_t digits_len = lex->cursor - start;
+            results[(*count)++] = entry;
+        }
 
-    if (!digits_len) {
-        (void)fprintf(stderr, "Invalid character at position %zu", lex->cursor);
-        exit(EXIT_FAILURE);
+        line = next ? next + 1 : NULL;
     }
 
-    char *digits = malloc(digits_len + 1);
-    if (!digits) {
-        (void)fprintf(stderr, "Go download more ram\n");
+    free(text);
+
+    if (*count == 0) {
+        (void)fprintf(stderr, "No benchmark results in baseline '%s'\n", path);
         exit(EXIT_FAILURE);
     }
 
-    memcpy(digits, source + start, digits_len);
-    digits[digits_len] = '\0';
+    return results;
+}
 
-    errno = 0;
-    char *end = NULL;
-    double val = strtod(digits, &end);
+struct ast_node *prepare_suite_chunks(const char *expression, const struct cli_options *config,
+                                      struct lexer *lex, struct chunk *chunks,
+                                      struct acc_chunk *acc)
+{
+    size_t fired[RULE_COUNT] = { 0 };
 
-    if (errno == ERANGE || *end != '\0') {
-        (void)fprintf(stderr, "Invalid or out of range number: %s\n", digits);
-        exit(EXIT_FAILURE);
+    init_lexer(lex);
+    lex->allow_out_of_range = config->bench_modes;
+    tokenize(lex, expression);
+
+    struct ast_node *root = apply_passes(parse(lex), config, fired);
+    init_chunks(chunks);
+    compile_ast_to_bytecode(chunks, root);
+    emit_bytecode(chunks, OP_HALT, 0);
+
+    if (!config->bench_modes) {
+        compile_accumulator(acc, root);
     }
 
-    append_token(lex, create_token(NUMBER, (union token_value){ .number_value = val }, start,
-                                   start + digits_len - 1));
-    free(digits);
+    return root;
 }
 
-void tokenize(struct lexer *lex, const char *source)
+void free_suite_chunks(struct ast_node *root, struct lexer *lex, struct chunk *chunks,
+                       struct acc_chunk *acc)
 {
-    size_t source_len = strlen(source);
+    free_ast_node(root);
+    free_tokens(lex->tokens);
+    free_chunks(chunks);
+    free_acc_chunk(acc);
+}
 
-    while (lex->cursor < source_len) {
-        size_t cursor = lex->cursor;
-        char character = source[cursor];
+struct suite_result *merge_suite_baselines(const struct cli_options *opts, size_t *count)
+{
+    // One run can be off as a whole: the machine was busier for those seconds, or address space
+    // randomization put a hot loop across an unlucky boundary. With several --baseline files
+    // each entry takes the median of the runs, and the whole range of the run medians is added
+    // to its noise, so a candidate that behaves like any of the recorded runs passes.
+    struct suite_result *runs[SUITE_MAX_BASELINES];
+    size_t run_counts[SUITE_MAX_BASELINES];
+
+    for (size_t r = 0; r < opts->baseline_count; r++) {
+        runs[r] = load_suite_baseline(opts->baseline_paths[r], &run_counts[r]);
+    }
 
-        if (isspace(character)) {
-            lex->cursor += 1;
-            continue;
+    struct suite_result *merged = runs[0];
+    *count = run_counts[0];
+
+    for (size_t i = 0; i < *count; i++) {
+        double medians[SUITE_MAX_BASELINES] = { merged[i].median_ns };
+        double mads[SUITE_MAX_BASELINES] = { merged[i].mad_ns };
+        size_t found = 1;
+
+        for (size_t r = 1; r < opts->baseline_count; r++) {
+            for (size_t j = 0; j < run_counts[r]; j++) {
+                const struct suite_result *other = &runs[r][j];
+
+                if (strcmp(other->case_name, merged[i].case_name) == 0 &&
+                    strcmp(other->config, merged[i].config) == 0 &&
+                    strcmp(other->evaluator, merged[i].evaluator) == 0) {
+                    medians[found] = other->median_ns;
+                    mads[found++] = other->mad_ns;
+                    break;
+                }
+            }
         }
 
-        union token_value value = (union token_value){ .value = character };
-
-        switch (character) {
-        case '-': {
-            if (cursor + 1 < source_len && isdigit(source[cursor + 1])) {
-                parse_number(lex, source);
-                continue;
-            }
+        qsort(medians, found, sizeof(*medians), compare_double);
+        qsort(mads, found, sizeof(*mads), compare_double);
+        merged[i].median_ns = medians[found / 2];
+        // suite_regressed scales the deviation by SUITE_NOISE_MADS, the range goes in unscaled.
+        merged[i].mad_ns = mads[found / 2] + (medians[found - 1] - medians[0]) / SUITE_NOISE_MADS;
+    }
 
-            append_token(lex, create_token(MINUS, value, cursor, cursor));
-        } break;
+    for (size_t r = 1; r < opts->baseline_count; r++) {
+        free(runs[r]);
+    }
 
-        case '+': {
-            append_token(lex, create_token(PLUS, value, cursor, cursor));
-        } break;
+    return merged;
+}
 
-        case '*': {
-            append_token(lex, create_token(STAR, value, cursor, cursor));
-        } break;
+int benchmark_suite(const struct cli_options *opts)
+{
+    // A fixed corpus, generated from pinned seeds so every revision times the same inputs.
+    static const struct {
+        const char *name;
+        size_t size;
+        enum gen_shape shape;
+        const char *ops;
+        enum gen_literal_kind literal_kinds[2];
+        size_t literal_kind_count;
+        double paren_density;
+        bool exact;
+    } cases[] = {
+        { "small", 8, GEN_SHAPE_RANDOM, "+-*/", { GEN_LITERAL_INT, GEN_LITERAL_DECIMAL }, 2, 0.0,
+          true },
+        { "medium", 256, GEN_SHAPE_RANDOM, "+-*/", { GEN_LITERAL_INT, GEN_LITERAL_DECIMAL }, 2,
+          0.0, true },
+        { "huge", 100000, GEN_SHAPE_BALANCED, "+-*/", { GEN_LITERAL_DECIMAL }, 1, 0.0, false },
+        { "deep", 200, GEN_SHAPE_RIGHT, "+-*", { GEN_LITERAL_DECIMAL }, 1, 0.2, true },
+        { "numbers", 4096, GEN_SHAPE_LEFT, "+-", { GEN_LITERAL_DECIMAL, GEN_LITERAL_EXPONENT }, 2,
+          0.0, false },
+        { "operators", 1024, GEN_SHAPE_RANDOM, "+-*/%^", { GEN_LITERAL_INT }, 1, 0.5, true },
+        { "integers", 64, GEN_SHAPE_BALANCED, "+-*", { GEN_LITERAL_INT }, 1, 0.0, true },
+    };
 
-        case '/': {
-            append_token(lex, create_token(SLASH, value, cursor, cursor));
-        } break;
+    // Front-end configurations run the double evaluators, the untyped chunk feeds the others.
+    static const struct {
+        const char *name;
+        struct cli_options options;
+    } configs[] = {
+        { "plain", { 0 } },
+        { "no-int", { .no_int = true } },
+        { "sum", { .sum_mode = SUM_PAIRWISE } },
+        { "simplify", { .simplify = true } },
+        { "fast-math", { .simplify = true, .fast_math = true } },
+        { "horner", { .poly_scheme = POLY_AUTO } },
+        { "fma", { .fma = true } },
+        { "untyped", { .bench_modes = true } },
+    };
+    static const char *evaluator_names[] = { "frontend",    "run_vm",      "eval_ast",
+                                             "tail_vm",     "acc_vm",      "f32_vm",
+                                             "dd_vm",       "interval_vm", "rational_vm",
+                                             "bigint_vm" };
+
+    size_t baseline_count = 0;
+    struct suite_result *baseline =
+        opts->baseline_count > 0 ? merge_suite_baselines(opts, &baseline_count) : NULL;
+    size_t case_count = sizeof(cases) / sizeof(cases[0]);
+    char *expressions[sizeof(cases) / sizeof(cases[0])];
+    struct suite_entry *entries = NULL;
+    size_t entry_count = 0;
+    size_t entry_capacity = 0;
+
+    for (size_t c = 0; c < case_count; c++) {
+        struct gen_options gen = { .size = cases[c].size,
+                                   .count = 1,
+                                   .shape = cases[c].shape,
+                                   .ops = cases[c].ops,
+                                   .literal_kind_count = cases[c].literal_kind_count,
+                                   .paren_density = cases[c].paren_density,
+                                   .seed = c + 1 };
+        memcpy(gen.literal_kinds, cases[c].literal_kinds, sizeof(cases[c].literal_kinds));
+        expressions[c] = generate_corpus(&gen);
+
+        for (size_t k = 0; k < sizeof(configs) / sizeof(configs[0]); k++) {
+            const struct cli_options *config = &configs[k].options;
+            struct lexer lex = { 0 };
+            struct chunk chunks = { 0 };
+            struct acc_chunk acc = { 0 };
+            struct ast_node *root =
+                prepare_suite_chunks(expressions[c], config, &lex, &chunks, &acc);
+
+            for (enum suite_evaluator evaluator = SUITE_FRONTEND; evaluator <= SUITE_BIGINT_VM;
+                 evaluator++) {
+                bool untyped = config->bench_modes;
+                bool wanted = untyped ? evaluator >= SUITE_F32_VM : evaluator <= SUITE_ACC_VM;
+
+#ifdef TAIL_TRAMPOLINE
+                wanted = wanted && evaluator != SUITE_TAIL_VM;
+#endif
+
+                if (evaluator == SUITE_RATIONAL_VM) {
+                    wanted = wanted && cases[c].exact && exact_mode_supported(root, false);
+                } else if (evaluator == SUITE_BIGINT_VM) {
+                    wanted = wanted && cases[c].exact && exact_mode_supported(root, true);
+                }
+
+                if (!wanted) {
+                    continue;
+                }
+
+                entries = grow_array(entries, &entry_capacity, entry_count, sizeof(*entries));
+                struct suite_entry *entry = &entries[entry_count++];
+                *entry = (struct suite_entry){ .case_index = c,
+                                               .config_index = k,
+                                               .evaluator = evaluator };
+
+                (void)snprintf(entry->result.case_name, sizeof(entry->result.case_name), "%s",
+                               cases[c].name);
+                (void)snprintf(entry->result.config, sizeof(entry->result.config), "%s",
+                               configs[k].name);
+                (void)snprintf(entry->result.evaluator, sizeof(entry->result.evaluator), "%s",
+                               evaluator_names[evaluator]);
+
+                for (size_t i = 0; i < baseline_count && !entry->previous; i++) {
+                    if (strcmp(baseline[i].case_name, entry->result.case_name) == 0 &&
+                        strcmp(baseline[i].config, entry->result.config) == 0 &&
+                        strcmp(baseline[i].evaluator, entry->result.evaluator) == 0 &&
+                        baseline[i].median_ns > 0.0) {
+                        entry->previous = &baseline[i];
+                    }
+                }
+            }
 
-        case '%': {
-            append_token(lex, create_token(PERCENT, value, cursor, cursor));
-        } break;
+            free_suite_chunks(root, &lex, &chunks, &acc);
+        }
+    }
 
-        case '^': {
-            append_token(lex, create_token(CARET, value, cursor, cursor));
-        } break;
+    // Every entry is measured in SUITE_PASSES interleaved passes over the corpus rather than all
+    // at once, so a stretch where the machine is slow lands in one pass of many entries instead
+    // of in every sample of a few. A slowdown then only counts when it survives being measured
+    // again the same way, in rounds that run after the whole corpus and only over the suspects.
+    for (size_t round = 0; round <= SUITE_CONFIRM_RUNS; round++) {
+        bool confirming = round > 0;
+        size_t suspects = 0;
+
+        for (size_t pass = 0; pass < SUITE_PASSES; pass++) {
+            struct lexer lex = { 0 };
+            struct chunk chunks = { 0 };
+            struct acc_chunk acc = { 0 };
+            struct ast_node *root = NULL;
+            const struct suite_entry *prepared = NULL;
+
+            for (size_t i = 0; i < entry_count; i++) {
+                struct suite_entry *entry = &entries[i];
+
+                if (confirming && !entry->regressed) {
+                    continue;
+                }
+
+                const char *expression = expressions[entry->case_index];
+                const struct cli_options *config = &configs[entry->config_index].options;
+
+                if (!prepared || prepared->case_index != entry->case_index ||
+                    prepared->config_index != entry->config_index) {
+                    if (prepared) {
+                        free_suite_chunks(root, &lex, &chunks, &acc);
+                        lex = (struct lexer){ 0 };
+                        chunks = (struct chunk){ 0 };
+                        acc = (struct acc_chunk){ 0 };
+                    }
+
+                    root = prepare_suite_chunks(expression, config, &lex, &chunks, &acc);
+                    prepared = entry;
+                }
+
+                measure_suite_batches(entry->evaluator, expression, config, &chunks, &acc, root,
+                                      entry->samples + pass * SUITE_BATCHES);
+            }
 
-        case '(': {
-            append_token(lex, create_token(LPAREN, value, cursor, cursor));
-        } break;
+            if (prepared) {
+                free_suite_chunks(root, &lex, &chunks, &acc);
+            }
+        }
 
-        case ')': {
-            append_token(lex, create_token(RPAREN, value, cursor, cursor));
-        } break;
+        for (size_t i = 0; i < entry_count; i++) {
+            struct suite_entry *entry = &entries[i];
 
-        default: {
-            if (isdigit(character)) {
-                parse_number(lex, source);
+            if (confirming && !entry->regressed) {
                 continue;
             }
 
-            (void)fprintf(stderr, "Unknown token '%c' at position %zu\n", character, lex->cursor);
-            exit(EXIT_FAILURE);
-        };
+            summarize_suite_samples(entry->samples, &entry->result);
+            entry->repeats += confirming ? 1 : 0;
+            entry->regressed = entry->previous && suite_regressed(&entry->result, entry->previous,
+                                                                  opts->threshold, &entry->change);
+            suspects += entry->regressed ? 1 : 0;
         }
 
-        lex->cursor += 1;
+        if (suspects == 0) {
+            break;
+        }
     }
 
-    append_token(lex, create_token(END_OF_FILE, (union token_value){ .value = '\0' }, lex->cursor,
-                                   lex->cursor));
-}
-
-void print_help(void)
-{
-    printf("Usage:\n");
-    printf("  ./main [OPTIONS] [EXPRESSION]\n\n");
-
-    printf("Options:\n");
-    printf(
-        "  -e, --eval EXPRESSION       Evaluate expression directly (default if expression provided)\n");
-    printf("  -a, --ast [FORMAT]          Show AST visualization\n");
-    printf("                               FORMAT can be 'json' (default is S-expression)\n");
-    printf("  -h, --help                  Show this help message\n\n");
-}
-
-void parse_args(int argc, char **argv, struct cli_options *opts)
-{
-    static struct option long_options[] = {
-        { "help", no_argument, 0, 'h' },
-        { "eval", required_argument, 0, 'e' },
-        { "ast", optional_argument, 0, 'a' },
-        { NULL, 0, NULL, 0 },
-    };
+    size_t regressions = 0;
 
-    int opt = 0;
+    printf("{\n");
+    printf("  \"threshold_pct\": %.1f,\n", opts->threshold);
+    printf("  \"results\": [\n");
 
-    while ((opt = getopt_long(argc, argv, "he:a::", long_options, NULL)) != -1) {
-        switch (opt) {
-        case 'h': {
-            opts->show_help = true;
-        } break;
+    for (size_t i = 0; i < entry_count; i++) {
+        const struct suite_entry *entry = &entries[i];
+        const struct suite_result *result = &entry->result;
 
-        case 'e': {
-            opts->expression = optarg;
-        } break;
+        printf("%s    {\"case\": \"%s\", \"config\": \"%s\", \"evaluator\": \"%s\", "
+               "\"min_ns\": %.1f, \"median_ns\": %.1f, \"mad_ns\": %.1f",
+               i == 0 ? "" : ",\n", result->case_name, result->config, result->evaluator,
+               result->min_ns, result->median_ns, result->mad_ns);
 
-        case 'a': {
-            // optarg is null for short option?? e.g. -a json
+        if (entry->previous) {
+            printf(", \"baseline_median_ns\": %.1f, \"change_pct\": %.2f, \"repeats\": %zu, "
+                   "\"regressed\": %s",
+                   entry->previous->median_ns, entry->change, entry->repeats,
+                   entry->regressed ? "true" : "false");
 
-            if (!argv[optind]) {
-                opts->show_ast = AST_S_EXPR;
-            } else if (optind < argc && strcmp(argv[optind], "json") == 0) {
-                opts->show_ast = AST_JSON;
+            if (entry->regressed) {
+                regressions += 1;
+                (void)fprintf(stderr, "Regression: %s/%s/%s %.1f ns -> %.1f ns (%+.2f%%)\n",
+                              result->case_name, result->config, result->evaluator,
+                              entry->previous->median_ns, result->median_ns, entry->change);
             }
-        } break;
-
-        case '?':
-        default:
-            break;
         }
+
+        printf("}");
     }
 
-    if (!opts->expression && optind < argc) {
-        opts->expression = argv[optind];
+    printf("\n  ],\n");
+    printf("  \"regressions\": %zu\n", regressions);
+    printf("}\n");
+
+    for (size_t c = 0; c < case_count; c++) {
+        free(expressions[c]);
     }
+
+    free(entries);
+    free(baseline);
+
+    return regressions > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 
 void process_expression(struct cli_options *opts)
@@ -966,17 +12309,32 @@ void process_expression(struct cli_options *opts)
     }
 
     struct lexer lex = { 0 };
+    TRACE_BEGIN_EXPRESSION();
+    TRACE_BEGIN("tokenize");
+    TRACK_PHASE(PHASE_TOKENIZE);
     init_lexer(&lex);
+    lex.allow_out_of_range = opts->numeric_mode != NUMERIC_DOUBLE || opts->bench_modes;
 
     tokenize(&lex, opts->expression);
+    TRACE_END("tokenize");
+    TRACE_BEGIN("parse");
+    TRACK_PHASE(PHASE_PARSE);
     struct ast_node *root = parse(&lex);
+    TRACE_END("parse");
 
     if (!root) {
         (void)fprintf(stderr, "Error: Empty expression\n");
         free_tokens(lex.tokens);
+        TRACE_END("expression");
         return;
     }
 
+    size_t fired[RULE_COUNT] = { 0 };
+    TRACE_BEGIN("passes");
+    TRACK_PHASE(PHASE_PASSES);
+    root = apply_passes(root, opts, fired);
+    TRACE_END("passes");
+
     if (opts->show_ast == AST_S_EXPR) {
         printf("AST: ");
         print_ast(root);
@@ -989,27 +12347,142 @@ void process_expression(struct cli_options *opts)
     }
 
     struct chunk chunks = { 0 };
+    struct acc_chunk acc = { 0 };
+    TRACE_BEGIN("compile");
+    TRACK_PHASE(PHASE_COMPILE);
     init_chunks(&chunks);
 
     compile_ast_to_bytecode(&chunks, root);
     emit_bytecode(&chunks, OP_HALT, 0);
 
-    struct vm stack_vm = { .ip = 0, .top = 0, .chunks = &chunks, .stack = { 0 } };
-    double result = run_vm(&stack_vm);
-    double eval_result = eval_ast(root);
+    if (opts->acc_vm) {
+        compile_accumulator(&acc, root);
+    }
+    TRACE_END("compile");
+
+    if (opts->disasm) {
+        disassemble_chunk(&chunks);
+    }
 
-    assert(result == eval_result);
-    printf("VM Result: %.15g\n", result);
-    printf("Eval Result: %.15g\n", eval_result);
+    if (opts->disasm && opts->acc_vm) {
+        disassemble_acc_chunk(&acc);
+    }
+
+    if (opts->emit_c_path) {
+        write_c_source(&chunks, opts->emit_c_path);
+    }
+
+    if (opts->emit_asm_path) {
+        write_native(&chunks, opts->emit_asm_path, false);
+    }
+
+    if (opts->emit_obj_path) {
+        write_native(&chunks, opts->emit_obj_path, true);
+    }
+
+    TRACE_BEGIN("execute");
+    TRACK_PHASE(PHASE_RUN);
+
+    if (opts->bench_modes) {
+        benchmark_numeric_modes(&chunks, root);
+        TRACE_END("execute");
+
+        free_ast_node(root);
+        free_tokens(lex.tokens);
+        free_chunks(&chunks);
+        free_acc_chunk(&acc);
+        TRACE_END("expression");
+        return;
+    }
+
+    if (opts->numeric_mode != NUMERIC_DOUBLE) {
+        switch (opts->numeric_mode) {
+        case NUMERIC_BIGINT: {
+            execute_bigint(&chunks, root);
+        } break;
+        case NUMERIC_RATIONAL: {
+            execute_rational(&chunks, root);
+        } break;
+        case NUMERIC_F32: {
+            execute_f32(&chunks, root);
+        } break;
+        case NUMERIC_INTERVAL: {
+            execute_interval(&chunks, root);
+        } break;
+        case NUMERIC_DD: {
+            execute_dd(&chunks, root);
+        } break;
+        case NUMERIC_MOD: {
+            execute_mod(&chunks, root, opts->modulus);
+        } break;
+        case NUMERIC_DOUBLE:
+            break;
+        }
+
+        TRACE_END("execute");
+        free_ast_node(root);
+        free_tokens(lex.tokens);
+        free_chunks(&chunks);
+        free_acc_chunk(&acc);
+        TRACE_END("expression");
+        return;
+    }
+
+    struct vm stack_vm = { .ip = 0, .top = 0, .chunks = &chunks, .stack = { { 0 } } };
+    union value result = opts->acc_vm    ? run_acc_vm(&acc)
+                         : opts->tail_vm ? run_tail_vm(&chunks)
+                                         : run_vm(&stack_vm);
+    TRACK_PHASE(PHASE_EVAL);
+
+    if (root->value_type == VALUE_INT) {
+        int64_t eval_result = eval_ast_int(root);
+
+        assert(result.integer == eval_result);
+        TRACE_END("execute");
+        TRACE_BEGIN("output");
+        printf("VM Result: %" PRId64 "\n", result.integer);
+        printf("Eval Result: %" PRId64 "\n", eval_result);
+    } else {
+        double eval_result = eval_ast(root);
+
+        assert(result.number == eval_result);
+        TRACE_END("execute");
+        TRACE_BEGIN("output");
+        printf("VM Result: %.15g\n", result.number);
+        printf("Eval Result: %.15g\n", eval_result);
+    }
+
+    if (opts->aot) {
+        double aot_result = execute_aot(&chunks);
 
+        assert(aot_result ==
+               (root->value_type == VALUE_INT ? (double)result.integer : result.number));
+        printf("AOT Result: %.15g\n", aot_result);
+    }
+
+    if (opts->simplify_report) {
+        static const char *rule_names[RULE_COUNT] = {
+            "x^2 -> x*x",       "x^0.5 -> sqrt(x)", "x/c -> x*(1/c)", "x*1 -> x",
+            "x+0 -> x",         "x-0 -> x",         "0-x -> -x",      "+x -> x",
+            "--x -> x",         "merge constants",
+        };
+
+        for (size_t i = 0; i < RULE_COUNT; i++) {
+            printf("Rule %-18s %zu\n", rule_names[i], fired[i]);
+        }
+    }
+
+    TRACE_END("output");
     free_ast_node(root);
     free_tokens(lex.tokens);
     free_chunks(&chunks);
+    free_acc_chunk(&acc);
+    TRACE_END("expression");
 }
 
 int main(int argc, char **argv)
 {
-    struct cli_options opts = { 0 };
+    struct cli_options opts = { .threshold = DEFAULT_SUITE_THRESHOLD };
     parse_args(argc, argv, &opts);
 
     if (opts.show_help) {
@@ -1017,7 +12490,49 @@ int main(int argc, char **argv)
         return 0;
     }
 
-    process_expression(&opts);
+    if (opts.bench_bigint) {
+        benchmark_bigint_multiplication();
+        return 0;
+    }
+
+    if (opts.generate) {
+        generate_expressions(&opts.gen, stdout);
+        return 0;
+    }
+
+    if (opts.bench_suite) {
+        return benchmark_suite(&opts);
+    }
+
+    if (opts.trace_path) {
+        trace_path = opts.trace_path;
+        trace_enabled = true;
+        atexit(trace_flush);
+    }
+
+    char *file_expression = NULL;
+    if (opts.expression_file) {
+        file_expression = read_expression_file(opts.expression_file);
+        opts.expression = file_expression;
+    }
+
+    if (opts.bench_iterations > 0) {
+        benchmark_pipeline(&opts);
+    } else {
+        process_expression(&opts);
+    }
+
+#ifdef VM_PROFILE
+    print_vm_profile();
+#endif
+
+#ifdef TRACK_ALLOCATIONS
+    if (opts.stats) {
+        print_allocation_stats();
+    }
+#endif
+
+    free(file_expression);
 
     return 0;
 }